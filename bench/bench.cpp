@@ -0,0 +1,636 @@
+/**bench.cpp
+ *
+ * Benchmarks for Map and Set against std::map and std::set.
+ *
+ * Every operation runs on the same keys and queries for both sides,
+ * and is reported in ns/op and heap allocations/op as CSV or JSON.
+ * Allocations are counted by replacing the global operator new.
+ *
+ * Usage: rb-tree-bench [--min-size N] [--max-size N] [--queries N]
+ *                      [--containers map,set] [--workloads LIST]
+ *                      [--format csv|json] [--output FILE]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <new>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "map.hpp"
+#include "set.hpp"
+
+/**
+ * Allocation counting
+ */
+
+static size_t allocationCount = 0;
+
+void *operator new(size_t size)
+{
+    allocationCount++;
+    if (void *ptr = std::malloc(size == 0 ? 1 : size))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+// Every pointer freed here came from the malloc in operator new above,
+// but GCC 11+ sees free() on the result of new once the two are inlined
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void operator delete(void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept
+{
+    std::free(ptr);
+}
+
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic pop
+#endif
+
+// Results are folded in here so that no measured work is optimized away
+static volatile size_t checksum = 0;
+
+/**
+ * Keys and probes
+ *
+ * Keys are distinct and probes fall strictly between neighbouring keys,
+ * so floor(above(k)) and ceiling(below(k)) are k and lookups of probes
+ * miss.
+ */
+
+template <typename Key>
+struct KeyTraits;
+
+template <>
+struct KeyTraits<int>
+{
+    static const char *name() { return "int"; }
+    static int make(size_t index, std::mt19937_64 &) { return static_cast<int>(2 * index); }
+    static int below(int key) { return key - 1; }
+    static int above(int key) { return key + 1; }
+};
+
+template <>
+struct KeyTraits<std::string>
+{
+    static const char *name() { return "string"; }
+
+    // A random prefix spreads the keys; the index suffix keeps them distinct
+    static std::string make(size_t index, std::mt19937_64 &rng)
+    {
+        std::string key(24, 'a');
+        for (size_t i = 0; i < 16; i++)
+            key[i] = static_cast<char>('a' + rng() % 26);
+        for (size_t i = 23; i >= 16; i--, index /= 26)
+            key[i] = static_cast<char>('a' + index % 26);
+        return key;
+    }
+
+    static std::string below(const std::string &key) { return key.substr(0, key.size() - 1); }
+    static std::string above(const std::string &key) { return key + '~'; }
+};
+
+/**
+ * Zipfian query indices, after Gray et al., "Quickly generating
+ * billion-record synthetic databases": constant memory, O(n) setup.
+ */
+
+class ZipfianGenerator
+{
+private:
+    size_t n;
+    double theta, alpha, zetan, eta;
+
+    static double zeta(size_t n, double theta)
+    {
+        double sum = 0;
+        for (size_t i = 1; i <= n; i++)
+            sum += 1 / std::pow(static_cast<double>(i), theta);
+        return sum;
+    }
+
+public:
+    ZipfianGenerator(size_t n, double theta = 0.99) : n(n), theta(theta)
+    {
+        double zeta2 = zeta(2, theta);
+        alpha = 1 / (1 - theta);
+        zetan = zeta(n, theta);
+        eta = (1 - std::pow(2.0 / n, 1 - theta)) / (1 - zeta2 / zetan);
+    }
+
+    // Rank of the drawn item; 0 is the most popular
+    size_t operator()(std::mt19937_64 &rng)
+    {
+        double u = std::uniform_real_distribution<double>(0, 1)(rng);
+        double uz = u * zetan;
+        if (uz < 1)
+            return 0;
+        if (uz < 1 + std::pow(0.5, theta))
+            return n > 1 ? 1 : 0;
+        size_t rank = static_cast<size_t>(n * std::pow(eta * u - eta + 1, alpha));
+        return rank < n ? rank : n - 1;
+    }
+};
+
+/**
+ * Workloads
+ */
+
+template <typename Key>
+struct Workload
+{
+    std::string name;
+    bool queriesOnly;           // Same keys as another workload; only queries differ
+    std::vector<Key> order;     // Insertion and erase order
+    std::vector<size_t> ranks;  // Query targets, as positions in sorted order
+    std::vector<Key> sorted;    // Keys in sorted order
+    std::vector<Key> belowKeys; // Probes for each query
+    std::vector<Key> aboveKeys;
+};
+
+template <typename Key>
+Workload<Key> makeWorkload(const std::string &name, size_t n, size_t queries, std::mt19937_64 &rng)
+{
+    Workload<Key> w;
+    w.name = name;
+    w.queriesOnly = name == "zipfian";
+
+    for (size_t i = 0; i < n; i++)
+        w.order.push_back(KeyTraits<Key>::make(i, rng));
+    w.sorted = w.order;
+    std::sort(w.sorted.begin(), w.sorted.end());
+    if (name == "sequential")
+        w.order = w.sorted;
+    else
+        std::shuffle(w.order.begin(), w.order.end(), rng);
+
+    if (name == "zipfian")
+    {
+        // Popular keys are scattered over the key space
+        std::vector<size_t> scatter(n);
+        for (size_t i = 0; i < n; i++)
+            scatter[i] = i;
+        std::shuffle(scatter.begin(), scatter.end(), rng);
+
+        ZipfianGenerator zipf(n);
+        for (size_t i = 0; i < queries; i++)
+            w.ranks.push_back(scatter[zipf(rng)]);
+    }
+    else
+        for (size_t i = 0; i < queries; i++)
+            w.ranks.push_back(name == "sequential" ? i % n : rng() % n);
+
+    for (size_t rank : w.ranks)
+    {
+        w.belowKeys.push_back(KeyTraits<Key>::below(w.sorted[rank]));
+        w.aboveKeys.push_back(KeyTraits<Key>::above(w.sorted[rank]));
+    }
+    return w;
+}
+
+/**
+ * Containers under test, behind one interface
+ */
+
+template <typename Key>
+class LlrbMap
+{
+private:
+    Map<Key, int> tree;
+
+public:
+    void insert(const Key &key) { tree.insert({key, 1}); }
+    void append(const Key &key) { tree.append({key, 1}); }
+    void erase(const Key &key) { tree.erase(key); }
+    bool contains(const Key &key) { return tree.contains(key); }
+    size_t rank(const Key &key) { return tree.rank(key); }
+    Key select(size_t rank) { return tree.rankSelect(static_cast<int>(rank)); }
+    Key floor(const Key &key) { return tree.floor(key); }
+    Key ceiling(const Key &key) { return tree.ceiling(key); }
+    size_t serialize() { return tree.serializeBinary().size(); }
+
+    size_t iterate()
+    {
+        size_t sum = 0;
+        for (auto &entry : tree)
+            sum += entry.second;
+        return sum;
+    }
+};
+
+template <typename Key>
+class StdMap
+{
+private:
+    std::map<Key, int> tree;
+
+public:
+    void insert(const Key &key) { tree.insert({key, 1}); }
+    void append(const Key &key) { tree.emplace_hint(tree.end(), key, 1); }
+    void erase(const Key &key) { tree.erase(key); }
+    bool contains(const Key &key) { return tree.count(key) != 0; }
+    size_t rank(const Key &key) { return std::distance(tree.begin(), tree.lower_bound(key)); }
+    Key select(size_t rank) { return std::next(tree.begin(), rank)->first; }
+    Key floor(const Key &key) { return std::prev(tree.upper_bound(key))->first; }
+    Key ceiling(const Key &key) { return tree.lower_bound(key)->first; }
+
+    // The same encoding as serializeBinary, without the tree shape
+    size_t serialize()
+    {
+        std::string out;
+        BinaryCodec<Key> keyCodec;
+        BinaryCodec<int> valueCodec;
+        for (auto &entry : tree)
+        {
+            keyCodec.encode(entry.first, out);
+            valueCodec.encode(entry.second, out);
+        }
+        return out.size();
+    }
+
+    size_t iterate()
+    {
+        size_t sum = 0;
+        for (auto &entry : tree)
+            sum += entry.second;
+        return sum;
+    }
+};
+
+template <typename Key>
+class LlrbSet
+{
+private:
+    Set<Key> tree;
+
+public:
+    void insert(const Key &key) { tree.insert(key); }
+    void append(const Key &key) { tree.append(key); }
+    void erase(const Key &key) { tree.erase(key); }
+    bool contains(const Key &key) { return tree.contains(key); }
+    size_t rank(const Key &key) { return tree.rank(key); }
+    Key select(size_t rank) { return tree.rankSelect(static_cast<int>(rank)); }
+    Key floor(const Key &key) { return tree.floor(key); }
+    Key ceiling(const Key &key) { return tree.ceiling(key); }
+    size_t serialize() { return tree.serializeBinary().size(); }
+
+    size_t iterate()
+    {
+        size_t count = 0;
+        for (auto it = tree.begin(); it != tree.end(); ++it)
+            count++;
+        return count;
+    }
+};
+
+template <typename Key>
+class StdSet
+{
+private:
+    std::set<Key> tree;
+
+public:
+    void insert(const Key &key) { tree.insert(key); }
+    void append(const Key &key) { tree.emplace_hint(tree.end(), key); }
+    void erase(const Key &key) { tree.erase(key); }
+    bool contains(const Key &key) { return tree.count(key) != 0; }
+    size_t rank(const Key &key) { return std::distance(tree.begin(), tree.lower_bound(key)); }
+    Key select(size_t rank) { return *std::next(tree.begin(), rank); }
+    Key floor(const Key &key) { return *std::prev(tree.upper_bound(key)); }
+    Key ceiling(const Key &key) { return *tree.lower_bound(key); }
+
+    size_t serialize()
+    {
+        std::string out;
+        BinaryCodec<Key> keyCodec;
+        for (auto &key : tree)
+            keyCodec.encode(key, out);
+        return out.size();
+    }
+
+    size_t iterate()
+    {
+        size_t count = 0;
+        for (auto it = tree.begin(); it != tree.end(); ++it)
+            count++;
+        return count;
+    }
+};
+
+/**
+ * Measurement
+ */
+
+struct Result
+{
+    std::string operation;
+    size_t ops;
+    double nsPerOp;
+    double allocsPerOp;
+};
+
+template <typename F>
+Result measure(const std::string &operation, size_t ops, F &&body)
+{
+    size_t allocsBefore = allocationCount;
+    auto start = std::chrono::steady_clock::now();
+    body();
+    auto stop = std::chrono::steady_clock::now();
+    size_t allocs = allocationCount - allocsBefore;
+
+    double ns = std::chrono::duration<double, std::nano>(stop - start).count();
+    return {operation, ops, ns / ops, static_cast<double>(allocs) / ops};
+}
+
+// std containers rank and select in linear time; cap their work per row
+constexpr size_t LINEAR_QUERY_BUDGET = 20000000;
+
+template <typename Container, typename Key>
+std::vector<Result> runContainer(const Workload<Key> &w, bool linearRank)
+{
+    std::vector<Result> results;
+    const size_t n = w.order.size();
+    const size_t queries = w.ranks.size();
+    Container tree;
+
+    Result insert = measure("insert", n, [&]()
+                            {
+        for (const Key &key : w.order)
+            tree.insert(key); });
+    if (!w.queriesOnly)
+        results.push_back(insert);
+
+    // Hits and misses alternate
+    results.push_back(measure("lookup", queries, [&]()
+                              {
+        size_t found = 0;
+        for (size_t i = 0; i < queries; i++)
+            found += tree.contains(i % 2 == 0 ? w.sorted[w.ranks[i]] : w.aboveKeys[i]);
+        checksum += found; }));
+
+    size_t rankQueries = linearRank ? std::max<size_t>(1, std::min(queries, LINEAR_QUERY_BUDGET / n)) : queries;
+    results.push_back(measure("rank", rankQueries, [&]()
+                              {
+        size_t sum = 0;
+        for (size_t i = 0; i < rankQueries; i++)
+            sum += tree.rank(w.sorted[w.ranks[i]]);
+        checksum += sum; }));
+    results.push_back(measure("select", rankQueries, [&]()
+                              {
+        size_t hits = 0;
+        for (size_t i = 0; i < rankQueries; i++)
+            hits += tree.select(w.ranks[i]) == w.sorted[w.ranks[i]];
+        checksum += hits; }));
+    results.push_back(measure("floor", queries, [&]()
+                              {
+        size_t hits = 0;
+        for (size_t i = 0; i < queries; i++)
+            hits += tree.floor(w.aboveKeys[i]) == w.sorted[w.ranks[i]];
+        checksum += hits; }));
+    results.push_back(measure("ceiling", queries, [&]()
+                              {
+        size_t hits = 0;
+        for (size_t i = 0; i < queries; i++)
+            hits += tree.ceiling(w.belowKeys[i]) == w.sorted[w.ranks[i]];
+        checksum += hits; }));
+
+    if (w.queriesOnly)
+        return results;
+
+    // Whole-container operations repeat until about as many elements as queries are touched
+    size_t passes = std::max<size_t>(1, queries / n);
+    results.push_back(measure("iterate", passes * n, [&]()
+                              {
+        for (size_t i = 0; i < passes; i++)
+            checksum += tree.iterate(); }));
+
+    std::vector<Container> copies;
+    copies.reserve(passes);
+    results.push_back(measure("copy", passes * n, [&]()
+                              {
+        for (size_t i = 0; i < passes; i++)
+            copies.push_back(tree); }));
+    copies.clear();
+
+    results.push_back(measure("serialize", passes * n, [&]()
+                              {
+        for (size_t i = 0; i < passes; i++)
+            checksum += tree.serialize(); }));
+
+    results.push_back(measure("erase", n, [&]()
+                              {
+        for (const Key &key : w.order)
+            tree.erase(key); }));
+
+    // Refill the emptied container in increasing order
+    results.push_back(measure("append", n, [&]()
+                              {
+        for (const Key &key : w.sorted)
+            tree.append(key); }));
+    return results;
+}
+
+/**
+ * Reporting
+ */
+
+struct Row
+{
+    std::string container, keyType, workload, operation;
+    size_t size;
+    Result llrb, standard;
+};
+
+void writeCsv(std::ostream &out, const std::vector<Row> &rows)
+{
+    out << "container,key_type,workload,operation,size,llrb_ops,llrb_ns_per_op,llrb_allocs_per_op,"
+           "std_ops,std_ns_per_op,std_allocs_per_op,speedup\n";
+    for (const Row &row : rows)
+        out << row.container << ',' << row.keyType << ',' << row.workload << ',' << row.operation << ','
+            << row.size << ',' << row.llrb.ops << ',' << row.llrb.nsPerOp << ',' << row.llrb.allocsPerOp << ','
+            << row.standard.ops << ',' << row.standard.nsPerOp << ',' << row.standard.allocsPerOp << ','
+            << row.standard.nsPerOp / row.llrb.nsPerOp << '\n';
+}
+
+void writeJson(std::ostream &out, const std::vector<Row> &rows)
+{
+    out << "[\n";
+    for (size_t i = 0; i < rows.size(); i++)
+    {
+        const Row &row = rows[i];
+        out << "  {\"container\": \"" << row.container << "\", \"key_type\": \"" << row.keyType
+            << "\", \"workload\": \"" << row.workload << "\", \"operation\": \"" << row.operation
+            << "\", \"size\": " << row.size
+            << ", \"llrb\": {\"ops\": " << row.llrb.ops << ", \"ns_per_op\": " << row.llrb.nsPerOp
+            << ", \"allocs_per_op\": " << row.llrb.allocsPerOp << "}"
+            << ", \"std\": {\"ops\": " << row.standard.ops << ", \"ns_per_op\": " << row.standard.nsPerOp
+            << ", \"allocs_per_op\": " << row.standard.allocsPerOp << "}"
+            << ", \"speedup\": " << row.standard.nsPerOp / row.llrb.nsPerOp << "}"
+            << (i + 1 < rows.size() ? ",\n" : "\n");
+    }
+    out << "]\n";
+}
+
+/**
+ * Driver
+ */
+
+struct Options
+{
+    size_t minSize = 1000;
+    size_t maxSize = 1000000;
+    size_t queries = 1000000;
+    std::vector<std::string> containers{"map", "set"};
+    std::vector<std::string> workloads{"sequential", "random", "zipfian", "string"};
+    std::string format = "csv";
+    std::string output;
+};
+
+std::vector<std::string> splitList(const std::string &list)
+{
+    std::vector<std::string> items;
+    size_t start = 0;
+    while (start <= list.size())
+    {
+        size_t comma = list.find(',', start);
+        if (comma == std::string::npos)
+            comma = list.size();
+        if (comma > start)
+            items.push_back(list.substr(start, comma - start));
+        start = comma + 1;
+    }
+    return items;
+}
+
+bool parseOptions(int argc, char **argv, Options &options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--help" || i + 1 >= argc)
+            return false;
+
+        std::string value = argv[++i];
+        if (arg == "--min-size")
+            options.minSize = std::stoull(value);
+        else if (arg == "--max-size")
+            options.maxSize = std::stoull(value);
+        else if (arg == "--queries")
+            options.queries = std::stoull(value);
+        else if (arg == "--containers")
+            options.containers = splitList(value);
+        else if (arg == "--workloads")
+            options.workloads = splitList(value);
+        else if (arg == "--format" && (value == "csv" || value == "json"))
+            options.format = value;
+        else if (arg == "--output")
+            options.output = value;
+        else
+            return false;
+    }
+    return options.minSize > 0 && options.minSize <= options.maxSize && options.queries > 0;
+}
+
+template <typename LlrbContainer, typename StdContainer, typename Key>
+void runPair(const std::string &container, const Workload<Key> &w, std::vector<Row> &rows)
+{
+    std::vector<Result> llrb = runContainer<LlrbContainer>(w, false);
+    std::vector<Result> standard = runContainer<StdContainer>(w, true);
+    for (size_t i = 0; i < llrb.size(); i++)
+    {
+        rows.push_back({container, KeyTraits<Key>::name(), w.name, llrb[i].operation, w.order.size(), llrb[i], standard[i]});
+        std::cerr << container << ' ' << w.name << ' ' << llrb[i].operation << ' ' << w.order.size() << ": "
+                  << llrb[i].nsPerOp << " vs " << standard[i].nsPerOp << " ns/op\n";
+    }
+}
+
+template <typename Key>
+void runWorkload(const Options &options, const std::string &name, size_t n, std::vector<Row> &rows)
+{
+    std::mt19937_64 rng(n);
+    Workload<Key> w = makeWorkload<Key>(name, n, options.queries, rng);
+    for (const std::string &container : options.containers)
+    {
+        if (container == "map")
+            runPair<LlrbMap<Key>, StdMap<Key>>(container, w, rows);
+        else if (container == "set")
+            runPair<LlrbSet<Key>, StdSet<Key>>(container, w, rows);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    if (!parseOptions(argc, argv, options))
+    {
+        std::cerr << "Usage: " << argv[0] << " [--min-size N] [--max-size N] [--queries N]\n"
+                  << "       [--containers map,set] [--workloads sequential,random,zipfian,string]\n"
+                  << "       [--format csv|json] [--output FILE]\n";
+        return 1;
+    }
+
+    std::vector<Row> rows;
+    for (size_t n = options.minSize; n <= options.maxSize; n *= 10)
+    {
+        for (const std::string &workload : options.workloads)
+        {
+            if (workload == "string")
+                runWorkload<std::string>(options, workload, n, rows);
+            else
+                runWorkload<int>(options, workload, n, rows);
+        }
+        if (n > options.maxSize / 10)
+            break;
+    }
+
+    std::ofstream file;
+    if (!options.output.empty())
+    {
+        file.open(options.output);
+        if (!file)
+        {
+            std::cerr << "Cannot open " << options.output << '\n';
+            return 1;
+        }
+    }
+    std::ostream &out = options.output.empty() ? std::cout : file;
+
+    if (options.format == "json")
+        writeJson(out, rows);
+    else
+        writeCsv(out, rows);
+    return 0;
+}
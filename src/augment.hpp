@@ -0,0 +1,231 @@
+/**augment.hpp
+ *
+ * Node augmentation policies for Map and Set. By default every node
+ * keeps the size of its subtree for the order statistics. With
+ * NoOrderStatistics nodes keep no size at all, and the container
+ * counts its elements instead. With Aggregate<Monoid>, every node of a
+ * Map also keeps the Monoid sum of the values in its subtree, so that
+ * rangeAggregate and prefixAggregate take O(log n) time.
+ *
+ * A monoid provides
+ *
+ *     using value_type = ...;
+ *     static value_type identity();
+ *     static value_type lift(const value_t &value);
+ *     static value_type combine(const value_type &a, const value_type &b);
+ *
+ * where combine is associative and identity is its neutral element.
+ * combine need not be commutative: operands always come in key order.
+ */
+
+#ifndef RBAUGMENT_H
+#define RBAUGMENT_H
+
+#include <cstddef>
+#include <limits>
+
+// Subtree sizes only
+struct OrderStatistics
+{
+};
+
+// No subtree sizes: no rank, rankSelect or rangeCount
+struct NoOrderStatistics
+{
+};
+
+// Subtree sizes and the Monoid sum of the subtree values
+template <typename Monoid>
+struct Aggregate
+{
+};
+
+template <typename T>
+struct SumMonoid
+{
+    using value_type = T;
+    static T identity() { return T(); }
+    static T lift(const T &value) { return value; }
+    static T combine(const T &a, const T &b) { return a + b; }
+};
+
+template <typename T>
+struct MinMonoid
+{
+    using value_type = T;
+    static T identity() { return std::numeric_limits<T>::max(); }
+    static T lift(const T &value) { return value; }
+    static T combine(const T &a, const T &b) { return b < a ? b : a; }
+};
+
+template <typename T>
+struct MaxMonoid
+{
+    using value_type = T;
+    static T identity() { return std::numeric_limits<T>::lowest(); }
+    static T lift(const T &value) { return value; }
+    static T combine(const T &a, const T &b) { return a < b ? b : a; }
+};
+
+/**
+ * Per-node storage of a policy, including the color. TreeNode derives
+ * from it. The summary of a node is its subtree size and aggregate.
+ */
+
+template <typename Augment>
+struct AugmentNode
+{
+    constexpr static bool SIZED = true;
+    constexpr static bool AGGREGATED = false;
+    using aggregate_type = void;
+
+    size_t sz;
+    bool color;
+
+    explicit AugmentNode(bool c) : sz(1), color(c) {}
+
+    template <typename Node>
+    static size_t sizeOf(const Node *node) { return node == nullptr ? 0 : node->sz; }
+
+    // Estimated subtree size, for splitting parallel work
+    template <typename Node>
+    static size_t weight(const Node *node) { return sizeOf(node); }
+
+    // A node without children
+    template <typename V>
+    void liftAggregate(const V &) {}
+
+    // Recompute from the children and the value of this node
+    template <typename Node, typename V>
+    void pullSummary(const Node *left, const Node *right, const V &)
+    {
+        sz = 1 + sizeOf(left) + sizeOf(right);
+    }
+
+    // One node more or fewer below, where the children are up to date
+    template <typename Node, typename V>
+    void adjustSummary(bool grew, const Node *, const Node *, const V &)
+    {
+        if (grew)
+            sz++;
+        else
+            sz--;
+    }
+
+    // Same elements as the node this one replaces
+    void takeSummary(const AugmentNode &that) { sz = that.sz; }
+};
+
+template <>
+struct AugmentNode<NoOrderStatistics>
+{
+    constexpr static bool SIZED = false;
+    constexpr static bool AGGREGATED = false;
+    using aggregate_type = void;
+
+    bool color;
+
+    explicit AugmentNode(bool c) : color(c) {}
+
+    // Sizes are not kept; the order statistics refuse to compile
+    template <typename Node>
+    static size_t sizeOf(const Node *) { return 0; }
+
+    // A black height of b holds at least 2^b - 1 nodes
+    template <typename Node>
+    static size_t weight(const Node *node)
+    {
+        size_t height = 0;
+        for (; node != nullptr; node = node->left)
+            if (!node->color)
+                height++;
+        return (static_cast<size_t>(1) << height) - 1;
+    }
+
+    template <typename V>
+    void liftAggregate(const V &) {}
+    template <typename Node, typename V>
+    void pullSummary(const Node *, const Node *, const V &) {}
+    template <typename Node, typename V>
+    void adjustSummary(bool, const Node *, const Node *, const V &) {}
+    void takeSummary(const AugmentNode &) {}
+};
+
+template <typename Monoid>
+struct AugmentNode<Aggregate<Monoid>> : AugmentNode<OrderStatistics>
+{
+    constexpr static bool AGGREGATED = true;
+    using monoid_type = Monoid;
+    using aggregate_type = typename Monoid::value_type;
+
+    aggregate_type aggregate;
+
+    explicit AugmentNode(bool c) : AugmentNode<OrderStatistics>(c) {}
+
+    template <typename V>
+    void liftAggregate(const V &value) { aggregate = Monoid::lift(value); }
+
+    template <typename Node, typename V>
+    void pullSummary(const Node *left, const Node *right, const V &value)
+    {
+        AugmentNode<OrderStatistics>::pullSummary(left, right, value);
+
+        aggregate_type sum = Monoid::lift(value);
+        if (left != nullptr)
+            sum = Monoid::combine(left->aggregate, sum);
+        if (right != nullptr)
+            sum = Monoid::combine(sum, right->aggregate);
+        aggregate = sum;
+    }
+
+    template <typename Node, typename V>
+    void adjustSummary(bool /*grew*/, const Node *left, const Node *right, const V &value)
+    {
+        pullSummary(left, right, value);
+    }
+
+    void takeSummary(const AugmentNode &that)
+    {
+        sz = that.sz;
+        aggregate = that.aggregate;
+    }
+};
+
+/**
+ * Element count of a container. Sized trees read it off the root; the
+ * others count node allocations and releases.
+ */
+
+template <typename Augment>
+struct AugmentCount
+{
+    template <typename Node>
+    size_t size(const Node *root) const { return AugmentNode<Augment>::sizeOf(root); }
+
+    void add() {}
+    void remove() {}
+    void take(AugmentCount &) {}
+    void set(size_t) {}
+};
+
+template <>
+struct AugmentCount<NoOrderStatistics>
+{
+    size_t count = 0;
+
+    template <typename Node>
+    size_t size(const Node *) const { return count; }
+
+    void add() { count++; }
+    void remove() { count--; }
+    void set(size_t n) { count = n; }
+
+    // The nodes of that move here
+    void take(AugmentCount &that)
+    {
+        count += that.count;
+        that.count = 0;
+    }
+};
+
+#endif /*RBAUGMENT_H*/
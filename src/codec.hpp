@@ -0,0 +1,154 @@
+/**codec.hpp
+ *
+ * Codecs for the binary serialization of Map and Set. A codec for T
+ * appends the bytes of an object with encode(obj, out) and reads one
+ * back with decode(cursor, end), advancing cursor past its bytes.
+ * decode throws std::invalid_argument if the input ends too early.
+ *
+ * BinaryCodec covers trivially copyable types, stored as their object
+ * representation, and std::string, stored with a length prefix. Other
+ * types need a codec of their own. A codec may declare the fewest bytes
+ * any object takes as a static MIN_BYTES member; readers use it to
+ * reject node counts the input is too short to hold.
+ */
+
+#ifndef RBCODEC_H
+#define RBCODEC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+// Fixed-width little-endian integers, used for counts and lengths
+inline void appendUint64(std::string &out, uint64_t value)
+{
+    char bytes[8];
+    for (int i = 0; i < 8; i++)
+        bytes[i] = static_cast<char>((value >> (8 * i)) & 0xff);
+    out.append(bytes, 8);
+}
+
+inline uint64_t readUint64(const char *&cursor, const char *end)
+{
+    if (end - cursor < 8)
+        throw std::invalid_argument("Serialized input is truncated");
+
+    uint64_t value = 0;
+    for (int i = 0; i < 8; i++)
+        value |= static_cast<uint64_t>(static_cast<unsigned char>(cursor[i])) << (8 * i);
+    cursor += 8;
+    return value;
+}
+
+template <typename T, typename = void>
+struct BinaryCodec
+{
+    static_assert(std::is_trivially_copyable<T>::value, "BinaryCodec needs a trivially copyable type; pass a custom codec");
+
+    constexpr static size_t MIN_BYTES = sizeof(T);
+
+    void encode(const T &obj, std::string &out) const
+    {
+        out.append(reinterpret_cast<const char *>(&obj), sizeof(T));
+    }
+
+    T decode(const char *&cursor, const char *end) const
+    {
+        if (static_cast<size_t>(end - cursor) < sizeof(T))
+            throw std::invalid_argument("Serialized input is truncated");
+
+        T obj;
+        std::memcpy(&obj, cursor, sizeof(T));
+        cursor += sizeof(T);
+        return obj;
+    }
+};
+
+template <>
+struct BinaryCodec<std::string>
+{
+    constexpr static size_t MIN_BYTES = 8; // The length prefix
+
+    void encode(const std::string &obj, std::string &out) const
+    {
+        appendUint64(out, obj.size());
+        out.append(obj);
+    }
+
+    std::string decode(const char *&cursor, const char *end) const
+    {
+        uint64_t length = readUint64(cursor, end);
+        if (static_cast<uint64_t>(end - cursor) < length)
+            throw std::invalid_argument("Serialized input is truncated");
+
+        std::string obj(cursor, length);
+        cursor += length;
+        return obj;
+    }
+};
+
+// MIN_BYTES of a codec, 0 if it declares none
+template <typename Codec, typename = void>
+struct CodecMinBytes : std::integral_constant<size_t, 0>
+{
+};
+
+template <typename Codec>
+struct CodecMinBytes<Codec, typename std::enable_if<(Codec::MIN_BYTES > 0)>::type>
+    : std::integral_constant<size_t, Codec::MIN_BYTES>
+{
+};
+
+/**
+ * Tree layout: a header of four magic bytes, a format version and the
+ * node count, then the nodes in preorder. Each node is a flag byte
+ * followed by its encoded payload.
+ */
+
+struct TreeFormat
+{
+    constexpr static const char *MAGIC = "LLRB";
+    constexpr static char VERSION = 1;
+
+    // Flag byte of a node
+    constexpr static unsigned char RED = 1;
+    constexpr static unsigned char HAS_LEFT = 2;
+    constexpr static unsigned char HAS_RIGHT = 4;
+
+    static void appendHeader(std::string &out, uint64_t count)
+    {
+        out.append(MAGIC, 4);
+        out.push_back(static_cast<char>(VERSION));
+        appendUint64(out, count);
+    }
+
+    // Returns the node count; every node takes at least its flag byte
+    // and the fewest bytes of its payload, nodeBytes in all
+    static uint64_t readHeader(const char *&cursor, const char *end, size_t nodeBytes = 1)
+    {
+        if (end - cursor < 5 || std::memcmp(cursor, MAGIC, 4) != 0 || cursor[4] != static_cast<char>(VERSION))
+            throw std::invalid_argument("Serialized input has an unknown format");
+        cursor += 5;
+
+        uint64_t count = readUint64(cursor, end);
+        if (count > static_cast<uint64_t>(end - cursor) / nodeBytes)
+            throw std::invalid_argument("Serialized input is truncated");
+        return count;
+    }
+
+    static unsigned char readFlags(const char *&cursor, const char *end)
+    {
+        if (cursor == end)
+            throw std::invalid_argument("Serialized input is truncated");
+
+        unsigned char flags = static_cast<unsigned char>(*cursor++);
+        if (flags > (RED | HAS_LEFT | HAS_RIGHT))
+            throw std::invalid_argument("Serialized input has an invalid node");
+        return flags;
+    }
+};
+
+#endif /*RBCODEC_H*/
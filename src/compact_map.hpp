@@ -0,0 +1,202 @@
+/**compact_map.hpp
+ *
+ * Interface for a memory-compact left-leaning red black tree ordered
+ * symbol table. Nodes live in one array and link to each other by
+ * 32-bit index, and the color shares a 32-bit word with the subtree
+ * size, so a node costs 12 bytes on top of its pair: a
+ * CompactMap<uint32_t, uint32_t> node takes 20 bytes where a Map node
+ * takes 40. There are no parent links; insert and erase are recursive
+ * top-down passes, and erased slots are reused through a free list.
+ */
+
+#ifndef RBCOMPACTMAP_H
+#define RBCOMPACTMAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "compare.hpp"
+
+template <typename key_t, typename value_t, typename Compare = std::less<key_t>>
+class CompactMap
+{
+private:
+    using Index = uint32_t;
+    using Pair = std::pair<key_t, value_t>;
+
+    constexpr static Index NIL = 0xffffffff;
+    constexpr static uint32_t RED = 0x80000000;       // Top bit of sizeColor
+    constexpr static uint32_t SIZE_MASK = 0x7fffffff; // Also the capacity limit
+
+    /**
+     * Node
+     *
+     * The pair is constructed only while the slot is in use; a free slot
+     * has sizeColor 0 and links to the next free slot through left.
+     */
+
+    struct Node
+    {
+        typename std::aligned_storage<sizeof(Pair), alignof(Pair)>::type storage;
+        Index left;
+        Index right;
+        uint32_t sizeColor;
+
+        Pair &pair() { return *reinterpret_cast<Pair *>(&storage); }
+        const Pair &pair() const { return *reinterpret_cast<const Pair *>(&storage); }
+    };
+
+    // Tree attributes
+    Node *nodes;
+    Index capacity;
+    Index used; // Slots below this have been handed out at least once
+    Index freeList;
+    Index root;
+    Compare comparator;
+
+    // Node storage
+    void grow(size_t minCapacity); // Throws past SIZE_MASK slots
+    template <typename... Args>
+    Index createNode(Args &&...args);
+    void destroyNode(Index node);
+    void destroyAll();
+
+    // Utilities
+    bool less(const key_t &k1, const key_t &k2) const;
+    const key_t &keyOf(Index node) const;
+    Index nodeSize(Index node) const;
+    bool isRed(Index node) const;
+    void setRed(Index node, bool red);
+    void updateSize(Index node);
+
+    // Tree rotation & coloring
+    Index rotateLeft(Index node);
+    Index rotateRight(Index node);
+    void flipColors(Index node);
+    Index balance(Index node);
+    Index moveRedLeft(Index node);
+    Index moveRedRight(Index node);
+
+    // Recursive updates
+    template <typename P>
+    Index _insert(Index node, P &&pair, bool &added);
+    Index _eraseMin(Index node);
+    Index _erase(Index node, const key_t &key);
+
+    // Search helpers
+    Index _at(const key_t &key) const;
+    Index _floor(const key_t &key) const;
+    Index _ceiling(const key_t &key) const;
+
+public:
+    class Iterator;
+    using iterator = Iterator;
+    using const_iterator = Iterator;
+
+    /**
+     * Constructors
+     */
+
+    CompactMap();
+    CompactMap(const std::initializer_list<std::pair<key_t, value_t>> &init);
+    CompactMap(const CompactMap &that); // Deep copy, slot for slot
+    CompactMap(CompactMap &&that);
+
+    /**
+     * Utilities
+     */
+
+    size_t size() const;
+    bool empty() const;
+    void reserve(size_t count); // Room for count entries without reallocation
+    void clear();
+
+    // Bytes per entry, not counting unused capacity
+    constexpr static size_t nodeBytes() { return sizeof(Node); }
+
+    CompactMap &operator=(const CompactMap &that);
+    CompactMap &operator=(CompactMap &&that);
+    void swap(CompactMap &that);
+
+    /**
+     * Search
+     */
+
+    value_t at(const key_t &key) const;
+    bool contains(const key_t &key) const;
+
+    /**
+     * Ordered symbol table operations
+     */
+
+    int rank(const key_t &key) const;
+    key_t min() const;
+    key_t max() const;
+    key_t floor(const key_t &key) const;
+    key_t ceiling(const key_t &key) const;
+    key_t rankSelect(int rank) const;
+
+    /**
+     * Insertion & deletion
+     */
+
+    // Throws std::length_error beyond 2^31 - 1 entries
+    void insert(const std::pair<key_t, value_t> &pair);
+    void insert(std::pair<key_t, value_t> &&pair);
+    void erase(const key_t &key);
+
+    /**
+     * Destructor
+     */
+
+    ~CompactMap();
+
+    /**
+     * Inorder iterator; insert and erase invalidate it
+     */
+
+    class Iterator
+    {
+    private:
+        friend class CompactMap;
+
+        const Node *nodes;
+        std::vector<Index> path; // Nodes still to visit; back() is current
+
+        Iterator(const Node *nodes, Index root);
+        void pushLeft(Index node);
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::pair<key_t, value_t>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const value_type *;
+        using reference = const value_type &;
+
+        Iterator();
+
+        reference operator*() const;
+        pointer operator->() const;
+        bool operator==(const Iterator &that) const;
+        bool operator!=(const Iterator &that) const;
+
+        Iterator &operator++();
+        Iterator operator++(int);
+    };
+
+    const_iterator begin() const;
+    const_iterator end() const;
+    const_iterator cbegin() const;
+    const_iterator cend() const;
+};
+
+#include "compact_map.ipp"
+
+#endif /*RBCOMPACTMAP_H*/
@@ -0,0 +1,776 @@
+/**compact_map.ipp
+ *
+ * Implementation for the memory-compact left-leaning red black tree
+ * ordered symbol table.
+ *
+ * Insert and erase are the recursive top-down LLRB algorithms on node
+ * indices. Capacity for a new node is reserved before an insert
+ * descends, so the node array never moves during an update.
+ */
+
+#ifndef RBCOMPACTMAP_I
+#define RBCOMPACTMAP_I
+
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+#include "compact_map.hpp"
+
+// Node storage. Every slot comes from here, so no subtree size can
+// reach the color bit.
+template <typename key_t, typename value_t, typename Compare>
+void CompactMap<key_t, value_t, Compare>::grow(size_t minCapacity)
+{
+    if (minCapacity > SIZE_MASK)
+        throw std::length_error("CompactMap cannot hold more than 2^31 - 1 entries");
+
+    Index newCapacity = capacity < 16 ? 16 : capacity;
+    while (newCapacity < minCapacity)
+        newCapacity = newCapacity > SIZE_MASK / 2 ? SIZE_MASK : 2 * newCapacity;
+
+    std::allocator<Node> allocator;
+    Node *moved = allocator.allocate(newCapacity);
+    Index done = 0;
+    try
+    {
+        for (; done < used; done++)
+        {
+            moved[done].left = nodes[done].left;
+            moved[done].right = nodes[done].right;
+            moved[done].sizeColor = nodes[done].sizeColor;
+            if (nodes[done].sizeColor != 0)
+                new (&moved[done].storage) Pair(std::move_if_noexcept(nodes[done].pair()));
+        }
+    }
+    catch (...)
+    {
+        for (Index i = 0; i < done; i++)
+            if (moved[i].sizeColor != 0)
+                moved[i].pair().~Pair();
+        allocator.deallocate(moved, newCapacity);
+        throw;
+    }
+
+    if (nodes != nullptr)
+    {
+        for (Index i = 0; i < used; i++)
+            if (nodes[i].sizeColor != 0)
+                nodes[i].pair().~Pair();
+        allocator.deallocate(nodes, capacity);
+    }
+
+    nodes = moved;
+    capacity = newCapacity;
+}
+
+template <typename key_t, typename value_t, typename Compare>
+template <typename... Args>
+typename CompactMap<key_t, value_t, Compare>::Index CompactMap<key_t, value_t, Compare>::createNode(Args &&...args)
+{
+    // insert() has made room already, through grow() and its limit
+    Index node = freeList != NIL ? freeList : used;
+    new (&nodes[node].storage) Pair(std::forward<Args>(args)...);
+
+    if (node == freeList)
+        freeList = nodes[node].left;
+    else
+        used++;
+
+    nodes[node].left = NIL;
+    nodes[node].right = NIL;
+    nodes[node].sizeColor = RED | 1;
+    return node;
+}
+
+template <typename key_t, typename value_t, typename Compare>
+void CompactMap<key_t, value_t, Compare>::destroyNode(Index node)
+{
+    nodes[node].pair().~Pair();
+    nodes[node].sizeColor = 0;
+    nodes[node].left = freeList;
+    freeList = node;
+}
+
+template <typename key_t, typename value_t, typename Compare>
+void CompactMap<key_t, value_t, Compare>::destroyAll()
+{
+    if (nodes == nullptr)
+        return;
+
+    for (Index i = 0; i < used; i++)
+        if (nodes[i].sizeColor != 0)
+            nodes[i].pair().~Pair();
+    std::allocator<Node>().deallocate(nodes, capacity);
+
+    nodes = nullptr;
+    capacity = used = 0;
+    freeList = root = NIL;
+}
+
+// Utilities
+template <typename key_t, typename value_t, typename Compare>
+bool CompactMap<key_t, value_t, Compare>::less(const key_t &k1, const key_t &k2) const
+{
+    return keyLess(comparator, k1, k2, HasThreeWayCompare<Compare, key_t, key_t>());
+}
+
+template <typename key_t, typename value_t, typename Compare>
+const key_t &CompactMap<key_t, value_t, Compare>::keyOf(Index node) const
+{
+    return nodes[node].pair().first;
+}
+
+template <typename key_t, typename value_t, typename Compare>
+typename CompactMap<key_t, value_t, Compare>::Index CompactMap<key_t, value_t, Compare>::nodeSize(Index node) const
+{
+    return node == NIL ? 0 : nodes[node].sizeColor & SIZE_MASK;
+}
+
+template <typename key_t, typename value_t, typename Compare>
+bool CompactMap<key_t, value_t, Compare>::isRed(Index node) const
+{
+    return node != NIL && (nodes[node].sizeColor & RED) != 0;
+}
+
+template <typename key_t, typename value_t, typename Compare>
+void CompactMap<key_t, value_t, Compare>::setRed(Index node, bool red)
+{
+    nodes[node].sizeColor = (nodes[node].sizeColor & SIZE_MASK) | (red ? RED : 0);
+}
+
+template <typename key_t, typename value_t, typename Compare>
+void CompactMap<key_t, value_t, Compare>::updateSize(Index node)
+{
+    Index size = 1 + nodeSize(nodes[node].left) + nodeSize(nodes[node].right);
+    nodes[node].sizeColor = (nodes[node].sizeColor & RED) | size;
+}
+
+/**
+ * Tree rotation & coloring
+ */
+
+template <typename key_t, typename value_t, typename Compare>
+typename CompactMap<key_t, value_t, Compare>::Index CompactMap<key_t, value_t, Compare>::rotateLeft(Index node)
+{
+    Index newNode = nodes[node].right;
+    nodes[node].right = nodes[newNode].left;
+    nodes[newNode].left = node;
+
+    setRed(newNode, isRed(node));
+    setRed(node, true);
+
+    nodes[newNode].sizeColor = (nodes[newNode].sizeColor & RED) | nodeSize(node);
+    updateSize(node);
+    return newNode;
+}
+
+template <typename key_t, typename value_t, typename Compare>
+typename CompactMap<key_t, value_t, Compare>::Index CompactMap<key_t, value_t, Compare>::rotateRight(Index node)
+{
+    Index newNode = nodes[node].left;
+    nodes[node].left = nodes[newNode].right;
+    nodes[newNode].right = node;
+
+    setRed(newNode, isRed(node));
+    setRed(node, true);
+
+    nodes[newNode].sizeColor = (nodes[newNode].sizeColor & RED) | nodeSize(node);
+    updateSize(node);
+    return newNode;
+}
+
+template <typename key_t, typename value_t, typename Compare>
+void CompactMap<key_t, value_t, Compare>::flipColors(Index node)
+{
+    nodes[node].sizeColor ^= RED;
+    nodes[nodes[node].left].sizeColor ^= RED;
+    nodes[nodes[node].right].sizeColor ^= RED;
+}
+
+// Restore the LLRB shape on the way back up
+template <typename key_t, typename value_t, typename Compare>
+typename CompactMap<key_t, value_t, Compare>::Index CompactMap<key_t, value_t, Compare>::balance(Index node)
+{
+    if (isRed(nodes[node].right) && !isRed(nodes[node].left))
+        node = rotateLeft(node);
+    if (isRed(nodes[node].left) && isRed(nodes[nodes[node].left].left))
+        node = rotateRight(node);
+    if (isRed(nodes[node].left) && isRed(nodes[node].right))
+        flipColors(node);
+
+    updateSize(node);
+    return node;
+}
+
+// Deletion 2-node fixups
+template <typename key_t, typename value_t, typename Compare>
+typename CompactMap<key_t, value_t, Compare>::Index CompactMap<key_t, value_t, Compare>::moveRedLeft(Index node)
+{
+    flipColors(node);
+    if (isRed(nodes[nodes[node].right].left))
+    {
+        nodes[node].right = rotateRight(nodes[node].right);
+        node = rotateLeft(node);
+        flipColors(node);
+    }
+
+    return node;
+}
+
+template <typename key_t, typename value_t, typename Compare>
+typename CompactMap<key_t, value_t, Compare>::Index CompactMap<key_t, value_t, Compare>::moveRedRight(Index node)
+{
+    flipColors(node);
+    if (isRed(nodes[nodes[node].left].left))
+    {
+        node = rotateRight(node);
+        flipColors(node);
+    }
+
+    return node;
+}
+
+/**
+ * Recursive updates
+ */
+
+// Only the side that changed is checked, so the sibling is not read
+// unless a red link came up from below
+template <typename key_t, typename value_t, typename Compare>
+template <typename P>
+typename CompactMap<key_t, value_t, Compare>::Index CompactMap<key_t, value_t, Compare>::_insert(Index node, P &&pair, bool &added)
+{
+    if (node == NIL)
+    {
+        added = true;
+        return createNode(std::forward<P>(pair));
+    }
+
+    if (less(pair.first, keyOf(node)))
+    {
+        Index child = _insert(nodes[node].left, std::forward<P>(pair), added);
+        nodes[node].left = child;
+        if (!added || !isRed(child))
+        {
+            nodes[node].sizeColor += added;
+            return node;
+        }
+
+        nodes[node].sizeColor++;
+        if (isRed(nodes[child].left))
+            node = rotateRight(node);
+    }
+    else if (less(keyOf(node), pair.first))
+    {
+        Index child = _insert(nodes[node].right, std::forward<P>(pair), added);
+        nodes[node].right = child;
+        if (!added || !isRed(child))
+        {
+            nodes[node].sizeColor += added;
+            return node;
+        }
+
+        nodes[node].sizeColor++;
+        if (!isRed(nodes[node].left))
+            return rotateLeft(node);
+    }
+    else
+    {
+        nodes[node].pair().second = std::forward<P>(pair).second;
+        return node;
+    }
+
+    if (isRed(nodes[node].left) && isRed(nodes[node].right))
+        flipColors(node);
+    return node;
+}
+
+template <typename key_t, typename value_t, typename Compare>
+typename CompactMap<key_t, value_t, Compare>::Index CompactMap<key_t, value_t, Compare>::_eraseMin(Index node)
+{
+    if (nodes[node].left == NIL)
+    {
+        destroyNode(node);
+        return NIL;
+    }
+
+    if (!isRed(nodes[node].left) && !isRed(nodes[nodes[node].left].left))
+        node = moveRedLeft(node);
+    nodes[node].left = _eraseMin(nodes[node].left);
+    return balance(node);
+}
+
+template <typename key_t, typename value_t, typename Compare>
+typename CompactMap<key_t, value_t, Compare>::Index CompactMap<key_t, value_t, Compare>::_erase(Index node, const key_t &key)
+{
+    if (less(key, keyOf(node)))
+    {
+        if (!isRed(nodes[node].left) && !isRed(nodes[nodes[node].left].left))
+            node = moveRedLeft(node);
+        nodes[node].left = _erase(nodes[node].left, key);
+        return balance(node);
+    }
+
+    if (isRed(nodes[node].left))
+        node = rotateRight(node);
+
+    if (nodes[node].right == NIL && !less(keyOf(node), key))
+    {
+        destroyNode(node);
+        return NIL;
+    }
+
+    if (!isRed(nodes[node].right) && !isRed(nodes[nodes[node].right].left))
+        node = moveRedRight(node);
+
+    if (!less(keyOf(node), key))
+    {
+        // Take over the successor's pair and drop its slot
+        Index succ = nodes[node].right;
+        while (nodes[succ].left != NIL)
+            succ = nodes[succ].left;
+        nodes[node].pair() = std::move(nodes[succ].pair());
+        nodes[node].right = _eraseMin(nodes[node].right);
+    }
+    else
+        nodes[node].right = _erase(nodes[node].right, key);
+
+    return balance(node);
+}
+
+// Search helpers: branch on node < key and test the candidate once
+template <typename key_t, typename value_t, typename Compare>
+typename CompactMap<key_t, value_t, Compare>::Index CompactMap<key_t, value_t, Compare>::_at(const key_t &key) const
+{
+    Index candidate = _ceiling(key);
+    if (candidate == NIL || less(key, keyOf(candidate)))
+        return NIL;
+    return candidate;
+}
+
+template <typename key_t, typename value_t, typename Compare>
+typename CompactMap<key_t, value_t, Compare>::Index CompactMap<key_t, value_t, Compare>::_floor(const key_t &key) const
+{
+    Index candidate = NIL;
+    Index node = root;
+    while (node != NIL)
+    {
+        if (less(key, keyOf(node)))
+            node = nodes[node].left;
+        else
+        {
+            candidate = node;
+            node = nodes[node].right;
+        }
+    }
+
+    return candidate;
+}
+
+template <typename key_t, typename value_t, typename Compare>
+typename CompactMap<key_t, value_t, Compare>::Index CompactMap<key_t, value_t, Compare>::_ceiling(const key_t &key) const
+{
+    Index candidate = NIL;
+    Index node = root;
+    while (node != NIL)
+    {
+        if (less(keyOf(node), key))
+            node = nodes[node].right;
+        else
+        {
+            candidate = node;
+            node = nodes[node].left;
+        }
+    }
+
+    return candidate;
+}
+
+/**
+ * Constructors
+ */
+
+template <typename key_t, typename value_t, typename Compare>
+CompactMap<key_t, value_t, Compare>::CompactMap()
+    : nodes(nullptr), capacity(0), used(0), freeList(NIL), root(NIL), comparator(Compare()) {}
+
+template <typename key_t, typename value_t, typename Compare>
+CompactMap<key_t, value_t, Compare>::CompactMap(const std::initializer_list<std::pair<key_t, value_t>> &init)
+    : CompactMap()
+{
+    reserve(init.size());
+    for (const std::pair<key_t, value_t> &pair : init)
+        insert(pair);
+}
+
+// Slots keep their indices, so the links are copied as they are
+template <typename key_t, typename value_t, typename Compare>
+CompactMap<key_t, value_t, Compare>::CompactMap(const CompactMap &that)
+    : CompactMap()
+{
+    comparator = that.comparator;
+    if (that.used == 0)
+        return;
+
+    std::allocator<Node> allocator;
+    nodes = allocator.allocate(that.used);
+    capacity = that.used;
+
+    Index done = 0;
+    try
+    {
+        for (; done < that.used; done++)
+        {
+            nodes[done].left = that.nodes[done].left;
+            nodes[done].right = that.nodes[done].right;
+            nodes[done].sizeColor = that.nodes[done].sizeColor;
+            if (that.nodes[done].sizeColor != 0)
+                new (&nodes[done].storage) Pair(that.nodes[done].pair());
+        }
+    }
+    catch (...)
+    {
+        used = done;
+        destroyAll();
+        throw;
+    }
+
+    used = that.used;
+    freeList = that.freeList;
+    root = that.root;
+}
+
+template <typename key_t, typename value_t, typename Compare>
+CompactMap<key_t, value_t, Compare>::CompactMap(CompactMap &&that)
+    : CompactMap()
+{
+    swap(that);
+}
+
+/**
+ * Utilities
+ */
+
+template <typename key_t, typename value_t, typename Compare>
+size_t CompactMap<key_t, value_t, Compare>::size() const
+{
+    return nodeSize(root);
+}
+
+template <typename key_t, typename value_t, typename Compare>
+bool CompactMap<key_t, value_t, Compare>::empty() const
+{
+    return root == NIL;
+}
+
+template <typename key_t, typename value_t, typename Compare>
+void CompactMap<key_t, value_t, Compare>::reserve(size_t count)
+{
+    if (count > capacity)
+        grow(count);
+}
+
+template <typename key_t, typename value_t, typename Compare>
+void CompactMap<key_t, value_t, Compare>::clear()
+{
+    destroyAll();
+}
+
+template <typename key_t, typename value_t, typename Compare>
+CompactMap<key_t, value_t, Compare> &CompactMap<key_t, value_t, Compare>::operator=(const CompactMap &that)
+{
+    CompactMap temp(that);
+    swap(temp);
+    return *this;
+}
+
+template <typename key_t, typename value_t, typename Compare>
+CompactMap<key_t, value_t, Compare> &CompactMap<key_t, value_t, Compare>::operator=(CompactMap &&that)
+{
+    CompactMap temp(std::move(that));
+    swap(temp);
+    return *this;
+}
+
+template <typename key_t, typename value_t, typename Compare>
+void CompactMap<key_t, value_t, Compare>::swap(CompactMap &that)
+{
+    using std::swap;
+    swap(nodes, that.nodes);
+    swap(capacity, that.capacity);
+    swap(used, that.used);
+    swap(freeList, that.freeList);
+    swap(root, that.root);
+    swap(comparator, that.comparator);
+}
+
+/**
+ * Search
+ */
+
+template <typename key_t, typename value_t, typename Compare>
+value_t CompactMap<key_t, value_t, Compare>::at(const key_t &key) const
+{
+    if (empty())
+        throw std::out_of_range("Invalid search in empty container");
+
+    Index node = _at(key);
+    if (node == NIL)
+        throw std::out_of_range("Query key not found");
+    return nodes[node].pair().second;
+}
+
+template <typename key_t, typename value_t, typename Compare>
+bool CompactMap<key_t, value_t, Compare>::contains(const key_t &key) const
+{
+    return _at(key) != NIL;
+}
+
+/**
+ * Ordered symbol table operations
+ */
+
+template <typename key_t, typename value_t, typename Compare>
+int CompactMap<key_t, value_t, Compare>::rank(const key_t &key) const
+{
+    if (empty())
+        throw std::out_of_range("Invalid rank query with empty container");
+
+    size_t rank = 0;
+    Index node = root;
+    while (node != NIL)
+    {
+        if (less(keyOf(node), key))
+        {
+            rank += nodeSize(nodes[node].left) + 1;
+            node = nodes[node].right;
+        }
+        else
+            node = nodes[node].left;
+    }
+
+    return static_cast<int>(rank);
+}
+
+template <typename key_t, typename value_t, typename Compare>
+key_t CompactMap<key_t, value_t, Compare>::min() const
+{
+    if (empty())
+        throw std::out_of_range("Invalid call to min() with empty container");
+
+    Index node = root;
+    while (nodes[node].left != NIL)
+        node = nodes[node].left;
+    return keyOf(node);
+}
+
+template <typename key_t, typename value_t, typename Compare>
+key_t CompactMap<key_t, value_t, Compare>::max() const
+{
+    if (empty())
+        throw std::out_of_range("Invalid call to max() with empty container");
+
+    Index node = root;
+    while (nodes[node].right != NIL)
+        node = nodes[node].right;
+    return keyOf(node);
+}
+
+template <typename key_t, typename value_t, typename Compare>
+key_t CompactMap<key_t, value_t, Compare>::floor(const key_t &key) const
+{
+    if (empty())
+        throw std::out_of_range("Invalid call to floor() with empty container");
+
+    Index node = _floor(key);
+    if (node == NIL)
+        throw std::out_of_range("Argument to floor() is too small");
+    return keyOf(node);
+}
+
+template <typename key_t, typename value_t, typename Compare>
+key_t CompactMap<key_t, value_t, Compare>::ceiling(const key_t &key) const
+{
+    if (empty())
+        throw std::out_of_range("Invalid call to ceiling() with empty container");
+
+    Index node = _ceiling(key);
+    if (node == NIL)
+        throw std::out_of_range("Argument to ceiling() is too large");
+    return keyOf(node);
+}
+
+template <typename key_t, typename value_t, typename Compare>
+key_t CompactMap<key_t, value_t, Compare>::rankSelect(int rank) const
+{
+    if (empty())
+        throw std::out_of_range("Invalid call to rankSelect() with empty container");
+    if (rank < 0 || static_cast<size_t>(rank) >= size())
+        throw std::out_of_range("Argument to rankSelect() is invalid");
+
+    Index node = root;
+    Index remaining = static_cast<Index>(rank);
+    while (true)
+    {
+        Index leftSize = nodeSize(nodes[node].left);
+        if (remaining < leftSize)
+            node = nodes[node].left;
+        else if (remaining > leftSize)
+        {
+            remaining -= leftSize + 1;
+            node = nodes[node].right;
+        }
+        else
+            return keyOf(node);
+    }
+}
+
+/**
+ * Insertion & deletion
+ */
+
+template <typename key_t, typename value_t, typename Compare>
+void CompactMap<key_t, value_t, Compare>::insert(const std::pair<key_t, value_t> &pair)
+{
+    if (freeList == NIL && used == capacity)
+        grow(used + 1);
+
+    bool added = false;
+    root = _insert(root, pair, added);
+    setRed(root, false);
+}
+
+template <typename key_t, typename value_t, typename Compare>
+void CompactMap<key_t, value_t, Compare>::insert(std::pair<key_t, value_t> &&pair)
+{
+    if (freeList == NIL && used == capacity)
+        grow(used + 1);
+
+    bool added = false;
+    root = _insert(root, std::move(pair), added);
+    setRed(root, false);
+}
+
+template <typename key_t, typename value_t, typename Compare>
+void CompactMap<key_t, value_t, Compare>::erase(const key_t &key)
+{
+    if (empty())
+        throw std::out_of_range("Invalid erase from empty container");
+    if (_at(key) == NIL)
+        throw std::out_of_range("Erase query key not found");
+
+    if (!isRed(nodes[root].left) && !isRed(nodes[root].right))
+        setRed(root, true);
+
+    root = _erase(root, key);
+    if (root != NIL)
+        setRed(root, false);
+}
+
+/**
+ * Destructor
+ */
+
+template <typename key_t, typename value_t, typename Compare>
+CompactMap<key_t, value_t, Compare>::~CompactMap()
+{
+    destroyAll();
+}
+
+/**
+ * Inorder iterator
+ */
+
+template <typename key_t, typename value_t, typename Compare>
+CompactMap<key_t, value_t, Compare>::Iterator::Iterator() : nodes(nullptr) {}
+
+template <typename key_t, typename value_t, typename Compare>
+CompactMap<key_t, value_t, Compare>::Iterator::Iterator(const Node *nodes, Index root)
+    : nodes(nodes)
+{
+    pushLeft(root);
+}
+
+template <typename key_t, typename value_t, typename Compare>
+void CompactMap<key_t, value_t, Compare>::Iterator::pushLeft(Index node)
+{
+    for (; node != NIL; node = nodes[node].left)
+        path.push_back(node);
+}
+
+template <typename key_t, typename value_t, typename Compare>
+typename CompactMap<key_t, value_t, Compare>::Iterator::reference CompactMap<key_t, value_t, Compare>::Iterator::operator*() const
+{
+    if (path.empty())
+        throw std::out_of_range("Iterator out of bounds");
+    return nodes[path.back()].pair();
+}
+
+template <typename key_t, typename value_t, typename Compare>
+typename CompactMap<key_t, value_t, Compare>::Iterator::pointer CompactMap<key_t, value_t, Compare>::Iterator::operator->() const
+{
+    if (path.empty())
+        throw std::out_of_range("Iterator out of bounds");
+    return &nodes[path.back()].pair();
+}
+
+template <typename key_t, typename value_t, typename Compare>
+bool CompactMap<key_t, value_t, Compare>::Iterator::operator==(const Iterator &that) const
+{
+    const Pair *pair = path.empty() ? nullptr : &nodes[path.back()].pair();
+    const Pair *thatPair = that.path.empty() ? nullptr : &that.nodes[that.path.back()].pair();
+    return pair == thatPair;
+}
+
+template <typename key_t, typename value_t, typename Compare>
+bool CompactMap<key_t, value_t, Compare>::Iterator::operator!=(const Iterator &that) const
+{
+    return !(*this == that);
+}
+
+template <typename key_t, typename value_t, typename Compare>
+typename CompactMap<key_t, value_t, Compare>::Iterator &CompactMap<key_t, value_t, Compare>::Iterator::operator++()
+{
+    if (path.empty())
+        throw std::out_of_range("Iterator out of bounds");
+
+    Index node = path.back();
+    path.pop_back();
+    pushLeft(nodes[node].right);
+    return *this;
+}
+
+template <typename key_t, typename value_t, typename Compare>
+typename CompactMap<key_t, value_t, Compare>::Iterator CompactMap<key_t, value_t, Compare>::Iterator::operator++(int)
+{
+    Iterator prev = *this;
+    ++*this;
+    return prev;
+}
+
+template <typename key_t, typename value_t, typename Compare>
+typename CompactMap<key_t, value_t, Compare>::const_iterator CompactMap<key_t, value_t, Compare>::begin() const
+{
+    return Iterator(nodes, root);
+}
+
+template <typename key_t, typename value_t, typename Compare>
+typename CompactMap<key_t, value_t, Compare>::const_iterator CompactMap<key_t, value_t, Compare>::end() const
+{
+    return Iterator();
+}
+
+template <typename key_t, typename value_t, typename Compare>
+typename CompactMap<key_t, value_t, Compare>::const_iterator CompactMap<key_t, value_t, Compare>::cbegin() const
+{
+    return begin();
+}
+
+template <typename key_t, typename value_t, typename Compare>
+typename CompactMap<key_t, value_t, Compare>::const_iterator CompactMap<key_t, value_t, Compare>::cend() const
+{
+    return end();
+}
+
+#endif /*RBCOMPACTMAP_I*/
@@ -0,0 +1,68 @@
+/**compare.hpp
+ *
+ * Comparator adaptors shared by the tree containers. Besides the usual
+ * strict weak ordering operator(), a comparator may provide a member
+ * compare(a, b) that returns a negative, zero or positive int. It is
+ * detected at compile time and then used for every key comparison, so
+ * a single call tells less, equal and greater apart.
+ */
+
+#ifndef RBCOMPARE_H
+#define RBCOMPARE_H
+
+#include <type_traits>
+#include <utility>
+
+template <typename... Ts>
+struct MakeVoid
+{
+    using type = void;
+};
+
+// True if Compare has a member compare(const K1 &, const K2 &)
+template <typename Compare, typename K1, typename K2, typename = void>
+struct HasThreeWayCompare : std::false_type
+{
+};
+
+template <typename Compare, typename K1, typename K2>
+struct HasThreeWayCompare<Compare, K1, K2,
+                          typename MakeVoid<decltype(std::declval<const Compare &>().compare(
+                              std::declval<const K1 &>(), std::declval<const K2 &>()))>::type>
+    : std::true_type
+{
+};
+
+// One comparator call deciding k1 < k2
+template <typename Compare, typename K1, typename K2>
+bool keyLess(const Compare &comparator, const K1 &k1, const K2 &k2, std::true_type)
+{
+    return comparator.compare(k1, k2) < 0;
+}
+
+template <typename Compare, typename K1, typename K2>
+bool keyLess(const Compare &comparator, const K1 &k1, const K2 &k2, std::false_type)
+{
+    return comparator(k1, k2);
+}
+
+// Sign of the three-way comparison; two calls without compare()
+template <typename Compare, typename K1, typename K2>
+int keyCompare(const Compare &comparator, const K1 &k1, const K2 &k2, std::true_type)
+{
+    int cmp = comparator.compare(k1, k2);
+    return cmp < 0 ? -1 : (cmp > 0 ? 1 : 0);
+}
+
+template <typename Compare, typename K1, typename K2>
+int keyCompare(const Compare &comparator, const K1 &k1, const K2 &k2, std::false_type)
+{
+    if (comparator(k1, k2))
+        return -1;
+    else if (comparator(k2, k1))
+        return 1;
+    else
+        return 0;
+}
+
+#endif /*RBCOMPARE_H*/
@@ -0,0 +1,258 @@
+/**concurrent_map.hpp
+ *
+ * Interface for a multi-version left-leaning red black tree ordered
+ * symbol table. Writers copy the nodes on the paths they change and
+ * publish every new version with an atomic root swap, so readers never
+ * lock: a Snapshot pins one version and reads it for as long as it
+ * lives. Nodes replaced by a write are reclaimed by later writes once
+ * every snapshot that could still reach them is gone.
+ */
+
+#ifndef RBCONCURRENTMAP_H
+#define RBCONCURRENTMAP_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "compare.hpp"
+#include "pool.hpp"
+
+template <typename key_t, typename value_t, typename Compare = std::less<key_t>,
+          typename Allocator = PoolAllocator<std::pair<key_t, value_t>>>
+class ConcurrentMap
+{
+private:
+    using ComparisonResult = std::int8_t;
+    constexpr static ComparisonResult LESS_THAN = -1;
+    constexpr static ComparisonResult EQUAL_TO = 0;
+    constexpr static ComparisonResult GREATER_THAN = 1;
+    constexpr static uint64_t IDLE = ~static_cast<uint64_t>(0);
+
+    /**
+     * TreeNode
+     */
+
+    class TreeNode
+    {
+    public:
+        const static bool RED = true;
+        const static bool BLACK = false;
+
+        std::pair<key_t, value_t> p;
+        TreeNode *left;
+        TreeNode *right;
+        size_t sz;
+        bool color;
+        uint64_t version; // Write that created the node; later writes copy it
+
+        template <typename... Args>
+        TreeNode(uint64_t v, bool c, Args &&...args)
+            : p(std::forward<Args>(args)...), left(nullptr), right(nullptr), sz(1), color(c), version(v) {}
+    };
+
+    // Epoch announced by one reader, IDLE while unused
+    struct ReaderSlot
+    {
+        std::atomic<uint64_t> epoch;
+        std::atomic<bool> claimed;
+        ReaderSlot *next;
+
+        ReaderSlot() : epoch(IDLE), claimed(true), next(nullptr) {}
+    };
+
+    struct RetiredNode
+    {
+        TreeNode *node;
+        uint64_t epoch;
+    };
+
+    using NodeAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<TreeNode>;
+    using NodeAllocTraits = std::allocator_traits<NodeAllocator>;
+
+    // Published state, read without locks
+    std::atomic<TreeNode *> root;
+    std::atomic<uint64_t> epoch;
+    mutable std::atomic<ReaderSlot *> readers;
+    Compare comparator;
+
+    // Writer state, guarded by writeLock
+    std::mutex writeLock;
+    NodeAllocator alloc;
+    uint64_t version;
+    std::vector<TreeNode *> created;  // Allocated by the current write
+    std::vector<TreeNode *> replaced; // Published nodes the current write no longer uses
+    std::vector<TreeNode *> dropped;  // Nodes of the current write discarded before publication
+    std::deque<RetiredNode> retired;  // Replaced nodes waiting for older readers to leave
+
+    // Node allocation; every node is recorded as part of the current write
+    template <typename... Args>
+    TreeNode *createNode(bool color, Args &&...args);
+    void destroyNode(TreeNode *node);
+    void deleteTree(TreeNode *node);
+
+    // Utilities
+    ComparisonResult comp(const key_t &k1, const key_t &k2) const;
+    static size_t nodeSize(const TreeNode *node);
+    static bool isRed(const TreeNode *node);
+
+    // Path copying: nodes of older versions are copied before any change
+    TreeNode *own(TreeNode *node);
+    void release(TreeNode *node);
+
+    // Tree rotation & coloring on owned nodes
+    TreeNode *rotateLeft(TreeNode *node);
+    TreeNode *rotateRight(TreeNode *node);
+    void flipColors(TreeNode *node);
+    TreeNode *rbFix(TreeNode *node);
+    TreeNode *moveRedLeft(TreeNode *node);
+    TreeNode *moveRedRight(TreeNode *node);
+
+    // Recursive writers, returning the new subtree root
+    template <typename P>
+    TreeNode *_insert(TreeNode *node, P &&pair);
+    TreeNode *_eraseMin(TreeNode *node);
+    TreeNode *_erase(TreeNode *node, const key_t &key);
+
+    // Version publication and reclamation
+    template <typename F>
+    void write(F &&mutate);
+    void publish(TreeNode *newRoot);
+    void reclaim();
+    ReaderSlot *claimSlot() const;
+
+    // Searches within one version
+    const TreeNode *_at(const TreeNode *node, const key_t &key) const;
+    int _rank(const TreeNode *node, const key_t &key) const;
+    const TreeNode *_floor(const TreeNode *node, const key_t &key) const;
+    const TreeNode *_ceiling(const TreeNode *node, const key_t &key) const;
+
+public:
+    class Iterator;
+    class Snapshot;
+    using iterator = Iterator;
+    using const_iterator = Iterator;
+
+    /**
+     * Constructors
+     */
+
+    ConcurrentMap();
+    ConcurrentMap(const std::initializer_list<std::pair<key_t, value_t>> &init);
+    explicit ConcurrentMap(const Allocator &allocator);
+    ConcurrentMap(const ConcurrentMap &that) = delete;
+    ConcurrentMap &operator=(const ConcurrentMap &that) = delete;
+
+    /**
+     * Readers: never block, never allocate tree nodes
+     */
+
+    Snapshot snapshot() const;
+
+    // Single lookups through a short-lived snapshot
+    size_t size() const;
+    bool empty() const;
+    value_t at(const key_t &key) const;
+    bool contains(const key_t &key) const;
+
+    /**
+     * Writers: serialized among themselves, each publishes one version
+     */
+
+    void insert(const std::pair<key_t, value_t> &pair);
+    void insert(std::pair<key_t, value_t> &&pair);
+    void erase(const key_t &key);
+
+    // Replaced nodes not yet reclaimed
+    size_t retiredCount();
+
+    /**
+     * Destructor: no snapshot may outlive the container
+     */
+
+    ~ConcurrentMap();
+
+    /**
+     * Inorder iterator over one version
+     */
+
+    class Iterator
+    {
+    private:
+        friend class ConcurrentMap;
+
+        std::vector<const TreeNode *> path; // Nodes still to visit; back() is current
+
+        explicit Iterator(const TreeNode *root);
+        void pushLeft(const TreeNode *node);
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::pair<key_t, value_t>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const value_type *;
+        using reference = const value_type &;
+
+        Iterator();
+
+        reference operator*() const;
+        pointer operator->() const;
+        bool operator==(const Iterator &that) const;
+        bool operator!=(const Iterator &that) const;
+
+        Iterator &operator++();
+        Iterator operator++(int);
+    };
+
+    /**
+     * Snapshot: a consistent, immutable version of the container
+     */
+
+    class Snapshot
+    {
+    private:
+        friend class ConcurrentMap;
+
+        const ConcurrentMap *map;
+        ReaderSlot *slot;
+        const TreeNode *root;
+
+        Snapshot(const ConcurrentMap *map, ReaderSlot *slot, const TreeNode *root);
+        void leave();
+
+    public:
+        Snapshot(Snapshot &&that);
+        Snapshot &operator=(Snapshot &&that);
+        Snapshot(const Snapshot &that) = delete;
+        Snapshot &operator=(const Snapshot &that) = delete;
+        ~Snapshot();
+
+        size_t size() const;
+        bool empty() const;
+
+        value_t at(const key_t &key) const;
+        bool contains(const key_t &key) const;
+
+        int rank(const key_t &key) const;
+        key_t min() const;
+        key_t max() const;
+        key_t floor(const key_t &key) const;
+        key_t ceiling(const key_t &key) const;
+        key_t rankSelect(int rank) const;
+
+        const_iterator begin() const;
+        const_iterator end() const;
+    };
+};
+
+#include "concurrent_map.ipp"
+
+#endif /*RBCONCURRENTMAP_H*/
@@ -0,0 +1,829 @@
+/**concurrent_map.ipp
+ *
+ * Implementation for the multi-version left-leaning red black tree
+ * ordered symbol table.
+ *
+ * Reclamation is epoch based. A reader announces the global epoch in
+ * its slot before loading the root. A writer stores the new root and
+ * then advances the epoch; nodes it replaced are tagged with the epoch
+ * it advanced from. A reader that still sees the old root must have
+ * read the epoch before it advanced, so a node tagged t is only freed
+ * once every announced epoch is greater than t. All of these accesses
+ * are sequentially consistent.
+ */
+
+#ifndef RBCONCURRENTMAP_I
+#define RBCONCURRENTMAP_I
+
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+
+#include "concurrent_map.hpp"
+
+// Node allocation
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+template <typename... Args>
+typename ConcurrentMap<key_t, value_t, Compare, Allocator>::TreeNode *ConcurrentMap<key_t, value_t, Compare, Allocator>::createNode(bool color, Args &&...args)
+{
+    // Reserve the record first so that a failed write can free the node
+    created.push_back(nullptr);
+    TreeNode *node = NodeAllocTraits::allocate(alloc, 1);
+    try
+    {
+        NodeAllocTraits::construct(alloc, node, version, color, std::forward<Args>(args)...);
+    }
+    catch (...)
+    {
+        NodeAllocTraits::deallocate(alloc, node, 1);
+        throw;
+    }
+
+    created.back() = node;
+    return node;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+void ConcurrentMap<key_t, value_t, Compare, Allocator>::destroyNode(TreeNode *node)
+{
+    NodeAllocTraits::destroy(alloc, node);
+    NodeAllocTraits::deallocate(alloc, node, 1);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+void ConcurrentMap<key_t, value_t, Compare, Allocator>::deleteTree(TreeNode *node)
+{
+    if (node == nullptr)
+        return;
+
+    deleteTree(node->left);
+    deleteTree(node->right);
+    destroyNode(node);
+}
+
+/**
+ * Utilities
+ */
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+typename ConcurrentMap<key_t, value_t, Compare, Allocator>::ComparisonResult ConcurrentMap<key_t, value_t, Compare, Allocator>::comp(const key_t &k1, const key_t &k2) const
+{
+    return static_cast<ComparisonResult>(keyCompare(comparator, k1, k2, HasThreeWayCompare<Compare, key_t, key_t>()));
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+size_t ConcurrentMap<key_t, value_t, Compare, Allocator>::nodeSize(const TreeNode *node)
+{
+    return node == nullptr ? 0 : node->sz;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+bool ConcurrentMap<key_t, value_t, Compare, Allocator>::isRed(const TreeNode *node)
+{
+    if (node == nullptr)
+        return TreeNode::BLACK;
+    else
+        return node->color;
+}
+
+/**
+ * Path copying
+ */
+
+// Returns a node of the current write holding the contents of node
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+typename ConcurrentMap<key_t, value_t, Compare, Allocator>::TreeNode *ConcurrentMap<key_t, value_t, Compare, Allocator>::own(TreeNode *node)
+{
+    if (node->version == version)
+        return node;
+
+    TreeNode *copy = createNode(node->color, node->p);
+    copy->left = node->left;
+    copy->right = node->right;
+    copy->sz = node->sz;
+    replaced.push_back(node);
+    return copy;
+}
+
+// Drop a node that is no longer part of the version being built
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+void ConcurrentMap<key_t, value_t, Compare, Allocator>::release(TreeNode *node)
+{
+    if (node->version == version)
+        dropped.push_back(node);
+    else
+        replaced.push_back(node);
+}
+
+/**
+ * Red-black scheme helpers
+ */
+
+// Every step goes through own(), which copies nodes of older write versions
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+typename ConcurrentMap<key_t, value_t, Compare, Allocator>::TreeNode *ConcurrentMap<key_t, value_t, Compare, Allocator>::rotateLeft(TreeNode *node)
+{
+    node = own(node);
+    TreeNode *newNode = own(node->right);
+    node->right = newNode->left;
+    newNode->left = node;
+
+    // Enforce color
+    newNode->color = node->color;
+    node->color = TreeNode::RED;
+
+    // Size update
+    newNode->sz = node->sz;
+    node->sz = 1 + nodeSize(node->left) + nodeSize(node->right);
+    return newNode;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+typename ConcurrentMap<key_t, value_t, Compare, Allocator>::TreeNode *ConcurrentMap<key_t, value_t, Compare, Allocator>::rotateRight(TreeNode *node)
+{
+    node = own(node);
+    TreeNode *newNode = own(node->left);
+    node->left = newNode->right;
+    newNode->right = node;
+
+    // Enforce color
+    newNode->color = node->color;
+    node->color = TreeNode::RED;
+
+    // Size update
+    newNode->sz = node->sz;
+    node->sz = 1 + nodeSize(node->left) + nodeSize(node->right);
+    return newNode;
+}
+
+// node must be owned; its children are copied before they change color
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+void ConcurrentMap<key_t, value_t, Compare, Allocator>::flipColors(TreeNode *node)
+{
+    node->left = own(node->left);
+    node->right = own(node->right);
+
+    node->color = !node->color;
+    node->left->color = !node->left->color;
+    node->right->color = !node->right->color;
+}
+
+// Fixup on the way back up, node must be owned
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+typename ConcurrentMap<key_t, value_t, Compare, Allocator>::TreeNode *ConcurrentMap<key_t, value_t, Compare, Allocator>::rbFix(TreeNode *node)
+{
+    if (isRed(node->right) && !isRed(node->left))
+        node = rotateLeft(node);
+    if (isRed(node->left) && isRed(node->left->left))
+        node = rotateRight(node);
+    if (isRed(node->left) && isRed(node->right))
+        flipColors(node);
+
+    node->sz = 1 + nodeSize(node->left) + nodeSize(node->right);
+    return node;
+}
+
+// Deletion 2-node fixups, node must be owned
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+typename ConcurrentMap<key_t, value_t, Compare, Allocator>::TreeNode *ConcurrentMap<key_t, value_t, Compare, Allocator>::moveRedLeft(TreeNode *node)
+{
+    flipColors(node);
+    if (isRed(node->right->left))
+    {
+        node->right = rotateRight(node->right);
+        node = rotateLeft(node);
+        flipColors(node);
+    }
+
+    return node;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+typename ConcurrentMap<key_t, value_t, Compare, Allocator>::TreeNode *ConcurrentMap<key_t, value_t, Compare, Allocator>::moveRedRight(TreeNode *node)
+{
+    flipColors(node);
+    if (isRed(node->left->left))
+    {
+        node = rotateRight(node);
+        flipColors(node);
+    }
+
+    return node;
+}
+
+/**
+ * Recursive writers
+ */
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+template <typename P>
+typename ConcurrentMap<key_t, value_t, Compare, Allocator>::TreeNode *ConcurrentMap<key_t, value_t, Compare, Allocator>::_insert(TreeNode *node, P &&pair)
+{
+    if (node == nullptr)
+        return createNode(TreeNode::RED, std::forward<P>(pair));
+
+    node = own(node);
+    ComparisonResult cmp = comp(pair.first, node->p.first);
+    if (cmp == LESS_THAN)
+        node->left = _insert(node->left, std::forward<P>(pair));
+    else if (cmp == GREATER_THAN)
+        node->right = _insert(node->right, std::forward<P>(pair));
+    else
+        node->p.second = std::forward<P>(pair).second;
+
+    return rbFix(node);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+typename ConcurrentMap<key_t, value_t, Compare, Allocator>::TreeNode *ConcurrentMap<key_t, value_t, Compare, Allocator>::_eraseMin(TreeNode *node)
+{
+    if (node->left == nullptr)
+    {
+        release(node);
+        return nullptr;
+    }
+
+    // Fix 2-node if necessary
+    node = own(node);
+    if (!isRed(node->left) && !isRed(node->left->left))
+        node = moveRedLeft(node);
+
+    node->left = _eraseMin(node->left);
+    return rbFix(node);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+typename ConcurrentMap<key_t, value_t, Compare, Allocator>::TreeNode *ConcurrentMap<key_t, value_t, Compare, Allocator>::_erase(TreeNode *node, const key_t &key)
+{
+    node = own(node);
+    if (comp(key, node->p.first) == LESS_THAN)
+    {
+        // Push red link left if 2-node
+        if (!isRed(node->left) && !isRed(node->left->left))
+            node = moveRedLeft(node);
+
+        node->left = _erase(node->left, key);
+    }
+    else
+    {
+        if (isRed(node->left))
+            node = rotateRight(node);
+
+        // Simple case: leaf node deletion
+        if (comp(key, node->p.first) == EQUAL_TO && node->right == nullptr)
+        {
+            release(node);
+            return nullptr;
+        }
+
+        // Push red link right if two black nodes
+        if (!isRed(node->right) && !isRed(node->right->left))
+            node = moveRedRight(node);
+
+        // Complex case: take over the payload of the successor
+        if (comp(key, node->p.first) == EQUAL_TO)
+        {
+            const TreeNode *successor = node->right;
+            while (successor->left != nullptr)
+                successor = successor->left;
+
+            node->p = successor->p;
+            node->right = _eraseMin(node->right);
+        }
+        else
+            node->right = _erase(node->right, key);
+    }
+
+    return rbFix(node);
+}
+
+/**
+ * Version publication and reclamation
+ */
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+template <typename F>
+void ConcurrentMap<key_t, value_t, Compare, Allocator>::write(F &&mutate)
+{
+    std::lock_guard<std::mutex> guard(writeLock);
+    version++;
+
+    TreeNode *newRoot = nullptr;
+    try
+    {
+        newRoot = mutate(root.load(std::memory_order_relaxed));
+    }
+    catch (...)
+    {
+        // Nothing was published: free this write's nodes, keep the old ones
+        for (TreeNode *node : created)
+            if (node != nullptr)
+                destroyNode(node);
+        created.clear();
+        replaced.clear();
+        dropped.clear();
+        throw;
+    }
+
+    publish(newRoot);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+void ConcurrentMap<key_t, value_t, Compare, Allocator>::publish(TreeNode *newRoot)
+{
+    root.store(newRoot);
+    uint64_t retiredEpoch = epoch.fetch_add(1);
+
+    for (TreeNode *node : replaced)
+        retired.push_back({node, retiredEpoch});
+    for (TreeNode *node : dropped)
+        destroyNode(node);
+
+    created.clear();
+    replaced.clear();
+    dropped.clear();
+    reclaim();
+}
+
+// Free the retired nodes that no announced reader can reach
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+void ConcurrentMap<key_t, value_t, Compare, Allocator>::reclaim()
+{
+    uint64_t oldest = IDLE;
+    for (ReaderSlot *slot = readers.load(); slot != nullptr; slot = slot->next)
+    {
+        uint64_t announced = slot->epoch.load();
+        if (announced < oldest)
+            oldest = announced;
+    }
+
+    // Retired nodes are queued in epoch order
+    while (!retired.empty() && retired.front().epoch < oldest)
+    {
+        destroyNode(retired.front().node);
+        retired.pop_front();
+    }
+}
+
+// Reuse an idle slot, or push a new one; lock-free
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+typename ConcurrentMap<key_t, value_t, Compare, Allocator>::ReaderSlot *ConcurrentMap<key_t, value_t, Compare, Allocator>::claimSlot() const
+{
+    for (ReaderSlot *slot = readers.load(std::memory_order_acquire); slot != nullptr; slot = slot->next)
+        if (!slot->claimed.load(std::memory_order_relaxed) && !slot->claimed.exchange(true, std::memory_order_acquire))
+            return slot;
+
+    ReaderSlot *slot = new ReaderSlot();
+    ReaderSlot *head = readers.load(std::memory_order_relaxed);
+    do
+        slot->next = head;
+    while (!readers.compare_exchange_weak(head, slot, std::memory_order_release, std::memory_order_relaxed));
+
+    return slot;
+}
+
+/**
+ * Searches within one version
+ */
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+const typename ConcurrentMap<key_t, value_t, Compare, Allocator>::TreeNode *ConcurrentMap<key_t, value_t, Compare, Allocator>::_at(const TreeNode *node, const key_t &key) const
+{
+    while (node != nullptr)
+    {
+        ComparisonResult cmp = comp(key, node->p.first);
+        if (cmp == EQUAL_TO)
+            return node;
+        node = cmp == LESS_THAN ? node->left : node->right;
+    }
+
+    return nullptr;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+int ConcurrentMap<key_t, value_t, Compare, Allocator>::_rank(const TreeNode *node, const key_t &key) const
+{
+    int rank = 0;
+    while (node != nullptr)
+    {
+        if (comp(node->p.first, key) == LESS_THAN)
+        {
+            rank += nodeSize(node->left) + 1;
+            node = node->right;
+        }
+        else
+            node = node->left;
+    }
+
+    return rank;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+const typename ConcurrentMap<key_t, value_t, Compare, Allocator>::TreeNode *ConcurrentMap<key_t, value_t, Compare, Allocator>::_floor(const TreeNode *node, const key_t &key) const
+{
+    const TreeNode *candidate = nullptr;
+    while (node != nullptr)
+    {
+        if (comp(key, node->p.first) == LESS_THAN)
+            node = node->left;
+        else
+        {
+            candidate = node;
+            node = node->right;
+        }
+    }
+
+    return candidate;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+const typename ConcurrentMap<key_t, value_t, Compare, Allocator>::TreeNode *ConcurrentMap<key_t, value_t, Compare, Allocator>::_ceiling(const TreeNode *node, const key_t &key) const
+{
+    const TreeNode *candidate = nullptr;
+    while (node != nullptr)
+    {
+        if (comp(node->p.first, key) == LESS_THAN)
+            node = node->right;
+        else
+        {
+            candidate = node;
+            node = node->left;
+        }
+    }
+
+    return candidate;
+}
+
+/**
+ * Constructors
+ */
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+ConcurrentMap<key_t, value_t, Compare, Allocator>::ConcurrentMap()
+    : root(nullptr), epoch(0), readers(nullptr), alloc(), version(0) {}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+ConcurrentMap<key_t, value_t, Compare, Allocator>::ConcurrentMap(const std::initializer_list<std::pair<key_t, value_t>> &init)
+    : ConcurrentMap()
+{
+    for (const std::pair<key_t, value_t> &pair : init)
+        insert(pair);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+ConcurrentMap<key_t, value_t, Compare, Allocator>::ConcurrentMap(const Allocator &allocator)
+    : root(nullptr), epoch(0), readers(nullptr), alloc(allocator), version(0) {}
+
+/**
+ * Readers
+ */
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+typename ConcurrentMap<key_t, value_t, Compare, Allocator>::Snapshot ConcurrentMap<key_t, value_t, Compare, Allocator>::snapshot() const
+{
+    // Announce before loading the root, see the file comment
+    ReaderSlot *slot = claimSlot();
+    slot->epoch.store(epoch.load());
+    return Snapshot(this, slot, root.load());
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+size_t ConcurrentMap<key_t, value_t, Compare, Allocator>::size() const
+{
+    return snapshot().size();
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+bool ConcurrentMap<key_t, value_t, Compare, Allocator>::empty() const
+{
+    return snapshot().empty();
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+value_t ConcurrentMap<key_t, value_t, Compare, Allocator>::at(const key_t &key) const
+{
+    return snapshot().at(key);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+bool ConcurrentMap<key_t, value_t, Compare, Allocator>::contains(const key_t &key) const
+{
+    return snapshot().contains(key);
+}
+
+/**
+ * Writers
+ */
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+void ConcurrentMap<key_t, value_t, Compare, Allocator>::insert(const std::pair<key_t, value_t> &pair)
+{
+    write([&](TreeNode *node)
+          {
+              node = _insert(node, pair);
+              node->color = TreeNode::BLACK;
+              return node; });
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+void ConcurrentMap<key_t, value_t, Compare, Allocator>::insert(std::pair<key_t, value_t> &&pair)
+{
+    write([&](TreeNode *node)
+          {
+              node = _insert(node, std::move(pair));
+              node->color = TreeNode::BLACK;
+              return node; });
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+void ConcurrentMap<key_t, value_t, Compare, Allocator>::erase(const key_t &key)
+{
+    write([&](TreeNode *node)
+          {
+              if (node == nullptr)
+                  throw std::out_of_range("Invalid erase from empty container");
+              if (_at(node, key) == nullptr)
+                  throw std::out_of_range("Erase query key not found");
+
+              if (!isRed(node->left) && !isRed(node->right))
+              {
+                  node = own(node);
+                  node->color = TreeNode::RED;
+              }
+
+              node = _erase(node, key);
+              if (node != nullptr)
+                  node->color = TreeNode::BLACK;
+              return node; });
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+size_t ConcurrentMap<key_t, value_t, Compare, Allocator>::retiredCount()
+{
+    std::lock_guard<std::mutex> guard(writeLock);
+    reclaim();
+    return retired.size();
+}
+
+/**
+ * Destructor
+ */
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+ConcurrentMap<key_t, value_t, Compare, Allocator>::~ConcurrentMap()
+{
+    deleteTree(root.load());
+    for (RetiredNode &entry : retired)
+        destroyNode(entry.node);
+
+    ReaderSlot *slot = readers.load();
+    while (slot != nullptr)
+    {
+        ReaderSlot *next = slot->next;
+        delete slot;
+        slot = next;
+    }
+}
+
+/**
+ * Inorder iterator
+ */
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+ConcurrentMap<key_t, value_t, Compare, Allocator>::Iterator::Iterator() {}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+ConcurrentMap<key_t, value_t, Compare, Allocator>::Iterator::Iterator(const TreeNode *root)
+{
+    pushLeft(root);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+void ConcurrentMap<key_t, value_t, Compare, Allocator>::Iterator::pushLeft(const TreeNode *node)
+{
+    for (; node != nullptr; node = node->left)
+        path.push_back(node);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+typename ConcurrentMap<key_t, value_t, Compare, Allocator>::Iterator::reference ConcurrentMap<key_t, value_t, Compare, Allocator>::Iterator::operator*() const
+{
+    if (path.empty())
+        throw std::out_of_range("Iterator out of bounds");
+    return path.back()->p;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+typename ConcurrentMap<key_t, value_t, Compare, Allocator>::Iterator::pointer ConcurrentMap<key_t, value_t, Compare, Allocator>::Iterator::operator->() const
+{
+    if (path.empty())
+        throw std::out_of_range("Iterator out of bounds");
+    return &path.back()->p;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+bool ConcurrentMap<key_t, value_t, Compare, Allocator>::Iterator::operator==(const Iterator &that) const
+{
+    const TreeNode *node = path.empty() ? nullptr : path.back();
+    const TreeNode *thatNode = that.path.empty() ? nullptr : that.path.back();
+    return node == thatNode;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+bool ConcurrentMap<key_t, value_t, Compare, Allocator>::Iterator::operator!=(const Iterator &that) const
+{
+    return !(*this == that);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+typename ConcurrentMap<key_t, value_t, Compare, Allocator>::Iterator &ConcurrentMap<key_t, value_t, Compare, Allocator>::Iterator::operator++()
+{
+    if (path.empty())
+        throw std::out_of_range("Iterator out of bounds");
+
+    const TreeNode *node = path.back();
+    path.pop_back();
+    pushLeft(node->right);
+    return *this;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+typename ConcurrentMap<key_t, value_t, Compare, Allocator>::Iterator ConcurrentMap<key_t, value_t, Compare, Allocator>::Iterator::operator++(int)
+{
+    Iterator prev = *this;
+    ++*this;
+    return prev;
+}
+
+/**
+ * Snapshot
+ */
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+ConcurrentMap<key_t, value_t, Compare, Allocator>::Snapshot::Snapshot(const ConcurrentMap *map, ReaderSlot *slot, const TreeNode *root)
+    : map(map), slot(slot), root(root) {}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+ConcurrentMap<key_t, value_t, Compare, Allocator>::Snapshot::Snapshot(Snapshot &&that)
+    : map(that.map), slot(that.slot), root(that.root)
+{
+    that.slot = nullptr;
+    that.root = nullptr;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+typename ConcurrentMap<key_t, value_t, Compare, Allocator>::Snapshot &ConcurrentMap<key_t, value_t, Compare, Allocator>::Snapshot::operator=(Snapshot &&that)
+{
+    if (this != &that)
+    {
+        leave();
+        map = that.map;
+        slot = that.slot;
+        root = that.root;
+        that.slot = nullptr;
+        that.root = nullptr;
+    }
+
+    return *this;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+void ConcurrentMap<key_t, value_t, Compare, Allocator>::Snapshot::leave()
+{
+    if (slot != nullptr)
+    {
+        slot->epoch.store(IDLE);
+        slot->claimed.store(false, std::memory_order_release);
+        slot = nullptr;
+    }
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+ConcurrentMap<key_t, value_t, Compare, Allocator>::Snapshot::~Snapshot()
+{
+    leave();
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+size_t ConcurrentMap<key_t, value_t, Compare, Allocator>::Snapshot::size() const
+{
+    return nodeSize(root);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+bool ConcurrentMap<key_t, value_t, Compare, Allocator>::Snapshot::empty() const
+{
+    return root == nullptr;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+value_t ConcurrentMap<key_t, value_t, Compare, Allocator>::Snapshot::at(const key_t &key) const
+{
+    if (empty())
+        throw std::out_of_range("Invalid search in empty container");
+
+    const TreeNode *queryNode = map->_at(root, key);
+    if (queryNode == nullptr)
+        throw std::out_of_range("Query key not found");
+    return queryNode->p.second;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+bool ConcurrentMap<key_t, value_t, Compare, Allocator>::Snapshot::contains(const key_t &key) const
+{
+    return map->_at(root, key) != nullptr;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+int ConcurrentMap<key_t, value_t, Compare, Allocator>::Snapshot::rank(const key_t &key) const
+{
+    return map->_rank(root, key);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+key_t ConcurrentMap<key_t, value_t, Compare, Allocator>::Snapshot::min() const
+{
+    if (empty())
+        throw std::out_of_range("Invalid call to min() with empty container");
+
+    const TreeNode *node = root;
+    while (node->left != nullptr)
+        node = node->left;
+    return node->p.first;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+key_t ConcurrentMap<key_t, value_t, Compare, Allocator>::Snapshot::max() const
+{
+    if (empty())
+        throw std::out_of_range("Invalid call to max() with empty container");
+
+    const TreeNode *node = root;
+    while (node->right != nullptr)
+        node = node->right;
+    return node->p.first;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+key_t ConcurrentMap<key_t, value_t, Compare, Allocator>::Snapshot::floor(const key_t &key) const
+{
+    if (empty())
+        throw std::out_of_range("Invalid call to floor() with empty container");
+
+    const TreeNode *queryNode = map->_floor(root, key);
+    if (queryNode == nullptr)
+        throw std::out_of_range("Argument to floor() is too small");
+    return queryNode->p.first;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+key_t ConcurrentMap<key_t, value_t, Compare, Allocator>::Snapshot::ceiling(const key_t &key) const
+{
+    if (empty())
+        throw std::out_of_range("Invalid call to ceiling() with empty container");
+
+    const TreeNode *queryNode = map->_ceiling(root, key);
+    if (queryNode == nullptr)
+        throw std::out_of_range("Argument to ceiling() is too large");
+    return queryNode->p.first;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+key_t ConcurrentMap<key_t, value_t, Compare, Allocator>::Snapshot::rankSelect(int rank) const
+{
+    if (empty())
+        throw std::out_of_range("Invalid call to rankSelect() with empty container");
+    if (rank < 0 || static_cast<size_t>(rank) >= size())
+        throw std::out_of_range("Argument to rankSelect() is invalid");
+
+    const TreeNode *node = root;
+    size_t remaining = rank;
+    while (true)
+    {
+        size_t leftSize = nodeSize(node->left);
+        if (remaining < leftSize)
+            node = node->left;
+        else if (remaining > leftSize)
+        {
+            remaining -= leftSize + 1;
+            node = node->right;
+        }
+        else
+            return node->p.first;
+    }
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+typename ConcurrentMap<key_t, value_t, Compare, Allocator>::const_iterator ConcurrentMap<key_t, value_t, Compare, Allocator>::Snapshot::begin() const
+{
+    return Iterator(root);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+typename ConcurrentMap<key_t, value_t, Compare, Allocator>::const_iterator ConcurrentMap<key_t, value_t, Compare, Allocator>::Snapshot::end() const
+{
+    return Iterator();
+}
+
+#endif /*RBCONCURRENTMAP_I*/
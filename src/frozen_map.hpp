@@ -0,0 +1,132 @@
+/**frozen_map.hpp
+ *
+ * Interface for an immutable ordered symbol table, produced by
+ * Map::freeze(). Keys are stored in one contiguous array in Eytzinger
+ * (breadth-first) order, so a search reads the top levels of the tree
+ * from a few cache lines and prefetches the levels below. Values sit
+ * in a second array in the same order. Nothing else is stored: sorted
+ * positions are computed from the slot numbers.
+ */
+
+#ifndef RBFROZENMAP_H
+#define RBFROZENMAP_H
+
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include "compare.hpp"
+
+template <typename key_t, typename value_t, typename Compare = std::less<key_t>>
+class FrozenMap
+{
+private:
+    std::vector<key_t> keys;     // Eytzinger order: slot k at keys[k - 1], children 2k and 2k + 1
+    std::vector<value_t> values; // Same order as keys
+    Compare comparator;
+
+    // Descendants this many levels down share the cache line being prefetched
+    static constexpr size_t prefetchDepth();
+
+    bool less(const key_t &k1, const key_t &k2) const;
+    static size_t firstSlot(size_t n);
+    static size_t nextSlot(size_t slot, size_t n);
+    static size_t level(size_t slot); // Depth of a slot, the root at 0
+
+    // Sorted position of a slot and back, in a tree of n slots
+    static size_t slotRank(size_t slot, size_t n);
+    static size_t rankSlot(size_t rank, size_t n);
+
+    // Slot of the first key not less than key, 0 if there is none
+    size_t lowerSlot(const key_t &key) const;
+
+public:
+    class Iterator;
+    using iterator = Iterator;
+    using const_iterator = Iterator;
+
+    /**
+     * Constructors
+     */
+
+    FrozenMap();
+
+    // Pairs must be strictly increasing by key
+    explicit FrozenMap(std::vector<std::pair<key_t, value_t>> sorted, const Compare &comparator = Compare(), bool checkSorted = true);
+
+    /**
+     * Utilities
+     */
+
+    size_t size() const;
+    bool empty() const;
+
+    /**
+     * Search
+     */
+
+    value_t at(const key_t &key) const;
+    bool contains(const key_t &key) const;
+
+    /**
+     * Ordered symbol table operations
+     */
+
+    int rank(const key_t &key) const;
+    key_t min() const;
+    key_t max() const;
+    key_t floor(const key_t &key) const;
+    key_t ceiling(const key_t &key) const;
+    key_t rankSelect(int rank) const;
+
+    /**
+     * Sorted iteration
+     */
+
+    // Walks the slots in order. Keys and values live in separate
+    // arrays, so an entry is a pair of references rather than a pair.
+    class Iterator
+    {
+    private:
+        friend class FrozenMap;
+
+        const FrozenMap *map;
+        size_t slot; // 0 past the end
+
+        Iterator(const FrozenMap *map, size_t slot);
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::pair<key_t, value_t>;
+        using difference_type = std::ptrdiff_t;
+        using reference = std::pair<const key_t &, const value_t &>;
+
+        // operator-> needs an address, so the entry is held by value
+        struct pointer
+        {
+            reference entry;
+            const reference *operator->() const { return &entry; }
+        };
+
+        Iterator();
+
+        reference operator*() const;
+        pointer operator->() const;
+        bool operator==(const Iterator &that) const;
+        bool operator!=(const Iterator &that) const;
+
+        Iterator &operator++();
+        Iterator operator++(int);
+    };
+
+    const_iterator begin() const;
+    const_iterator end() const;
+    const_iterator cbegin() const;
+    const_iterator cend() const;
+};
+
+#include "frozen_map.ipp"
+
+#endif /*RBFROZENMAP_H*/
@@ -0,0 +1,334 @@
+/**frozen_map.ipp
+ *
+ * Implementation for the immutable Eytzinger-ordered symbol table.
+ *
+ * Slots are numbered from 1 like a binary heap. A search descends with
+ * slot = 2 * slot + (key at slot < query) until it falls off the array,
+ * without a data-dependent branch. The slots passed on the way are
+ * encoded in the bits of the final number: the last left turn is found
+ * by shifting out the trailing right turns, and the node where it was
+ * taken holds the first key not less than the query.
+ *
+ * The sorted position of a slot follows from its number. With every
+ * level full, a slot at depth d of a tree of height h is the
+ * (2 * (slot - 2^d) + 1) * 2^(h - 1 - d)-th key in order. The last
+ * level is filled from the left, so the missing leaves, which would
+ * take every other position at the end, are subtracted.
+ */
+
+#ifndef RBFROZENMAP_I
+#define RBFROZENMAP_I
+
+#include <stdexcept>
+#include <utility>
+
+#include "frozen_map.hpp"
+
+template <typename key_t, typename value_t, typename Compare>
+constexpr size_t FrozenMap<key_t, value_t, Compare>::prefetchDepth()
+{
+    size_t depth = 0;
+    while ((static_cast<size_t>(2) << depth) * sizeof(key_t) <= 64)
+        depth++;
+    return depth;
+}
+
+template <typename key_t, typename value_t, typename Compare>
+bool FrozenMap<key_t, value_t, Compare>::less(const key_t &k1, const key_t &k2) const
+{
+    return keyLess(comparator, k1, k2, HasThreeWayCompare<Compare, key_t, key_t>());
+}
+
+// In-order traversal of the implicit tree of n slots
+template <typename key_t, typename value_t, typename Compare>
+size_t FrozenMap<key_t, value_t, Compare>::firstSlot(size_t n)
+{
+    size_t slot = n == 0 ? 0 : 1;
+    while (slot != 0 && 2 * slot <= n)
+        slot = 2 * slot;
+    return slot;
+}
+
+template <typename key_t, typename value_t, typename Compare>
+size_t FrozenMap<key_t, value_t, Compare>::nextSlot(size_t slot, size_t n)
+{
+    if (2 * slot + 1 <= n)
+    {
+        slot = 2 * slot + 1;
+        while (2 * slot <= n)
+            slot = 2 * slot;
+        return slot;
+    }
+
+    // Climb past the right children, then once more
+    while (slot & 1)
+        slot >>= 1;
+    return slot >> 1;
+}
+
+template <typename key_t, typename value_t, typename Compare>
+size_t FrozenMap<key_t, value_t, Compare>::level(size_t slot)
+{
+    size_t depth = 0;
+    while (slot >>= 1)
+        depth++;
+    return depth;
+}
+
+template <typename key_t, typename value_t, typename Compare>
+size_t FrozenMap<key_t, value_t, Compare>::slotRank(size_t slot, size_t n)
+{
+    size_t last = level(n);
+    size_t leaves = n - ((static_cast<size_t>(1) << last) - 1); // On the last level
+    size_t depth = level(slot);
+    size_t full = ((2 * (slot - (static_cast<size_t>(1) << depth)) + 1) << (last - depth)) - 1;
+    size_t missing = (full + 1) / 2 > leaves ? (full + 1) / 2 - leaves : 0;
+    return full - missing;
+}
+
+template <typename key_t, typename value_t, typename Compare>
+size_t FrozenMap<key_t, value_t, Compare>::rankSlot(size_t rank, size_t n)
+{
+    size_t last = level(n);
+    size_t leaves = n - ((static_cast<size_t>(1) << last) - 1);
+    size_t full = rank < 2 * leaves ? rank : 2 * rank - 2 * leaves + 1;
+
+    // full + 1 is odd times 2^(last - depth)
+    size_t up = 0;
+    while (((full + 1) >> up & 1) == 0)
+        up++;
+    return ((full + 1) >> (up + 1)) + (static_cast<size_t>(1) << (last - up));
+}
+
+template <typename key_t, typename value_t, typename Compare>
+size_t FrozenMap<key_t, value_t, Compare>::lowerSlot(const key_t &key) const
+{
+    const size_t n = keys.size();
+    if (n == 0)
+        return 0;
+
+    size_t slot = 1;
+    while (slot <= n)
+    {
+#if defined(__GNUC__)
+        size_t ahead = slot << prefetchDepth();
+        if (ahead <= n)
+            __builtin_prefetch(&keys[ahead - 1]);
+#endif
+        slot = 2 * slot + less(keys[slot - 1], key);
+    }
+
+    while (slot & 1)
+        slot >>= 1;
+    return slot >> 1;
+}
+
+/**
+ * Constructors
+ */
+
+template <typename key_t, typename value_t, typename Compare>
+FrozenMap<key_t, value_t, Compare>::FrozenMap() {}
+
+template <typename key_t, typename value_t, typename Compare>
+FrozenMap<key_t, value_t, Compare>::FrozenMap(std::vector<std::pair<key_t, value_t>> sorted, const Compare &comparator, bool checkSorted)
+    : comparator(comparator)
+{
+    const size_t n = sorted.size();
+    if (checkSorted)
+        for (size_t i = 1; i < n; i++)
+            if (!less(sorted[i - 1].first, sorted[i].first))
+                throw std::invalid_argument("Input to FrozenMap is not strictly increasing");
+
+    // Each pair is moved out exactly once
+    keys.reserve(n);
+    values.reserve(n);
+    for (size_t slot = 1; slot <= n; slot++)
+    {
+        std::pair<key_t, value_t> &pair = sorted[slotRank(slot, n)];
+        keys.push_back(std::move(pair.first));
+        values.push_back(std::move(pair.second));
+    }
+}
+
+/**
+ * Utilities
+ */
+
+template <typename key_t, typename value_t, typename Compare>
+size_t FrozenMap<key_t, value_t, Compare>::size() const
+{
+    return keys.size();
+}
+
+template <typename key_t, typename value_t, typename Compare>
+bool FrozenMap<key_t, value_t, Compare>::empty() const
+{
+    return keys.empty();
+}
+
+/**
+ * Search
+ */
+
+template <typename key_t, typename value_t, typename Compare>
+value_t FrozenMap<key_t, value_t, Compare>::at(const key_t &key) const
+{
+    if (empty())
+        throw std::out_of_range("Invalid search in empty container");
+
+    size_t slot = lowerSlot(key);
+    if (slot == 0 || less(key, keys[slot - 1]))
+        throw std::out_of_range("Query key not found");
+    return values[slot - 1];
+}
+
+template <typename key_t, typename value_t, typename Compare>
+bool FrozenMap<key_t, value_t, Compare>::contains(const key_t &key) const
+{
+    size_t slot = lowerSlot(key);
+    return slot != 0 && !less(key, keys[slot - 1]);
+}
+
+/**
+ * Ordered symbol table operations
+ */
+
+template <typename key_t, typename value_t, typename Compare>
+int FrozenMap<key_t, value_t, Compare>::rank(const key_t &key) const
+{
+    if (empty())
+        throw std::out_of_range("Invalid rank query with empty container");
+
+    size_t slot = lowerSlot(key);
+    return static_cast<int>(slot == 0 ? size() : slotRank(slot, size()));
+}
+
+template <typename key_t, typename value_t, typename Compare>
+key_t FrozenMap<key_t, value_t, Compare>::min() const
+{
+    if (empty())
+        throw std::out_of_range("Invalid call to min() with empty container");
+    return keys[firstSlot(size()) - 1];
+}
+
+template <typename key_t, typename value_t, typename Compare>
+key_t FrozenMap<key_t, value_t, Compare>::max() const
+{
+    if (empty())
+        throw std::out_of_range("Invalid call to max() with empty container");
+    return keys[rankSlot(size() - 1, size()) - 1];
+}
+
+template <typename key_t, typename value_t, typename Compare>
+key_t FrozenMap<key_t, value_t, Compare>::floor(const key_t &key) const
+{
+    if (empty())
+        throw std::out_of_range("Invalid call to floor() with empty container");
+
+    size_t slot = lowerSlot(key);
+    if (slot != 0 && !less(key, keys[slot - 1]))
+        return keys[slot - 1];
+
+    size_t rank = slot == 0 ? size() : slotRank(slot, size());
+    if (rank == 0)
+        throw std::out_of_range("Argument to floor() is too small");
+    return keys[rankSlot(rank - 1, size()) - 1];
+}
+
+template <typename key_t, typename value_t, typename Compare>
+key_t FrozenMap<key_t, value_t, Compare>::ceiling(const key_t &key) const
+{
+    if (empty())
+        throw std::out_of_range("Invalid call to ceiling() with empty container");
+
+    size_t slot = lowerSlot(key);
+    if (slot == 0)
+        throw std::out_of_range("Argument to ceiling() is too large");
+    return keys[slot - 1];
+}
+
+template <typename key_t, typename value_t, typename Compare>
+key_t FrozenMap<key_t, value_t, Compare>::rankSelect(int rank) const
+{
+    if (empty())
+        throw std::out_of_range("Invalid call to rankSelect() with empty container");
+    if (rank < 0 || static_cast<size_t>(rank) >= size())
+        throw std::out_of_range("Argument to rankSelect() is invalid");
+    return keys[rankSlot(rank, size()) - 1];
+}
+
+/**
+ * Sorted iteration
+ */
+
+template <typename key_t, typename value_t, typename Compare>
+FrozenMap<key_t, value_t, Compare>::Iterator::Iterator() : map(nullptr), slot(0) {}
+
+template <typename key_t, typename value_t, typename Compare>
+FrozenMap<key_t, value_t, Compare>::Iterator::Iterator(const FrozenMap *map, size_t slot) : map(map), slot(slot) {}
+
+template <typename key_t, typename value_t, typename Compare>
+typename FrozenMap<key_t, value_t, Compare>::Iterator::reference FrozenMap<key_t, value_t, Compare>::Iterator::operator*() const
+{
+    return reference(map->keys[slot - 1], map->values[slot - 1]);
+}
+
+template <typename key_t, typename value_t, typename Compare>
+typename FrozenMap<key_t, value_t, Compare>::Iterator::pointer FrozenMap<key_t, value_t, Compare>::Iterator::operator->() const
+{
+    return pointer{**this};
+}
+
+template <typename key_t, typename value_t, typename Compare>
+bool FrozenMap<key_t, value_t, Compare>::Iterator::operator==(const Iterator &that) const
+{
+    return slot == that.slot;
+}
+
+template <typename key_t, typename value_t, typename Compare>
+bool FrozenMap<key_t, value_t, Compare>::Iterator::operator!=(const Iterator &that) const
+{
+    return slot != that.slot;
+}
+
+template <typename key_t, typename value_t, typename Compare>
+typename FrozenMap<key_t, value_t, Compare>::Iterator &FrozenMap<key_t, value_t, Compare>::Iterator::operator++()
+{
+    slot = nextSlot(slot, map->size());
+    return *this;
+}
+
+template <typename key_t, typename value_t, typename Compare>
+typename FrozenMap<key_t, value_t, Compare>::Iterator FrozenMap<key_t, value_t, Compare>::Iterator::operator++(int)
+{
+    Iterator old = *this;
+    ++*this;
+    return old;
+}
+
+template <typename key_t, typename value_t, typename Compare>
+typename FrozenMap<key_t, value_t, Compare>::const_iterator FrozenMap<key_t, value_t, Compare>::begin() const
+{
+    return Iterator(this, firstSlot(size()));
+}
+
+template <typename key_t, typename value_t, typename Compare>
+typename FrozenMap<key_t, value_t, Compare>::const_iterator FrozenMap<key_t, value_t, Compare>::end() const
+{
+    return Iterator(this, 0);
+}
+
+template <typename key_t, typename value_t, typename Compare>
+typename FrozenMap<key_t, value_t, Compare>::const_iterator FrozenMap<key_t, value_t, Compare>::cbegin() const
+{
+    return begin();
+}
+
+template <typename key_t, typename value_t, typename Compare>
+typename FrozenMap<key_t, value_t, Compare>::const_iterator FrozenMap<key_t, value_t, Compare>::cend() const
+{
+    return end();
+}
+
+#endif /*RBFROZENMAP_I*/
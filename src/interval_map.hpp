@@ -0,0 +1,194 @@
+/**interval_map.hpp
+ *
+ * Interface for a left-leaning red black tree of half-open intervals
+ * [lo, hi). Entries are ordered by lo, then hi; every node also keeps
+ * the largest hi in its subtree, updated like a subtree size through
+ * the rotations, so that overlap and stabbing queries skip every
+ * subtree that ends too early.
+ */
+
+#ifndef RBINTERVALMAP_H
+#define RBINTERVALMAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "link_tree.hpp"
+#include "pool.hpp"
+
+template <typename lo_t, typename hi_t, typename value_t,
+          typename Allocator = PoolAllocator<std::pair<std::pair<lo_t, hi_t>, value_t>>>
+class IntervalMap
+{
+public:
+    using interval_type = std::pair<lo_t, hi_t>;
+    using value_type = std::pair<interval_type, value_t>;
+
+private:
+    using ComparisonResult = std::int8_t;
+    constexpr static ComparisonResult LESS_THAN = -1;
+    constexpr static ComparisonResult EQUAL_TO = 0;
+    constexpr static ComparisonResult GREATER_THAN = 1;
+
+    /**
+     * TreeNode
+     */
+
+    class TreeNode
+    {
+    public:
+        const static bool RED = true;
+        const static bool BLACK = false;
+
+        value_type p;
+        TreeNode *left;
+        TreeNode *right;
+        hi_t maxHi; // Largest hi in the subtree
+        bool color;
+
+        template <typename... Args>
+        TreeNode(bool c, Args &&...args)
+            : p(std::forward<Args>(args)...), left(nullptr), right(nullptr), maxHi(p.first.second), color(c) {}
+
+        // maxHi from the children
+        void pull()
+        {
+            maxHi = p.first.second;
+            if (left != nullptr && maxHi < left->maxHi)
+                maxHi = left->maxHi;
+            if (right != nullptr && maxHi < right->maxHi)
+                maxHi = right->maxHi;
+        }
+    };
+
+    using NodeAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<TreeNode>;
+    using NodeAllocTraits = std::allocator_traits<NodeAllocator>;
+    using Links = LinkTree<TreeNode>;
+
+    // Tree attributes
+    TreeNode *root;
+    size_t count;
+    NodeAllocator alloc;
+
+    // Node allocation
+    template <typename... Args>
+    TreeNode *createNode(bool color, Args &&...args);
+    void destroyNode(TreeNode *node);
+    TreeNode *copyTree(const TreeNode *node);
+    void deleteTree(TreeNode *node);
+
+    // Utilities
+    static ComparisonResult comp(const interval_type &i1, const interval_type &i2);
+
+    // Recursive updates
+    template <typename P>
+    void _insert(TreeNode *&link, P &&pair);
+    void _erase(TreeNode *&link, const interval_type &interval);
+
+    // Search helpers
+    const TreeNode *_at(const interval_type &interval) const;
+    template <typename Before>
+    static void _collect(const TreeNode *node, const lo_t &a, const Before &startsBefore, std::vector<value_type> &out);
+
+public:
+    class Iterator;
+    using iterator = Iterator;
+    using const_iterator = Iterator;
+
+    /**
+     * Constructors
+     */
+
+    IntervalMap();
+    IntervalMap(const std::initializer_list<value_type> &init);
+    explicit IntervalMap(const Allocator &allocator);
+    IntervalMap(const IntervalMap &that); // Deep copy
+    IntervalMap(IntervalMap &&that);
+
+    /**
+     * Utilities
+     */
+
+    size_t size() const;
+    bool empty() const;
+
+    IntervalMap &operator=(const IntervalMap &that);
+    IntervalMap &operator=(IntervalMap &&that);
+
+    /**
+     * Search by exact interval
+     */
+
+    value_t at(const lo_t &lo, const hi_t &hi) const;
+    bool contains(const lo_t &lo, const hi_t &hi) const;
+
+    /**
+     * Overlap queries; intervals are half-open, so [1, 2) and [2, 3) do
+     * not overlap
+     */
+
+    bool overlaps(const lo_t &a, const hi_t &b) const;                    // Any entry meeting [a, b), O(log n)
+    std::vector<value_type> overlapping(const lo_t &a, const hi_t &b) const; // Every entry meeting [a, b), in order
+    std::vector<value_type> stab(const lo_t &point) const;                  // Every entry containing point, in order
+
+    /**
+     * Insertion & deletion
+     */
+
+    // Overwrites the value of an equal interval; throws std::invalid_argument unless lo < hi
+    void insert(const value_type &entry);
+    void insert(value_type &&entry);
+    void erase(const lo_t &lo, const hi_t &hi);
+
+    /**
+     * Destructor
+     */
+
+    ~IntervalMap();
+
+    /**
+     * Inorder iterator
+     */
+
+    class Iterator
+    {
+    private:
+        friend class IntervalMap;
+
+        std::vector<const TreeNode *> path; // Nodes still to visit; back() is current
+
+        explicit Iterator(const TreeNode *root);
+        void pushLeft(const TreeNode *node);
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = typename IntervalMap::value_type;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const value_type *;
+        using reference = const value_type &;
+
+        Iterator();
+
+        reference operator*() const;
+        pointer operator->() const;
+        bool operator==(const Iterator &that) const;
+        bool operator!=(const Iterator &that) const;
+
+        Iterator &operator++();
+        Iterator operator++(int);
+    };
+
+    const_iterator begin() const;
+    const_iterator end() const;
+    const_iterator cbegin() const;
+    const_iterator cend() const;
+};
+
+#include "interval_map.ipp"
+
+#endif /*RBINTERVALMAP_H*/
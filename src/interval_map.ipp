@@ -0,0 +1,495 @@
+/**interval_map.ipp
+ *
+ * Implementation for the left-leaning red black interval tree.
+ *
+ * maxHi is recomputed from the children by TreeNode::pull wherever a
+ * subtree changes shape: LinkTree calls it in the rotations and in
+ * rbFix on the way back up.
+ */
+
+#ifndef RBINTERVALMAP_I
+#define RBINTERVALMAP_I
+
+#include <stdexcept>
+#include <utility>
+
+#include "interval_map.hpp"
+
+// Node allocation
+template <typename lo_t, typename hi_t, typename value_t, typename Allocator>
+template <typename... Args>
+typename IntervalMap<lo_t, hi_t, value_t, Allocator>::TreeNode *IntervalMap<lo_t, hi_t, value_t, Allocator>::createNode(bool color, Args &&...args)
+{
+    TreeNode *node = NodeAllocTraits::allocate(alloc, 1);
+    try
+    {
+        NodeAllocTraits::construct(alloc, node, color, std::forward<Args>(args)...);
+    }
+    catch (...)
+    {
+        NodeAllocTraits::deallocate(alloc, node, 1);
+        throw;
+    }
+
+    count++;
+    return node;
+}
+
+template <typename lo_t, typename hi_t, typename value_t, typename Allocator>
+void IntervalMap<lo_t, hi_t, value_t, Allocator>::destroyNode(TreeNode *node)
+{
+    NodeAllocTraits::destroy(alloc, node);
+    NodeAllocTraits::deallocate(alloc, node, 1);
+    count--;
+}
+
+template <typename lo_t, typename hi_t, typename value_t, typename Allocator>
+typename IntervalMap<lo_t, hi_t, value_t, Allocator>::TreeNode *IntervalMap<lo_t, hi_t, value_t, Allocator>::copyTree(const TreeNode *node)
+{
+    if (node == nullptr)
+        return nullptr;
+
+    TreeNode *curNode = createNode(node->color, node->p);
+    curNode->maxHi = node->maxHi;
+    try
+    {
+        curNode->left = copyTree(node->left);
+        curNode->right = copyTree(node->right);
+    }
+    catch (...)
+    {
+        deleteTree(curNode);
+        throw;
+    }
+
+    return curNode;
+}
+
+template <typename lo_t, typename hi_t, typename value_t, typename Allocator>
+void IntervalMap<lo_t, hi_t, value_t, Allocator>::deleteTree(TreeNode *node)
+{
+    if (node == nullptr)
+        return;
+
+    deleteTree(node->left);
+    deleteTree(node->right);
+    destroyNode(node);
+}
+
+/**
+ * Utilities
+ */
+
+// By lo, then by hi
+template <typename lo_t, typename hi_t, typename value_t, typename Allocator>
+typename IntervalMap<lo_t, hi_t, value_t, Allocator>::ComparisonResult IntervalMap<lo_t, hi_t, value_t, Allocator>::comp(const interval_type &i1, const interval_type &i2)
+{
+    if (i1.first < i2.first)
+        return LESS_THAN;
+    else if (i2.first < i1.first)
+        return GREATER_THAN;
+    else if (i1.second < i2.second)
+        return LESS_THAN;
+    else if (i2.second < i1.second)
+        return GREATER_THAN;
+    return EQUAL_TO;
+}
+
+/**
+ * Recursive updates
+ */
+
+template <typename lo_t, typename hi_t, typename value_t, typename Allocator>
+template <typename P>
+void IntervalMap<lo_t, hi_t, value_t, Allocator>::_insert(TreeNode *&link, P &&pair)
+{
+    if (link == nullptr)
+    {
+        link = createNode(TreeNode::RED, std::forward<P>(pair));
+        return;
+    }
+
+    ComparisonResult cmp = comp(pair.first, link->p.first);
+    if (cmp == LESS_THAN)
+        _insert(link->left, std::forward<P>(pair));
+    else if (cmp == GREATER_THAN)
+        _insert(link->right, std::forward<P>(pair));
+    else
+        link->p.second = std::forward<P>(pair).second;
+
+    Links::rbFix(link);
+}
+
+template <typename lo_t, typename hi_t, typename value_t, typename Allocator>
+void IntervalMap<lo_t, hi_t, value_t, Allocator>::_erase(TreeNode *&link, const interval_type &interval)
+{
+    if (comp(interval, link->p.first) == LESS_THAN)
+    {
+        // Push red link left if 2-node
+        if (!Links::isRed(link->left) && !Links::isRed(link->left->left))
+            Links::moveRedLeft(link);
+
+        _erase(link->left, interval);
+    }
+    else
+    {
+        if (Links::isRed(link->left))
+            Links::rotateRight(link);
+
+        // Simple case: leaf node deletion
+        if (comp(interval, link->p.first) == EQUAL_TO && link->right == nullptr)
+        {
+            destroyNode(link);
+            link = nullptr;
+            return;
+        }
+
+        // Push red link right if two black nodes
+        if (!Links::isRed(link->right) && !Links::isRed(link->right->left))
+            Links::moveRedRight(link);
+
+        // Complex case: take over the payload of the successor
+        if (comp(interval, link->p.first) == EQUAL_TO)
+        {
+            TreeNode *successor = link->right;
+            while (successor->left != nullptr)
+                successor = successor->left;
+
+            link->p = std::move(successor->p);
+            destroyNode(Links::takeMin(link->right));
+        }
+        else
+            _erase(link->right, interval);
+    }
+
+    Links::rbFix(link);
+}
+
+/**
+ * Search helpers
+ */
+
+template <typename lo_t, typename hi_t, typename value_t, typename Allocator>
+const typename IntervalMap<lo_t, hi_t, value_t, Allocator>::TreeNode *IntervalMap<lo_t, hi_t, value_t, Allocator>::_at(const interval_type &interval) const
+{
+    const TreeNode *node = root;
+    while (node != nullptr)
+    {
+        ComparisonResult cmp = comp(interval, node->p.first);
+        if (cmp == EQUAL_TO)
+            return node;
+        node = cmp == LESS_THAN ? node->left : node->right;
+    }
+
+    return nullptr;
+}
+
+// Entries in order with a < hi and startsBefore(lo). Subtrees ending
+// at or before a are skipped, and so is everything right of the first
+// lo that fails startsBefore.
+template <typename lo_t, typename hi_t, typename value_t, typename Allocator>
+template <typename Before>
+void IntervalMap<lo_t, hi_t, value_t, Allocator>::_collect(const TreeNode *node, const lo_t &a, const Before &startsBefore, std::vector<value_type> &out)
+{
+    if (node == nullptr || !(a < node->maxHi))
+        return;
+
+    _collect(node->left, a, startsBefore, out);
+    if (!startsBefore(node->p.first.first))
+        return;
+    if (a < node->p.first.second)
+        out.push_back(node->p);
+    _collect(node->right, a, startsBefore, out);
+}
+
+/**
+ * Constructors
+ */
+
+template <typename lo_t, typename hi_t, typename value_t, typename Allocator>
+IntervalMap<lo_t, hi_t, value_t, Allocator>::IntervalMap()
+    : root(nullptr), count(0), alloc() {}
+
+template <typename lo_t, typename hi_t, typename value_t, typename Allocator>
+IntervalMap<lo_t, hi_t, value_t, Allocator>::IntervalMap(const std::initializer_list<value_type> &init)
+    : IntervalMap()
+{
+    for (const value_type &entry : init)
+        insert(entry);
+}
+
+template <typename lo_t, typename hi_t, typename value_t, typename Allocator>
+IntervalMap<lo_t, hi_t, value_t, Allocator>::IntervalMap(const Allocator &allocator)
+    : root(nullptr), count(0), alloc(allocator) {}
+
+template <typename lo_t, typename hi_t, typename value_t, typename Allocator>
+IntervalMap<lo_t, hi_t, value_t, Allocator>::IntervalMap(const IntervalMap &that)
+    : root(nullptr), count(0), alloc(NodeAllocTraits::select_on_container_copy_construction(that.alloc))
+{
+    root = copyTree(that.root);
+}
+
+// The allocator is copied rather than moved so that the emptied source
+// can still allocate nodes.
+template <typename lo_t, typename hi_t, typename value_t, typename Allocator>
+IntervalMap<lo_t, hi_t, value_t, Allocator>::IntervalMap(IntervalMap &&that)
+    : root(that.root), count(that.count), alloc(that.alloc)
+{
+    that.root = nullptr;
+    that.count = 0;
+}
+
+/**
+ * Utilities
+ */
+
+template <typename lo_t, typename hi_t, typename value_t, typename Allocator>
+size_t IntervalMap<lo_t, hi_t, value_t, Allocator>::size() const
+{
+    return count;
+}
+
+template <typename lo_t, typename hi_t, typename value_t, typename Allocator>
+bool IntervalMap<lo_t, hi_t, value_t, Allocator>::empty() const
+{
+    return root == nullptr;
+}
+
+template <typename lo_t, typename hi_t, typename value_t, typename Allocator>
+IntervalMap<lo_t, hi_t, value_t, Allocator> &IntervalMap<lo_t, hi_t, value_t, Allocator>::operator=(const IntervalMap &that)
+{
+    // Copy into a temporary on this allocator, which is not propagated,
+    // then swap; nodes keep moving between containers sharing a pool
+    IntervalMap temp{Allocator(alloc)};
+    temp.root = temp.copyTree(that.root);
+    std::swap(this->root, temp.root);
+    std::swap(this->count, temp.count);
+
+    return *this;
+}
+
+template <typename lo_t, typename hi_t, typename value_t, typename Allocator>
+IntervalMap<lo_t, hi_t, value_t, Allocator> &IntervalMap<lo_t, hi_t, value_t, Allocator>::operator=(IntervalMap &&that)
+{
+    // The old nodes leave with that and are freed by its destructor
+    std::swap(this->root, that.root);
+    std::swap(this->count, that.count);
+    std::swap(this->alloc, that.alloc);
+
+    return *this;
+}
+
+/**
+ * Search by exact interval
+ */
+
+template <typename lo_t, typename hi_t, typename value_t, typename Allocator>
+value_t IntervalMap<lo_t, hi_t, value_t, Allocator>::at(const lo_t &lo, const hi_t &hi) const
+{
+    if (empty())
+        throw std::out_of_range("Invalid search in empty container");
+
+    const TreeNode *queryNode = _at(interval_type(lo, hi));
+    if (queryNode == nullptr)
+        throw std::out_of_range("Query interval not found");
+    return queryNode->p.second;
+}
+
+template <typename lo_t, typename hi_t, typename value_t, typename Allocator>
+bool IntervalMap<lo_t, hi_t, value_t, Allocator>::contains(const lo_t &lo, const hi_t &hi) const
+{
+    return _at(interval_type(lo, hi)) != nullptr;
+}
+
+/**
+ * Overlap queries
+ */
+
+// One root-to-leaf descent: if the left subtree ends after a but holds
+// no overlap, its latest-ending entry starts at or after b, and so does
+// everything to the right.
+template <typename lo_t, typename hi_t, typename value_t, typename Allocator>
+bool IntervalMap<lo_t, hi_t, value_t, Allocator>::overlaps(const lo_t &a, const hi_t &b) const
+{
+    const TreeNode *node = root;
+    while (node != nullptr)
+    {
+        if (node->p.first.first < b && a < node->p.first.second)
+            return true;
+
+        if (node->left != nullptr && a < node->left->maxHi)
+            node = node->left;
+        else
+            node = node->right;
+    }
+
+    return false;
+}
+
+template <typename lo_t, typename hi_t, typename value_t, typename Allocator>
+std::vector<typename IntervalMap<lo_t, hi_t, value_t, Allocator>::value_type> IntervalMap<lo_t, hi_t, value_t, Allocator>::overlapping(const lo_t &a, const hi_t &b) const
+{
+    std::vector<value_type> out;
+    _collect(root, a, [&](const lo_t &lo)
+             { return lo < b; },
+             out);
+    return out;
+}
+
+template <typename lo_t, typename hi_t, typename value_t, typename Allocator>
+std::vector<typename IntervalMap<lo_t, hi_t, value_t, Allocator>::value_type> IntervalMap<lo_t, hi_t, value_t, Allocator>::stab(const lo_t &point) const
+{
+    std::vector<value_type> out;
+    _collect(root, point, [&](const lo_t &lo)
+             { return !(point < lo); },
+             out);
+    return out;
+}
+
+/**
+ * Insertion & deletion
+ */
+
+template <typename lo_t, typename hi_t, typename value_t, typename Allocator>
+void IntervalMap<lo_t, hi_t, value_t, Allocator>::insert(const value_type &entry)
+{
+    if (!(entry.first.first < entry.first.second))
+        throw std::invalid_argument("Interval must satisfy lo < hi");
+
+    _insert(root, entry);
+    root->color = TreeNode::BLACK;
+}
+
+template <typename lo_t, typename hi_t, typename value_t, typename Allocator>
+void IntervalMap<lo_t, hi_t, value_t, Allocator>::insert(value_type &&entry)
+{
+    if (!(entry.first.first < entry.first.second))
+        throw std::invalid_argument("Interval must satisfy lo < hi");
+
+    _insert(root, std::move(entry));
+    root->color = TreeNode::BLACK;
+}
+
+template <typename lo_t, typename hi_t, typename value_t, typename Allocator>
+void IntervalMap<lo_t, hi_t, value_t, Allocator>::erase(const lo_t &lo, const hi_t &hi)
+{
+    if (empty())
+        throw std::out_of_range("Invalid erase from empty container");
+
+    interval_type interval(lo, hi);
+    if (_at(interval) == nullptr)
+        throw std::out_of_range("Erase query interval not found");
+
+    if (!Links::isRed(root->left) && !Links::isRed(root->right))
+        root->color = TreeNode::RED;
+
+    _erase(root, interval);
+    if (root != nullptr)
+        root->color = TreeNode::BLACK;
+}
+
+/**
+ * Destructor
+ */
+
+template <typename lo_t, typename hi_t, typename value_t, typename Allocator>
+IntervalMap<lo_t, hi_t, value_t, Allocator>::~IntervalMap()
+{
+    deleteTree(root);
+}
+
+/**
+ * Inorder iterator
+ */
+
+template <typename lo_t, typename hi_t, typename value_t, typename Allocator>
+IntervalMap<lo_t, hi_t, value_t, Allocator>::Iterator::Iterator() {}
+
+template <typename lo_t, typename hi_t, typename value_t, typename Allocator>
+IntervalMap<lo_t, hi_t, value_t, Allocator>::Iterator::Iterator(const TreeNode *root)
+{
+    pushLeft(root);
+}
+
+template <typename lo_t, typename hi_t, typename value_t, typename Allocator>
+void IntervalMap<lo_t, hi_t, value_t, Allocator>::Iterator::pushLeft(const TreeNode *node)
+{
+    for (; node != nullptr; node = node->left)
+        path.push_back(node);
+}
+
+template <typename lo_t, typename hi_t, typename value_t, typename Allocator>
+typename IntervalMap<lo_t, hi_t, value_t, Allocator>::Iterator::reference IntervalMap<lo_t, hi_t, value_t, Allocator>::Iterator::operator*() const
+{
+    if (path.empty())
+        throw std::out_of_range("Iterator out of bounds");
+    return path.back()->p;
+}
+
+template <typename lo_t, typename hi_t, typename value_t, typename Allocator>
+typename IntervalMap<lo_t, hi_t, value_t, Allocator>::Iterator::pointer IntervalMap<lo_t, hi_t, value_t, Allocator>::Iterator::operator->() const
+{
+    if (path.empty())
+        throw std::out_of_range("Iterator out of bounds");
+    return &path.back()->p;
+}
+
+template <typename lo_t, typename hi_t, typename value_t, typename Allocator>
+bool IntervalMap<lo_t, hi_t, value_t, Allocator>::Iterator::operator==(const Iterator &that) const
+{
+    const TreeNode *node = path.empty() ? nullptr : path.back();
+    const TreeNode *thatNode = that.path.empty() ? nullptr : that.path.back();
+    return node == thatNode;
+}
+
+template <typename lo_t, typename hi_t, typename value_t, typename Allocator>
+bool IntervalMap<lo_t, hi_t, value_t, Allocator>::Iterator::operator!=(const Iterator &that) const
+{
+    return !(*this == that);
+}
+
+template <typename lo_t, typename hi_t, typename value_t, typename Allocator>
+typename IntervalMap<lo_t, hi_t, value_t, Allocator>::Iterator &IntervalMap<lo_t, hi_t, value_t, Allocator>::Iterator::operator++()
+{
+    if (path.empty())
+        throw std::out_of_range("Iterator out of bounds");
+
+    const TreeNode *node = path.back();
+    path.pop_back();
+    pushLeft(node->right);
+    return *this;
+}
+
+template <typename lo_t, typename hi_t, typename value_t, typename Allocator>
+typename IntervalMap<lo_t, hi_t, value_t, Allocator>::Iterator IntervalMap<lo_t, hi_t, value_t, Allocator>::Iterator::operator++(int)
+{
+    Iterator prev = *this;
+    ++*this;
+    return prev;
+}
+
+template <typename lo_t, typename hi_t, typename value_t, typename Allocator>
+typename IntervalMap<lo_t, hi_t, value_t, Allocator>::const_iterator IntervalMap<lo_t, hi_t, value_t, Allocator>::begin() const
+{
+    return Iterator(root);
+}
+
+template <typename lo_t, typename hi_t, typename value_t, typename Allocator>
+typename IntervalMap<lo_t, hi_t, value_t, Allocator>::const_iterator IntervalMap<lo_t, hi_t, value_t, Allocator>::end() const
+{
+    return Iterator();
+}
+
+template <typename lo_t, typename hi_t, typename value_t, typename Allocator>
+typename IntervalMap<lo_t, hi_t, value_t, Allocator>::const_iterator IntervalMap<lo_t, hi_t, value_t, Allocator>::cbegin() const
+{
+    return begin();
+}
+
+template <typename lo_t, typename hi_t, typename value_t, typename Allocator>
+typename IntervalMap<lo_t, hi_t, value_t, Allocator>::const_iterator IntervalMap<lo_t, hi_t, value_t, Allocator>::cend() const
+{
+    return end();
+}
+
+#endif /*RBINTERVALMAP_I*/
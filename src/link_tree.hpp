@@ -0,0 +1,240 @@
+/**link_tree.hpp
+ *
+ * Left-leaning red-black tree steps shared by the containers that
+ * rebalance recursively through link references, without parent
+ * pointers: MultiMap, MultiSet and IntervalMap. ConcurrentMap and
+ * PersistentMap copy shared nodes inside every rotation and keep
+ * their own versions.
+ *
+ * TreeNode needs left, right, color, the RED and BLACK constants, and
+ * a pull() member that recomputes its summary from its children.
+ * splitRank() also reads the subtree size sz.
+ */
+
+#ifndef RBLINKTREE_H
+#define RBLINKTREE_H
+
+#include <cstddef>
+
+template <typename TreeNode>
+struct LinkTree
+{
+    static bool isRed(const TreeNode *node)
+    {
+        return node != nullptr && node->color == TreeNode::RED;
+    }
+
+    static size_t size(const TreeNode *node)
+    {
+        return node == nullptr ? 0 : node->sz;
+    }
+
+    /**
+     * Rotation & coloring
+     */
+
+    static void rotateLeft(TreeNode *&link)
+    {
+        TreeNode *node = link;
+        TreeNode *newNode = node->right;
+        node->right = newNode->left;
+        newNode->left = node;
+        link = newNode;
+
+        // Enforce color
+        newNode->color = node->color;
+        node->color = TreeNode::RED;
+
+        node->pull();
+        newNode->pull();
+    }
+
+    static void rotateRight(TreeNode *&link)
+    {
+        TreeNode *node = link;
+        TreeNode *newNode = node->left;
+        node->left = newNode->right;
+        newNode->right = node;
+        link = newNode;
+
+        // Enforce color
+        newNode->color = node->color;
+        node->color = TreeNode::RED;
+
+        node->pull();
+        newNode->pull();
+    }
+
+    static void flipColors(TreeNode *node)
+    {
+        node->color = !node->color;
+        node->left->color = !node->left->color;
+        node->right->color = !node->right->color;
+    }
+
+    // Fixup on the way back up
+    static void rbFix(TreeNode *&link)
+    {
+        if (isRed(link->right) && !isRed(link->left))
+            rotateLeft(link);
+        if (isRed(link->left) && isRed(link->left->left))
+            rotateRight(link);
+        if (isRed(link->left) && isRed(link->right))
+            flipColors(link);
+
+        link->pull();
+    }
+
+    // Deletion 2-node fixups
+    static void moveRedLeft(TreeNode *&link)
+    {
+        flipColors(link);
+        if (isRed(link->right->left))
+        {
+            rotateRight(link->right);
+            rotateLeft(link);
+            flipColors(link);
+        }
+    }
+
+    static void moveRedRight(TreeNode *&link)
+    {
+        flipColors(link);
+        if (isRed(link->left->left))
+        {
+            rotateRight(link);
+            flipColors(link);
+        }
+    }
+
+    // Detach the minimum below link, which must not be a 2-node
+    static TreeNode *takeMin(TreeNode *&link)
+    {
+        if (link->left == nullptr)
+        {
+            TreeNode *node = link;
+            link = nullptr;
+            return node;
+        }
+
+        // Fix 2-node if necessary
+        if (!isRed(link->left) && !isRed(link->left->left))
+            moveRedLeft(link);
+
+        TreeNode *node = takeMin(link->left);
+        rbFix(link);
+        return node;
+    }
+
+    /**
+     * Split & join
+     */
+
+    // Black nodes on the left spine, the same on every path
+    static size_t blackHeight(const TreeNode *node)
+    {
+        size_t height = 0;
+        for (; node != nullptr; node = node->left)
+            height += !isRed(node);
+        return height;
+    }
+
+    // Every entry of left goes before mid and every entry of right after
+    // it; returns the black root of the joined tree
+    static TreeNode *join(TreeNode *left, TreeNode *mid, TreeNode *right)
+    {
+        if (left != nullptr)
+            left->color = TreeNode::BLACK;
+        if (right != nullptr)
+            right->color = TreeNode::BLACK;
+
+        size_t leftHeight = blackHeight(left);
+        size_t rightHeight = blackHeight(right);
+        TreeNode *root = leftHeight >= rightHeight ? joinRight(left, leftHeight, mid, right, rightHeight)
+                                                   : joinLeft(right, rightHeight, left, mid, leftHeight);
+        root->color = TreeNode::BLACK;
+        return root;
+    }
+
+    // Join without a middle entry: the minimum of right takes its place
+    static TreeNode *join(TreeNode *left, TreeNode *right)
+    {
+        if (right == nullptr)
+        {
+            if (left != nullptr)
+                left->color = TreeNode::BLACK;
+            return left;
+        }
+
+        if (!isRed(right->left) && !isRed(right->right))
+            right->color = TreeNode::RED;
+        TreeNode *mid = takeMin(right);
+        return join(left, mid, right);
+    }
+
+    // The first rank entries go to left and the rest to right, both with
+    // black roots. Each level joins once, so this takes O(log^2 n).
+    static void splitRank(TreeNode *node, size_t rank, TreeNode *&left, TreeNode *&right)
+    {
+        if (node == nullptr)
+        {
+            left = right = nullptr;
+            return;
+        }
+
+        TreeNode *below = node->left;
+        TreeNode *above = node->right;
+        size_t leftSize = size(below);
+        if (rank <= leftSize)
+        {
+            TreeNode *middle;
+            splitRank(below, rank, left, middle);
+            right = join(middle, node, above);
+        }
+        else
+        {
+            TreeNode *middle;
+            splitRank(above, rank - leftSize - 1, middle, right);
+            left = join(below, node, middle);
+        }
+    }
+
+private:
+    // Walk down the right spine of the taller left tree, whose right
+    // links are all black, to the subtree as tall as right
+    static TreeNode *joinRight(TreeNode *node, size_t height, TreeNode *mid, TreeNode *right, size_t rightHeight)
+    {
+        if (height == rightHeight)
+        {
+            mid->left = node;
+            mid->right = right;
+            mid->color = TreeNode::RED;
+            mid->pull();
+            return mid;
+        }
+
+        node->right = joinRight(node->right, height - 1, mid, right, rightHeight);
+        rbFix(node);
+        return node;
+    }
+
+    // Same down the left spine of the taller right tree, skipping red
+    // nodes, which do not count towards the height
+    static TreeNode *joinLeft(TreeNode *node, size_t height, TreeNode *left, TreeNode *mid, size_t leftHeight)
+    {
+        if (!isRed(node) && height == leftHeight)
+        {
+            mid->left = left;
+            mid->right = node;
+            mid->color = TreeNode::RED;
+            mid->pull();
+            return mid;
+        }
+
+        node->left = joinLeft(node->left, isRed(node) ? height : height - 1, left, mid, leftHeight);
+        rbFix(node);
+        return node;
+    }
+};
+
+#endif /*RBLINKTREE_H*/
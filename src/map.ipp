@@ -12,88 +12,306 @@
 #include <initializer_list>
 #include <stdexcept>
 #include <string>
+#include <tuple>
 #include <utility>
 
 #include "map.hpp"
 #include "deque.hpp"
 
-// Custom comparator
-template <typename key_t, typename value_t, typename Compare>
-typename Map<key_t, value_t, Compare>::ComparisonResult Map<key_t, value_t, Compare>::comp(const key_t &k1, const key_t &k2) const
+// Custom comparator: a single call if Compare provides compare(). The
+// statistics count comparator calls, not comparisons.
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <typename K1, typename K2>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::ComparisonResult Map<key_t, value_t, Compare, Allocator, Stats, Augment>::comp(const K1 &k1, const K2 &k2) const
 {
-    if (comparator(k1, k2))
-        return LESS_THAN;
-    else if (comparator(k2, k1))
-        return GREATER_THAN;
-    else
-        return EQUAL_TO;
+    ComparisonResult result = static_cast<ComparisonResult>(keyCompare(comparator, k1, k2, HasThreeWayCompare<Compare, K1, K2>()));
+
+    // A two-way comparator is called again unless the first call said less
+    statistics.comparison();
+    if (!HasThreeWayCompare<Compare, K1, K2>::value && result != LESS_THAN)
+        statistics.comparison();
+    return result;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <typename K1, typename K2>
+bool Map<key_t, value_t, Compare, Allocator, Stats, Augment>::less(const K1 &k1, const K2 &k2) const
+{
+    statistics.comparison();
+    return keyLess(comparator, k1, k2, HasThreeWayCompare<Compare, K1, K2>());
+}
+
+// Node allocation
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <typename... Args>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::TreeNode *Map<key_t, value_t, Compare, Allocator, Stats, Augment>::createNode(bool color, Args &&...args)
+{
+    TreeNode *node = NodeAllocTraits::allocate(alloc, 1);
+    try
+    {
+        NodeAllocTraits::construct(alloc, node, color, std::forward<Args>(args)...);
+    }
+    catch (...)
+    {
+        NodeAllocTraits::deallocate(alloc, node, 1);
+        throw;
+    }
+
+    statistics.allocation();
+    counter.add();
+    return node;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+void Map<key_t, value_t, Compare, Allocator, Stats, Augment>::destroyNode(TreeNode *node)
+{
+    NodeAllocTraits::destroy(alloc, node);
+    NodeAllocTraits::deallocate(alloc, node, 1);
+    statistics.deallocation();
+    counter.remove();
 }
 
 /**
  * Constructors
  */
 
-template <typename key_t, typename value_t, typename Compare>
-Map<key_t, value_t, Compare>::Map()
-    : root(nullptr), comparator(Compare()) {}
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+Map<key_t, value_t, Compare, Allocator, Stats, Augment>::Map()
+    : root(nullptr), rightmost(nullptr), comparator(Compare()), alloc(Allocator()) {}
 
-template <typename key_t, typename value_t, typename Compare>
-Map<key_t, value_t, Compare>::Map(const std::initializer_list<std::pair<key_t, value_t>> &init)
-    : root(nullptr), comparator(Compare())
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+Map<key_t, value_t, Compare, Allocator, Stats, Augment>::Map(const std::initializer_list<std::pair<key_t, value_t>> &init)
+    : root(nullptr), rightmost(nullptr), comparator(Compare()), alloc(Allocator())
 {
     for (std::pair<key_t, value_t> pair : init)
         insert(pair);
 }
 
-template <typename key_t, typename value_t, typename Compare>
-typename Map<key_t, value_t, Compare>::TreeNode *Map<key_t, value_t, Compare>::copyTree(TreeNode const *node)
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+Map<key_t, value_t, Compare, Allocator, Stats, Augment>::Map(const Allocator &allocator)
+    : root(nullptr), rightmost(nullptr), comparator(Compare()), alloc(allocator) {}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::TreeNode *Map<key_t, value_t, Compare, Allocator, Stats, Augment>::copyTree(TreeNode const *node)
 {
     if (node == nullptr)
         return nullptr;
 
     // Deep copy if a copy constructor is specified
-    key_t keyCopy = node->p.first;
-    value_t valCopy = node->p.second;
-
-    TreeNode *curNode = new TreeNode(std::pair<key_t, value_t>(keyCopy, valCopy), node->color);
-    curNode->sz = node->sz;
+    TreeNode *curNode = createNode(node->color, node->p);
+    curNode->takeSummary(*node);
     curNode->left = copyTree(node->left);
     curNode->right = copyTree(node->right);
+
+    if (curNode->left != nullptr)
+        curNode->left->parent = curNode;
+    if (curNode->right != nullptr)
+        curNode->right->parent = curNode;
     return curNode;
 }
 
-template <typename key_t, typename value_t, typename Compare>
-Map<key_t, value_t, Compare>::Map(const Map &that)
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+Map<key_t, value_t, Compare, Allocator, Stats, Augment>::Map(const Map &that)
+    : root(nullptr), rightmost(nullptr), alloc(NodeAllocTraits::select_on_container_copy_construction(that.alloc))
 {
-    TreeNode *newRoot = copyTree(that.root);
-    this->root = newRoot;
+    installRoot(copyTree(that.root));
     this->comparator = that.comparator;
 }
 
+// The allocator is copied rather than moved so that the emptied source
+// can still allocate nodes.
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+Map<key_t, value_t, Compare, Allocator, Stats, Augment>::Map(Map &&that)
+    : root(that.root), rightmost(that.rightmost), comparator(that.comparator), alloc(that.alloc)
+{
+    that.root = nullptr;
+    that.rightmost = nullptr;
+    counter.take(that.counter);
+}
+
+/**
+ * Construction from sorted input
+ */
+
+// Largest subtree with the given black height: every node a 3-node
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+size_t Map<key_t, value_t, Compare, Allocator, Stats, Augment>::maxNodes(size_t blackHeight)
+{
+    size_t limit = static_cast<size_t>(-1);
+    size_t result = 0;
+    for (size_t i = 0; i < blackHeight; i++)
+    {
+        if (result > (limit - 2) / 3)
+            return limit;
+        result = 3 * result + 2;
+    }
+
+    return result;
+}
+
+/**
+ * Build a subtree of n nodes with the given black height from the next
+ * n elements of it. A black height of b admits between 2^b - 1 and
+ * 3^b - 1 nodes; the root becomes a 3-node only when two children of
+ * height b - 1 cannot hold the remaining nodes. Sizes are split evenly
+ * among the children, so every child stays within its own bounds.
+ */
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <typename ForwardIt>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::TreeNode *Map<key_t, value_t, Compare, Allocator, Stats, Augment>::buildSorted(ForwardIt &it, size_t n, size_t blackHeight)
+{
+    if (n == 0)
+        return nullptr;
+
+    size_t childMax = maxNodes(blackHeight - 1);
+    bool threeNode = n - 1 > childMax + childMax;
+
+    // Subtree sizes from left to right
+    size_t remaining = threeNode ? n - 2 : n - 1;
+    size_t children = threeNode ? 3 : 2;
+    size_t sizeA = remaining / children;
+    size_t sizeB = threeNode ? (remaining - sizeA) / 2 : remaining - sizeA;
+    size_t sizeC = remaining - sizeA - sizeB;
+
+    TreeNode *subtreeA = buildSorted(it, sizeA, blackHeight - 1);
+    TreeNode *top = nullptr;
+    try
+    {
+        top = createNode(TreeNode::BLACK, *it);
+        ++it;
+    }
+    catch (...)
+    {
+        _deleteTree(subtreeA);
+        throw;
+    }
+
+    top->left = subtreeA;
+    if (subtreeA != nullptr)
+        subtreeA->parent = top;
+
+    try
+    {
+        TreeNode *subtreeB = buildSorted(it, sizeB, blackHeight - 1);
+        top->right = subtreeB;
+        if (subtreeB != nullptr)
+            subtreeB->parent = top;
+        pull(top);
+
+        if (!threeNode)
+            return top;
+
+        // Lift top into the red left half of a 3-node
+        TreeNode *upper = createNode(TreeNode::BLACK, *it);
+        ++it;
+        top->color = TreeNode::RED;
+        top->parent = upper;
+        upper->left = top;
+        top = upper;
+
+        TreeNode *subtreeC = buildSorted(it, sizeC, blackHeight - 1);
+        top->right = subtreeC;
+        if (subtreeC != nullptr)
+            subtreeC->parent = top;
+        pull(top);
+    }
+    catch (...)
+    {
+        _deleteTree(top);
+        throw;
+    }
+
+    return top;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <typename ForwardIt>
+Map<key_t, value_t, Compare, Allocator, Stats, Augment> Map<key_t, value_t, Compare, Allocator, Stats, Augment>::fromSorted(ForwardIt first, ForwardIt last, bool checkSorted)
+{
+    Map tree;
+    size_t n = 0;
+    ForwardIt prev = first;
+    for (ForwardIt it = first; it != last; ++it)
+    {
+        if (checkSorted && n > 0 && !tree.less((*prev).first, (*it).first))
+            throw std::invalid_argument("Input to fromSorted() is not strictly increasing");
+
+        prev = it;
+        n++;
+    }
+
+    tree.installRoot(tree.buildTree(first, n));
+    return tree;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <typename ForwardIt>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::TreeNode *Map<key_t, value_t, Compare, Allocator, Stats, Augment>::buildTree(ForwardIt first, size_t n)
+{
+    if (n == 0)
+        return nullptr;
+
+    // Tallest complete tree of 2-nodes that fits
+    size_t blackHeight = 0;
+    while (blackHeight < 63 && (static_cast<size_t>(1) << (blackHeight + 1)) - 1 <= n)
+        blackHeight++;
+
+    return buildSorted(first, n, blackHeight);
+}
+
 /**
  * Utilities
  */
 
-template <typename key_t, typename value_t, typename Compare>
-bool Map<key_t, value_t, Compare>::empty() const
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+bool Map<key_t, value_t, Compare, Allocator, Stats, Augment>::empty() const
 {
     return root == nullptr;
 }
 
-template <typename key_t, typename value_t, typename Compare>
-size_t Map<key_t, value_t, Compare>::nodeSize(TreeNode *node) const
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+TreeStats Map<key_t, value_t, Compare, Allocator, Stats, Augment>::stats() const
+{
+    return statistics.snapshot();
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+void Map<key_t, value_t, Compare, Allocator, Stats, Augment>::resetStats()
+{
+    statistics.reset();
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+size_t Map<key_t, value_t, Compare, Allocator, Stats, Augment>::nodeSize(TreeNode *node) const
+{
+    return TreeNode::sizeOf(node);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+void Map<key_t, value_t, Compare, Allocator, Stats, Augment>::pull(TreeNode *node)
+{
+    node->pullSummary(node->left, node->right, node->p.second);
+}
+
+// After a value changed in place
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+void Map<key_t, value_t, Compare, Allocator, Stats, Augment>::pullToRoot(TreeNode *node)
 {
-    return node == nullptr ? 0 : node->sz;
+    if (!AugmentNode<Augment>::AGGREGATED)
+        return;
+
+    for (; node != nullptr; node = node->parent)
+        node->pullSummary(node->left, node->right, node->p.second);
 }
 
-template <typename key_t, typename value_t, typename Compare>
-size_t Map<key_t, value_t, Compare>::size() const
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+size_t Map<key_t, value_t, Compare, Allocator, Stats, Augment>::size() const
 {
-    return nodeSize(root);
+    return counter.size(root);
 }
 
-template <typename key_t, typename value_t, typename Compare>
-bool Map<key_t, value_t, Compare>::treeEqual(TreeNode *node1, TreeNode *node2) const
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+bool Map<key_t, value_t, Compare, Allocator, Stats, Augment>::treeEqual(TreeNode *node1, TreeNode *node2) const
 {
     if (node1 == nullptr && node2 == nullptr)
         return true;
@@ -102,29 +320,47 @@ bool Map<key_t, value_t, Compare>::treeEqual(TreeNode *node1, TreeNode *node2) c
     else if (node2 == nullptr)
         return false;
 
-    bool nodeEquality = node1->p == node2->p && node1->sz == node2->sz && node1->color == node2->color;
+    bool nodeEquality = node1->p == node2->p && TreeNode::sizeOf(node1) == TreeNode::sizeOf(node2) && node1->color == node2->color;
     return nodeEquality && treeEqual(node1->left, node2->left) && treeEqual(node1->right, node2->right);
 }
 
-template <typename key_t, typename value_t, typename Compare>
-Map<key_t, value_t, Compare> &Map<key_t, value_t, Compare>::operator=(const Map &that)
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+Map<key_t, value_t, Compare, Allocator, Stats, Augment> &Map<key_t, value_t, Compare, Allocator, Stats, Augment>::operator=(const Map &that)
 {
-    // Copy and swap
-    Map<key_t, value_t> temp(that);
+    // Copy into a temporary on this allocator, which is not propagated,
+    // then swap; nodes keep moving between containers sharing a pool
+    Map temp{Allocator(alloc)};
+    temp.comparator = that.comparator;
+    temp.installRoot(temp.copyTree(that.root));
     std::swap(this->root, temp.root);
+    std::swap(this->rightmost, temp.rightmost);
+    std::swap(this->counter, temp.counter);
     std::swap(this->comparator, temp.comparator);
 
     return *this;
 }
 
-template <typename key_t, typename value_t, typename Compare>
-bool Map<key_t, value_t, Compare>::operator==(const Map &that) const
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+Map<key_t, value_t, Compare, Allocator, Stats, Augment> &Map<key_t, value_t, Compare, Allocator, Stats, Augment>::operator=(Map &&that)
+{
+    // The old nodes leave with that and are freed by its destructor
+    std::swap(this->root, that.root);
+    std::swap(this->rightmost, that.rightmost);
+    std::swap(this->counter, that.counter);
+    std::swap(this->comparator, that.comparator);
+    std::swap(this->alloc, that.alloc);
+
+    return *this;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+bool Map<key_t, value_t, Compare, Allocator, Stats, Augment>::operator==(const Map &that) const
 {
     return treeEqual(this->root, that.root);
 }
 
-template <typename key_t, typename value_t, typename Compare>
-bool Map<key_t, value_t, Compare>::operator!=(const Map &that) const
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+bool Map<key_t, value_t, Compare, Allocator, Stats, Augment>::operator!=(const Map &that) const
 {
     return !treeEqual(this->root, that.root);
 }
@@ -133,22 +369,75 @@ bool Map<key_t, value_t, Compare>::operator!=(const Map &that) const
  * Search
  */
 
-template <typename key_t, typename value_t, typename Compare>
-typename Map<key_t, value_t, Compare>::TreeNode *Map<key_t, value_t, Compare>::_at(TreeNode *node, const key_t &key) const
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <typename K>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::TreeNode *Map<key_t, value_t, Compare, Allocator, Stats, Augment>::_at(TreeNode *node, const K &key) const
 {
-    if (node == nullptr)
+    return _at(node, key, HasThreeWayCompare<Compare, K, key_t>());
+}
+
+// Three-way comparator: stop at the match
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <typename K>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::TreeNode *Map<key_t, value_t, Compare, Allocator, Stats, Augment>::_at(TreeNode *node, const K &key, std::true_type) const
+{
+    size_t depth = 0;
+    while (node != nullptr)
+    {
+        depth++;
+        ComparisonResult cmp = comp(key, node->p.first);
+        if (cmp == EQUAL_TO)
+            break;
+        node = cmp == LESS_THAN ? node->left : node->right;
+    }
+
+    statistics.path(TreeOperation::LOOKUP, depth);
+    return node;
+}
+
+// Two-way comparator: branch on node < key alone and test the last
+// candidate for equality once at the bottom
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <typename K>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::TreeNode *Map<key_t, value_t, Compare, Allocator, Stats, Augment>::_at(TreeNode *node, const K &key, std::false_type) const
+{
+    TreeNode *candidate = nullptr;
+    size_t depth = 0;
+    while (node != nullptr)
+    {
+        depth++;
+        if (less(node->p.first, key))
+            node = node->right;
+        else
+        {
+            candidate = node;
+            node = node->left;
+        }
+    }
+
+    statistics.path(TreeOperation::LOOKUP, depth);
+    if (candidate == nullptr || less(key, candidate->p.first))
         return nullptr;
+    return candidate;
+}
 
-    if (comp(key, node->p.first) == LESS_THAN)
-        return _at(node->left, key);
-    else if (comp(key, node->p.first) == GREATER_THAN)
-        return _at(node->right, key);
-    else
-        return node;
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+value_t Map<key_t, value_t, Compare, Allocator, Stats, Augment>::at(const key_t &key) const
+{
+    if (empty())
+        throw std::out_of_range("Invalid search in empty container");
+
+    TreeNode *queryNode = _at(root, key);
+    if (queryNode == nullptr)
+        throw std::out_of_range("Query key not found");
+
+    value_t queryValue = queryNode->p.second;
+    return queryValue;
 }
 
-template <typename key_t, typename value_t, typename Compare>
-value_t Map<key_t, value_t, Compare>::at(const key_t &key) const
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <typename K, typename C, typename>
+value_t Map<key_t, value_t, Compare, Allocator, Stats, Augment>::at(const K &key) const
 {
     if (empty())
         throw std::out_of_range("Invalid search in empty container");
@@ -161,8 +450,8 @@ value_t Map<key_t, value_t, Compare>::at(const key_t &key) const
     return queryValue;
 }
 
-template <typename key_t, typename value_t, typename Compare>
-const value_t &Map<key_t, value_t, Compare>::operator[](const key_t &key) const
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+const value_t &Map<key_t, value_t, Compare, Allocator, Stats, Augment>::operator[](const key_t &key) const
 {
     if (empty())
         throw std::out_of_range("Invalid search in empty container");
@@ -175,88 +464,210 @@ const value_t &Map<key_t, value_t, Compare>::operator[](const key_t &key) const
     return queryRef;
 }
 
-template <typename key_t, typename value_t, typename Compare>
-bool Map<key_t, value_t, Compare>::contains(const key_t &key) const
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+bool Map<key_t, value_t, Compare, Allocator, Stats, Augment>::contains(const key_t &key) const
+{
+    TreeNode *queryNode = _at(root, key);
+    return queryNode != nullptr;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <typename K, typename C, typename>
+bool Map<key_t, value_t, Compare, Allocator, Stats, Augment>::contains(const K &key) const
 {
     TreeNode *queryNode = _at(root, key);
     return queryNode != nullptr;
 }
 
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+void Map<key_t, value_t, Compare, Allocator, Stats, Augment>::_lowerBatch(const key_t *keys, size_t count, TreeNode **candidates, int *ranks) const
+{
+    TreeNode *nodes[BATCH_WIDTH];
+    for (size_t i = 0; i < count; i++)
+    {
+        nodes[i] = root;
+        candidates[i] = nullptr;
+        if (ranks != nullptr)
+            ranks[i] = 0;
+    }
+
+    // One level of every unfinished search per round
+    bool active = root != nullptr;
+    while (active)
+    {
+        active = false;
+        for (size_t i = 0; i < count; i++)
+        {
+            TreeNode *node = nodes[i];
+            if (node == nullptr)
+                continue;
+
+            if (less(node->p.first, keys[i]))
+            {
+                if (ranks != nullptr)
+                    ranks[i] += static_cast<int>(nodeSize(node->left)) + 1;
+                node = node->right;
+            }
+            else
+            {
+                candidates[i] = node;
+                node = node->left;
+            }
+
+#if defined(__GNUC__)
+            if (node != nullptr)
+                __builtin_prefetch(node);
+#endif
+            nodes[i] = node;
+            active |= node != nullptr;
+        }
+    }
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+void Map<key_t, value_t, Compare, Allocator, Stats, Augment>::containsBatch(const key_t *keys, size_t count, bool *out) const
+{
+    TreeNode *candidates[BATCH_WIDTH];
+    for (size_t first = 0; first < count; first += BATCH_WIDTH)
+    {
+        size_t width = count - first < BATCH_WIDTH ? count - first : BATCH_WIDTH;
+        _lowerBatch(keys + first, width, candidates, nullptr);
+        for (size_t i = 0; i < width; i++)
+            out[first + i] = candidates[i] != nullptr && !less(keys[first + i], candidates[i]->p.first);
+    }
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+void Map<key_t, value_t, Compare, Allocator, Stats, Augment>::atBatch(const key_t *keys, size_t count, value_t *out) const
+{
+    if (count > 0 && empty())
+        throw std::out_of_range("Invalid search in empty container");
+
+    TreeNode *candidates[BATCH_WIDTH];
+    for (size_t first = 0; first < count; first += BATCH_WIDTH)
+    {
+        size_t width = count - first < BATCH_WIDTH ? count - first : BATCH_WIDTH;
+        _lowerBatch(keys + first, width, candidates, nullptr);
+        for (size_t i = 0; i < width; i++)
+        {
+            if (candidates[i] == nullptr || less(keys[first + i], candidates[i]->p.first))
+                throw std::out_of_range("Query key not found");
+            out[first + i] = candidates[i]->p.second;
+        }
+    }
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+void Map<key_t, value_t, Compare, Allocator, Stats, Augment>::rankBatch(const key_t *keys, size_t count, int *out) const
+{
+    static_assert(AugmentNode<Augment>::SIZED, "rankBatch() needs subtree sizes, which NoOrderStatistics drops");
+    if (count > 0 && empty())
+        throw std::out_of_range("Invalid rank query with empty container");
+
+    TreeNode *candidates[BATCH_WIDTH];
+    for (size_t first = 0; first < count; first += BATCH_WIDTH)
+    {
+        size_t width = count - first < BATCH_WIDTH ? count - first : BATCH_WIDTH;
+        _lowerBatch(keys + first, width, candidates, out + first);
+    }
+}
+
 /**
  * Ordered symbol table operations
  */
 
-template <typename key_t, typename value_t, typename Compare>
-int Map<key_t, value_t, Compare>::_rank(TreeNode *node, const key_t &key) const
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <typename K>
+int Map<key_t, value_t, Compare, Allocator, Stats, Augment>::_rank(TreeNode *node, const K &key) const
 {
-    if (node == nullptr)
-        return 0;
+    int rank = 0;
+    while (node != nullptr)
+    {
+        if (less(node->p.first, key))
+        {
+            rank += nodeSize(node->left) + 1;
+            node = node->right;
+        }
+        else
+            node = node->left;
+    }
 
-    ComparisonResult cmp = comp(key, node->p.first);
-    if (cmp == LESS_THAN)
-        return _rank(node->left, key);
-    else if (cmp == GREATER_THAN)
-        return nodeSize(node->left) + 1 + _rank(node->right, key);
-    else
-        return nodeSize(node->left);
+    return rank;
 }
 
-template <typename key_t, typename value_t, typename Compare>
-int Map<key_t, value_t, Compare>::rank(const key_t &key) const
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+int Map<key_t, value_t, Compare, Allocator, Stats, Augment>::rank(const key_t &key) const
 {
+    static_assert(AugmentNode<Augment>::SIZED, "rank() needs subtree sizes, which NoOrderStatistics drops");
     if (empty())
         throw std::out_of_range("Invalid rank query with empty container");
     return _rank(root, key);
 }
 
-template <typename key_t, typename value_t, typename Compare>
-key_t Map<key_t, value_t, Compare>::min() const
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <typename K, typename C, typename>
+int Map<key_t, value_t, Compare, Allocator, Stats, Augment>::rank(const K &key) const
 {
+    static_assert(AugmentNode<Augment>::SIZED, "rank() needs subtree sizes, which NoOrderStatistics drops");
     if (empty())
-        throw std::out_of_range("Invalid call to min() with empty container");
+        throw std::out_of_range("Invalid rank query with empty container");
+    return _rank(root, key);
+}
 
-    TreeNode *cur = root;
-    while (cur->left != nullptr)
-        cur = cur->left;
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+key_t Map<key_t, value_t, Compare, Allocator, Stats, Augment>::min() const
+{
+    if (empty())
+        throw std::out_of_range("Invalid call to min() with empty container");
 
-    return cur->p.first;
+    return minNode()->p.first;
 }
 
-template <typename key_t, typename value_t, typename Compare>
-key_t Map<key_t, value_t, Compare>::max() const
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+key_t Map<key_t, value_t, Compare, Allocator, Stats, Augment>::max() const
 {
     if (empty())
         throw std::out_of_range("Invalid call to max() with empty container");
 
-    TreeNode *cur = root;
-    while (cur->right != nullptr)
-        cur = cur->right;
-
-    return cur->p.first;
+    return maxNode()->p.first;
 }
 
-template <typename key_t, typename value_t, typename Compare>
-typename Map<key_t, value_t, Compare>::TreeNode *Map<key_t, value_t, Compare>::_floor(TreeNode *node, const key_t &key) const
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <typename K>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::TreeNode *Map<key_t, value_t, Compare, Allocator, Stats, Augment>::_floor(TreeNode *node, const K &key) const
 {
-    if (node == nullptr)
-        return nullptr;
+    // Largest node not greater than key
+    TreeNode *candidate = nullptr;
+    while (node != nullptr)
+    {
+        if (less(key, node->p.first))
+            node = node->left;
+        else
+        {
+            candidate = node;
+            node = node->right;
+        }
+    }
 
-    ComparisonResult cmp = comp(key, node->p.first);
-    if (cmp == EQUAL_TO)
-        return node;
-    else if (cmp == LESS_THAN)
-        return _floor(node->left, key);
+    return candidate;
+}
 
-    // Query key is greater than node->key
-    TreeNode *rightFloor = _floor(node->right, key);
-    if (rightFloor == nullptr)
-        return node;
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+key_t Map<key_t, value_t, Compare, Allocator, Stats, Augment>::floor(const key_t &key)
+{
+    if (empty())
+        throw std::out_of_range("Invalid call to floor() with empty container");
+
+    TreeNode *queryNode = _floor(root, key);
+    if (queryNode == nullptr)
+        throw std::out_of_range("Argument to floor() is too small");
     else
-        return rightFloor;
+        return queryNode->p.first;
 }
 
-template <typename key_t, typename value_t, typename Compare>
-key_t Map<key_t, value_t, Compare>::floor(const key_t &key)
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <typename K, typename C, typename>
+key_t Map<key_t, value_t, Compare, Allocator, Stats, Augment>::floor(const K &key)
 {
     if (empty())
         throw std::out_of_range("Invalid call to floor() with empty container");
@@ -268,28 +679,62 @@ key_t Map<key_t, value_t, Compare>::floor(const key_t &key)
         return queryNode->p.first;
 }
 
-template <typename key_t, typename value_t, typename Compare>
-typename Map<key_t, value_t, Compare>::TreeNode *Map<key_t, value_t, Compare>::_ceiling(TreeNode *node, const key_t &key) const
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <typename K>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::TreeNode *Map<key_t, value_t, Compare, Allocator, Stats, Augment>::_ceiling(TreeNode *node, const K &key) const
 {
-    if (node == nullptr)
-        return node;
+    // Smallest node not less than key
+    TreeNode *candidate = nullptr;
+    while (node != nullptr)
+    {
+        if (less(node->p.first, key))
+            node = node->right;
+        else
+        {
+            candidate = node;
+            node = node->left;
+        }
+    }
 
-    ComparisonResult cmp = comp(key, node->p.first);
-    if (cmp == EQUAL_TO)
-        return node;
-    else if (cmp == GREATER_THAN)
-        return _ceiling(node->right, key);
+    return candidate;
+}
 
-    // Query key is less than node->key
-    TreeNode *leftCeiling = _ceiling(node->left, key);
-    if (leftCeiling == nullptr)
-        return node;
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <typename K>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::TreeNode *Map<key_t, value_t, Compare, Allocator, Stats, Augment>::_upper(TreeNode *node, const K &key) const
+{
+    // Smallest node greater than key
+    TreeNode *candidate = nullptr;
+    while (node != nullptr)
+    {
+        if (less(key, node->p.first))
+        {
+            candidate = node;
+            node = node->left;
+        }
+        else
+            node = node->right;
+    }
+
+    return candidate;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+key_t Map<key_t, value_t, Compare, Allocator, Stats, Augment>::ceiling(const key_t &key)
+{
+    if (empty())
+        throw std::out_of_range("Invalid call to ceiling() with empty container");
+
+    TreeNode *queryNode = _ceiling(root, key);
+    if (queryNode == nullptr)
+        throw std::out_of_range("Argument to ceiling() is too large");
     else
-        return leftCeiling;
+        return queryNode->p.first;
 }
 
-template <typename key_t, typename value_t, typename Compare>
-key_t Map<key_t, value_t, Compare>::ceiling(const key_t &key)
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <typename K, typename C, typename>
+key_t Map<key_t, value_t, Compare, Allocator, Stats, Augment>::ceiling(const K &key)
 {
     if (empty())
         throw std::out_of_range("Invalid call to ceiling() with empty container");
@@ -301,8 +746,8 @@ key_t Map<key_t, value_t, Compare>::ceiling(const key_t &key)
         return queryNode->p.first;
 }
 
-template <typename key_t, typename value_t, typename Compare>
-const key_t &Map<key_t, value_t, Compare>::_rankSelect(TreeNode *node, int rank) const
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+const key_t &Map<key_t, value_t, Compare, Allocator, Stats, Augment>::_rankSelect(TreeNode *node, int rank) const
 {
     if (node == nullptr)
         throw std::logic_error("Rank select did not find key matching query rank");
@@ -316,9 +761,10 @@ const key_t &Map<key_t, value_t, Compare>::_rankSelect(TreeNode *node, int rank)
         return node->p.first;
 }
 
-template <typename key_t, typename value_t, typename Compare>
-key_t Map<key_t, value_t, Compare>::rankSelect(int rank)
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+key_t Map<key_t, value_t, Compare, Allocator, Stats, Augment>::rankSelect(int rank)
 {
+    static_assert(AugmentNode<Augment>::SIZED, "rankSelect() needs subtree sizes, which NoOrderStatistics drops");
     if (empty())
         throw std::out_of_range("Invalid call to rankSelect() with empty container");
     if (rank < 0 || rank >= size())
@@ -328,65 +774,160 @@ key_t Map<key_t, value_t, Compare>::rankSelect(int rank)
     return queryKey;
 }
 
-/**
- * Red-black scheme helpers
- */
-
-// Tree rotation & coloring
-template <typename key_t, typename value_t, typename Compare>
-bool Map<key_t, value_t, Compare>::isRed(TreeNode *node)
+// Pieces are found from right to left
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+typename AugmentNode<Augment>::aggregate_type Map<key_t, value_t, Compare, Allocator, Stats, Augment>::_suffixAggregate(TreeNode *node, const key_t &lo) const
 {
-    if (node == nullptr)
-        return TreeNode::BLACK;
-    else
-        return node->color;
+    using Monoid = typename AugmentNode<Augment>::monoid_type;
+
+    aggregate_type sum = Monoid::identity();
+    while (node != nullptr)
+    {
+        if (less(node->p.first, lo))
+        {
+            node = node->right;
+            continue;
+        }
+
+        aggregate_type piece = Monoid::lift(node->p.second);
+        if (node->right != nullptr)
+            piece = Monoid::combine(piece, node->right->aggregate);
+        sum = Monoid::combine(piece, sum);
+        node = node->left;
+    }
+
+    return sum;
 }
 
-template <typename key_t, typename value_t, typename Compare>
-typename Map<key_t, value_t, Compare>::TreeNode *Map<key_t, value_t, Compare>::rotateLeft(TreeNode *node)
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+typename AugmentNode<Augment>::aggregate_type Map<key_t, value_t, Compare, Allocator, Stats, Augment>::_prefixAggregate(TreeNode *node, const key_t &hi) const
 {
-    TreeNode *newNode = node->right;
-    node->right = newNode->left;
-    newNode->left = node;
+    using Monoid = typename AugmentNode<Augment>::monoid_type;
 
-    // Enforce color
-    newNode->color = newNode->left->color;
-    newNode->left->color = TreeNode::RED;
+    aggregate_type sum = Monoid::identity();
+    while (node != nullptr)
+    {
+        if (!less(node->p.first, hi))
+        {
+            node = node->left;
+            continue;
+        }
 
-    // Size update
-    newNode->sz = node->sz;
-    node->sz = 1 + nodeSize(node->left) + nodeSize(node->right);
-    return newNode;
+        if (node->left != nullptr)
+            sum = Monoid::combine(sum, node->left->aggregate);
+        sum = Monoid::combine(sum, Monoid::lift(node->p.second));
+        node = node->right;
+    }
+
+    return sum;
 }
 
-template <typename key_t, typename value_t, typename Compare>
-typename Map<key_t, value_t, Compare>::TreeNode *Map<key_t, value_t, Compare>::rotateRight(TreeNode *node)
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::aggregate_type Map<key_t, value_t, Compare, Allocator, Stats, Augment>::rangeAggregate(const key_t &lo, const key_t &hi) const
 {
-    TreeNode *newNode = node->left;
-    node->left = newNode->right;
-    newNode->right = node;
+    static_assert(AugmentNode<Augment>::AGGREGATED, "rangeAggregate() needs an Aggregate<Monoid> augmentation");
+    using Monoid = typename AugmentNode<Augment>::monoid_type;
+
+    // Highest node inside the range; an inverted range has none
+    TreeNode *node = root;
+    while (node != nullptr)
+    {
+        if (less(node->p.first, lo))
+            node = node->right;
+        else if (!less(node->p.first, hi))
+            node = node->left;
+        else
+            break;
+    }
+
+    if (node == nullptr)
+        return Monoid::identity();
+
+    aggregate_type sum = Monoid::combine(_suffixAggregate(node->left, lo), Monoid::lift(node->p.second));
+    return Monoid::combine(sum, _prefixAggregate(node->right, hi));
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::aggregate_type Map<key_t, value_t, Compare, Allocator, Stats, Augment>::prefixAggregate(const key_t &key) const
+{
+    static_assert(AugmentNode<Augment>::AGGREGATED, "prefixAggregate() needs an Aggregate<Monoid> augmentation");
+    return _prefixAggregate(root, key);
+}
+
+/**
+ * Red-black scheme helpers
+ */
+
+// Tree rotation & coloring
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+bool Map<key_t, value_t, Compare, Allocator, Stats, Augment>::isRed(TreeNode *node)
+{
+    if (node == nullptr)
+        return TreeNode::BLACK;
+    else
+        return node->color;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::TreeNode *Map<key_t, value_t, Compare, Allocator, Stats, Augment>::rotateLeft(TreeNode *node)
+{
+    statistics.rotation();
+    TreeNode *newNode = node->right;
+    node->right = newNode->left;
+    newNode->left = node;
+
+    // Relink parents
+    if (node->right != nullptr)
+        node->right->parent = node;
+    newNode->parent = node->parent;
+    node->parent = newNode;
+
+    // Enforce color
+    newNode->color = newNode->left->color;
+    newNode->left->color = TreeNode::RED;
+
+    // Size update
+    newNode->takeSummary(*node);
+    pull(node);
+    return newNode;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::TreeNode *Map<key_t, value_t, Compare, Allocator, Stats, Augment>::rotateRight(TreeNode *node)
+{
+    statistics.rotation();
+    TreeNode *newNode = node->left;
+    node->left = newNode->right;
+    newNode->right = node;
+
+    // Relink parents
+    if (node->left != nullptr)
+        node->left->parent = node;
+    newNode->parent = node->parent;
+    node->parent = newNode;
 
     // Enforce color
     newNode->color = newNode->right->color;
     newNode->right->color = TreeNode::RED;
 
     // Size update
-    newNode->sz = node->sz;
-    node->sz = 1 + nodeSize(node->left) + nodeSize(node->right);
+    newNode->takeSummary(*node);
+    pull(node);
     return newNode;
 }
 
-template <typename key_t, typename value_t, typename Compare>
-void Map<key_t, value_t, Compare>::flipColors(TreeNode *node)
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+void Map<key_t, value_t, Compare, Allocator, Stats, Augment>::flipColors(TreeNode *node)
 {
+    statistics.colorFlip();
     node->color = !node->color;
     node->left->color = !node->left->color;
     node->right->color = !node->right->color;
 }
 
 // Fixup during insertion
-template <typename key_t, typename value_t, typename Compare>
-typename Map<key_t, value_t, Compare>::TreeNode *Map<key_t, value_t, Compare>::rbFix(TreeNode *node)
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::TreeNode *Map<key_t, value_t, Compare, Allocator, Stats, Augment>::rbFix(TreeNode *node)
 {
     if (isRed(node->right) && !isRed(node->left))
         node = rotateLeft(node);
@@ -395,13 +936,13 @@ typename Map<key_t, value_t, Compare>::TreeNode *Map<key_t, value_t, Compare>::r
     if (isRed(node->left) && isRed(node->right))
         flipColors(node);
 
-    node->sz = 1 + nodeSize(node->left) + nodeSize(node->right);
+    pull(node);
     return node;
 }
 
 // Deletion 2-node fixups
-template <typename key_t, typename value_t, typename Compare>
-typename Map<key_t, value_t, Compare>::TreeNode *Map<key_t, value_t, Compare>::moveRedLeft(TreeNode *node)
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::TreeNode *Map<key_t, value_t, Compare, Allocator, Stats, Augment>::moveRedLeft(TreeNode *node)
 {
     flipColors(node);
     if (isRed(node->right->left))
@@ -414,8 +955,8 @@ typename Map<key_t, value_t, Compare>::TreeNode *Map<key_t, value_t, Compare>::m
     return node;
 }
 
-template <typename key_t, typename value_t, typename Compare>
-typename Map<key_t, value_t, Compare>::TreeNode *Map<key_t, value_t, Compare>::moveRedRight(TreeNode *node)
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::TreeNode *Map<key_t, value_t, Compare, Allocator, Stats, Augment>::moveRedRight(TreeNode *node)
 {
     flipColors(node);
     if (isRed(node->left->left))
@@ -428,348 +969,2014 @@ typename Map<key_t, value_t, Compare>::TreeNode *Map<key_t, value_t, Compare>::m
 }
 
 /**
- * Insertion
+ * Iterative mutation engine
  */
 
-template <typename key_t, typename value_t, typename Compare>
-typename Map<key_t, value_t, Compare>::TreeNode *Map<key_t, value_t, Compare>::_insert(TreeNode *node, const std::pair<key_t, value_t> &pair)
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+void Map<key_t, value_t, Compare, Allocator, Stats, Augment>::replaceChild(TreeNode *parent, TreeNode *oldChild, TreeNode *newChild)
 {
-    // Recursive insertion
-    if (node == nullptr)
-    {
-        TreeNode *newNode = new TreeNode(pair, TreeNode::RED);
-        if (!newNode)
-            throw std::bad_alloc();
-        return newNode;
-    }
-
-    ComparisonResult cmp = comp(pair.first, node->p.first);
-    if (cmp == LESS_THAN)
-        node->left = _insert(node->left, pair);
-    else if (cmp == GREATER_THAN)
-        node->right = _insert(node->right, pair);
+    if (parent == nullptr)
+        root = newChild;
+    else if (parent->left == oldChild)
+        parent->left = newChild;
     else
-        node->p.second = pair.second;
-
-    // Maintain red-black scheme
-    node = rbFix(node);
-
-    node->sz = 1 + nodeSize(node->left) + nodeSize(node->right);
-    return node;
+        parent->right = newChild;
 }
 
-template <typename key_t, typename value_t, typename Compare>
-void Map<key_t, value_t, Compare>::insert(const std::pair<key_t, value_t> &pair)
+// Hook the subtree root returned by a transformation back into its parent
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::TreeNode *Map<key_t, value_t, Compare, Allocator, Stats, Augment>::relink(TreeNode *oldTop, TreeNode *newTop)
 {
-    root = _insert(root, pair);
-    root->color = TreeNode::BLACK;
+    if (newTop != oldTop)
+        replaceChild(newTop->parent, oldTop, newTop);
+    return newTop;
 }
 
-template <typename key_t, typename value_t, typename Compare>
-value_t &Map<key_t, value_t, Compare>::operator[](const key_t &key)
+/**
+ * Walk from node up to the root, applying rbFix at every level. Once
+ * the walk is above lastTouched (the highest node restructured on the
+ * way down) and rbFix leaves a node unchanged, the tree above is valid
+ * again and only the subtree sizes of the remaining ancestors change.
+ */
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+void Map<key_t, value_t, Compare, Allocator, Stats, Augment>::fixUpward(TreeNode *node, TreeNode *lastTouched, bool grew)
 {
-    TreeNode *queryNode = _at(root, key);
-    if (queryNode == nullptr)
+    bool aboveTouched = lastTouched == nullptr;
+    while (node != nullptr)
     {
-        root = _insert(root, {key, value_t{}});
-        queryNode = _at(root, key);
-    }
+        bool oldColor = node->color;
+        TreeNode *fixed = relink(node, rbFix(node));
+        bool unchanged = fixed == node && fixed->color == oldColor;
 
-    value_t &queryRef = queryNode->p.second;
-    return queryRef;
-}
+        // A red node with a red left child must still be seen by its parent
+        if (aboveTouched && unchanged && !(isRed(fixed) && isRed(fixed->left)))
+        {
+            node = fixed->parent;
+            break;
+        }
 
-/**
- * Deletion
- */
+        if (node == lastTouched)
+            aboveTouched = true;
+        node = fixed->parent;
+    }
 
-template <typename key_t, typename value_t, typename Compare>
-typename Map<key_t, value_t, Compare>::TreeNode *Map<key_t, value_t, Compare>::_eraseMin(TreeNode *node)
-{
-    if (node->left == nullptr)
+    // Without sizes, nothing above has changed
+    if (AugmentNode<Augment>::SIZED)
     {
-        delete node;
-        return nullptr;
+        for (; node != nullptr; node = node->parent)
+            node->adjustSummary(grew, node->left, node->right, node->p.second);
     }
 
-    // Fix 2-node if necessary
-    if (!isRed(node->left) && !isRed(node->left->left))
-        node = moveRedLeft(node);
+    root->color = TreeNode::BLACK;
+}
 
-    node->left = _eraseMin(node->left);
+/**
+ * Insertion
+ */
 
-    // Backtrack clean up transformation
-    return rbFix(node);
+// Returns the node holding key, or nullptr with the attachment point
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::TreeNode *Map<key_t, value_t, Compare, Allocator, Stats, Augment>::findSlot(const key_t &key, TreeNode *&parent, ComparisonResult &cmp) const
+{
+    return findSlot(key, parent, cmp, HasThreeWayCompare<Compare, key_t, key_t>());
 }
 
-template <typename key_t, typename value_t, typename Compare>
-typename Map<key_t, value_t, Compare>::TreeNode *Map<key_t, value_t, Compare>::_erase(TreeNode *node, const key_t &key)
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::TreeNode *Map<key_t, value_t, Compare, Allocator, Stats, Augment>::findSlot(const key_t &key, TreeNode *&parent, ComparisonResult &cmp, std::true_type) const
 {
-    if (comp(key, node->p.first) == LESS_THAN)
+    parent = nullptr;
+    cmp = EQUAL_TO;
+    TreeNode *cur = root;
+    size_t depth = 0;
+    while (cur != nullptr)
     {
-        // Push red link right if 2-node
-        if (!isRed(node->left) && !isRed(node->left->left))
-            node = moveRedLeft(node);
+        depth++;
+        cmp = comp(key, cur->p.first);
+        if (cmp == EQUAL_TO)
+            break;
 
-        node->left = _erase(node->left, key);
+        parent = cur;
+        cur = cmp == LESS_THAN ? cur->left : cur->right;
     }
-    else
-    {
-        if (isRed(node->left))
-            node = rotateRight(node);
-
-        // Simple case: leaf node deletion
-        if (comp(key, node->p.first) == EQUAL_TO && node->right == nullptr)
-        {
-            delete node;
-            return nullptr;
-        }
 
-        // Push red right if two black nodes
-        if (!isRed(node->right) && !isRed(node->right->left))
-            node = moveRedRight(node);
+    statistics.path(TreeOperation::INSERT, depth);
+    return cur;
+}
 
-        // Complex case: branch node deletion
-        if (comp(key, node->p.first) == EQUAL_TO)
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::TreeNode *Map<key_t, value_t, Compare, Allocator, Stats, Augment>::findSlot(const key_t &key, TreeNode *&parent, ComparisonResult &cmp, std::false_type) const
+{
+    parent = nullptr;
+    cmp = EQUAL_TO;
+    TreeNode *candidate = nullptr;
+    TreeNode *cur = root;
+    size_t depth = 0;
+    while (cur != nullptr)
+    {
+        depth++;
+        parent = cur;
+        if (less(key, cur->p.first))
         {
-            auto subtreeMin = [](TreeNode *start)
-            {
-                TreeNode *cur = start;
-                while (cur->left != nullptr)
-                    cur = cur->left;
-                return cur->p;
-            };
-            node->p = subtreeMin(node->right);
-            node->right = _eraseMin(node->right);
+            cmp = LESS_THAN;
+            cur = cur->left;
         }
         else
-            node->right = _erase(node->right, key);
+        {
+            cmp = GREATER_THAN;
+            candidate = cur;
+            cur = cur->right;
+        }
     }
 
-    // Backtrack clean up transformation
-    return rbFix(node);
+    statistics.path(TreeOperation::INSERT, depth);
+
+    // key is not less than candidate, so they match unless candidate < key
+    if (candidate != nullptr && !less(candidate->p.first, key))
+        return candidate;
+    return nullptr;
 }
 
-template <typename key_t, typename value_t, typename Compare>
-void Map<key_t, value_t, Compare>::erase(const key_t &key)
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+void Map<key_t, value_t, Compare, Allocator, Stats, Augment>::attachNode(TreeNode *node, TreeNode *parent, ComparisonResult cmp)
 {
-    if (root == nullptr)
-        throw std::out_of_range("Invalid erase from empty container");
-    if (!contains(key))
-        throw std::out_of_range("Erase query key not found");
-
-    if (!isRed(root->left) && !isRed(root->right))
-        root->color = TreeNode::RED;
+    node->parent = parent;
+    if (parent == nullptr)
+        root = node;
+    else if (cmp == LESS_THAN)
+        parent->left = node;
+    else
+        parent->right = node;
+    if (parent == rightmost && cmp != LESS_THAN)
+        rightmost = node;
 
-    root = _erase(root, key);
+    // Maintain red-black scheme bottom-up
+    fixUpward(parent, nullptr, true);
+}
 
-    if (!empty())
-        root->color = TreeNode::BLACK;
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+void Map<key_t, value_t, Compare, Allocator, Stats, Augment>::insert(const std::pair<key_t, value_t> &pair)
+{
+    TreeNode *parent;
+    ComparisonResult cmp;
+    TreeNode *node = findSlot(pair.first, parent, cmp);
+    if (node != nullptr)
+    {
+        node->p.second = pair.second;
+        pullToRoot(node);
+    }
+    else
+        attachNode(createNode(TreeNode::RED, pair), parent, cmp);
 }
 
-/**
- * Inorder iterator
- */
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+void Map<key_t, value_t, Compare, Allocator, Stats, Augment>::insert(std::pair<key_t, value_t> &&pair)
+{
+    TreeNode *parent;
+    ComparisonResult cmp;
+    TreeNode *node = findSlot(pair.first, parent, cmp);
+    if (node != nullptr)
+    {
+        node->p.second = std::move(pair.second);
+        pullToRoot(node);
+    }
+    else
+        attachNode(createNode(TreeNode::RED, std::move(pair)), parent, cmp);
+}
 
-template <typename key_t, typename value_t, typename Compare>
-Map<key_t, value_t, Compare>::Iterator::Iterator(const Map<key_t, value_t, Compare> &tree)
+// hint is the node the key should precede, or nullptr for the end. A
+// key between hint and its predecessor goes into whichever of the two
+// has a free link on that side; only fixUpward climbs from there.
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <typename P>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::TreeNode *Map<key_t, value_t, Compare, Allocator, Stats, Augment>::_insertHint(TreeNode *hint, P &&pair)
 {
-    TreeNode *temp = tree.root;
-    while (temp)
+    TreeNode *before = hint == nullptr ? maxNode() : predecessor(hint);
+    if ((hint == nullptr || less(pair.first, hint->p.first)) && (before == nullptr || less(before->p.first, pair.first)))
+    {
+        statistics.path(TreeOperation::INSERT, 1);
+        TreeNode *node = createNode(TreeNode::RED, std::forward<P>(pair));
+        if (hint != nullptr && hint->left == nullptr)
+            attachNode(node, hint, LESS_THAN);
+        else
+            attachNode(node, before, GREATER_THAN);
+        return node;
+    }
+
+    // Wrong hint
+    TreeNode *parent;
+    ComparisonResult cmp;
+    TreeNode *node = findSlot(pair.first, parent, cmp);
+    if (node != nullptr)
+    {
+        node->p.second = std::forward<P>(pair).second;
+        pullToRoot(node);
+    }
+    else
     {
-        nodeStack.push_front(temp);
-        temp = temp->left;
+        node = createNode(TreeNode::RED, std::forward<P>(pair));
+        attachNode(node, parent, cmp);
     }
+
+    return node;
 }
 
-template <typename key_t, typename value_t, typename Compare>
-std::pair<key_t, value_t> &Map<key_t, value_t, Compare>::Iterator::operator*()
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::iterator Map<key_t, value_t, Compare, Allocator, Stats, Augment>::insert(const_iterator hint, const std::pair<key_t, value_t> &pair)
 {
-    if (nodeStack.empty())
-        throw std::out_of_range("Invalid attempt to dereference null iterator");
-    return nodeStack.front()->p;
+    return iterator(_insertHint(hint.node, pair), this);
 }
 
-template <typename key_t, typename value_t, typename Compare>
-std::pair<key_t, value_t> *Map<key_t, value_t, Compare>::Iterator::operator->()
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::iterator Map<key_t, value_t, Compare, Allocator, Stats, Augment>::insert(const_iterator hint, std::pair<key_t, value_t> &&pair)
 {
-    if (nodeStack.empty())
-        throw std::out_of_range("Invalid attempt access pointer with null iterator");
-    return &(nodeStack.front()->p);
+    return iterator(_insertHint(hint.node, std::move(pair)), this);
 }
 
-template <typename key_t, typename value_t, typename Compare>
-bool Map<key_t, value_t, Compare>::Iterator::operator==(Iterator that) const
+// The maximum has no right child, so the new node hangs there
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <typename P>
+void Map<key_t, value_t, Compare, Allocator, Stats, Augment>::_append(P &&pair)
 {
-    if (this->nodeStack.empty() && that.nodeStack.empty())
-        return true;
-    else if (this->nodeStack.empty() || that.nodeStack.empty())
-        return false;
-    return this->nodeStack.front() == that.nodeStack.front();
+    TreeNode *last = maxNode();
+    if (last != nullptr && !less(last->p.first, pair.first))
+        throw std::invalid_argument("Keys passed to append() must be greater than every key in the container");
+
+    statistics.path(TreeOperation::INSERT, 1);
+    attachNode(createNode(TreeNode::RED, std::forward<P>(pair)), last, GREATER_THAN);
 }
 
-template <typename key_t, typename value_t, typename Compare>
-bool Map<key_t, value_t, Compare>::Iterator::operator!=(Iterator that) const
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+void Map<key_t, value_t, Compare, Allocator, Stats, Augment>::append(const std::pair<key_t, value_t> &pair)
 {
-    return !(*this == that);
+    _append(pair);
 }
 
-template <typename key_t, typename value_t, typename Compare>
-void Map<key_t, value_t, Compare>::Iterator::operator++()
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+void Map<key_t, value_t, Compare, Allocator, Stats, Augment>::append(std::pair<key_t, value_t> &&pair)
 {
-    if (nodeStack.empty())
-        throw std::out_of_range("Iterator cannot be incremented past the end");
+    _append(std::move(pair));
+}
 
-    TreeNode *cur = nodeStack.pop_front();
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <typename... Args>
+std::pair<typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::iterator, bool> Map<key_t, value_t, Compare, Allocator, Stats, Augment>::emplace(Args &&...args)
+{
+    // The key is only known once the pair has been built
+    TreeNode *newNode = createNode(TreeNode::RED, std::forward<Args>(args)...);
 
-    if (cur->right)
+    TreeNode *parent;
+    ComparisonResult cmp;
+    TreeNode *node = findSlot(newNode->p.first, parent, cmp);
+    if (node != nullptr)
     {
-        cur = cur->right;
-        while (cur)
-        {
-            nodeStack.push_front(cur);
-            cur = cur->left;
-        }
+        destroyNode(newNode);
+        return {iterator(node, this), false};
     }
+
+    attachNode(newNode, parent, cmp);
+    return {iterator(newNode, this), true};
 }
 
-template <typename key_t, typename value_t, typename Compare>
-typename Map<key_t, value_t, Compare>::Iterator Map<key_t, value_t, Compare>::begin()
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <typename... Args>
+std::pair<typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::iterator, bool> Map<key_t, value_t, Compare, Allocator, Stats, Augment>::try_emplace(const key_t &key, Args &&...args)
 {
-    Iterator iter(*this);
-    return iter;
+    TreeNode *parent;
+    ComparisonResult cmp;
+    TreeNode *node = findSlot(key, parent, cmp);
+    if (node != nullptr)
+        return {iterator(node, this), false};
+
+    node = createNode(TreeNode::RED, std::piecewise_construct, std::forward_as_tuple(key),
+                      std::forward_as_tuple(std::forward<Args>(args)...));
+    attachNode(node, parent, cmp);
+    return {iterator(node, this), true};
 }
 
-template <typename key_t, typename value_t, typename Compare>
-typename Map<key_t, value_t, Compare>::Iterator Map<key_t, value_t, Compare>::end()
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <typename... Args>
+std::pair<typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::iterator, bool> Map<key_t, value_t, Compare, Allocator, Stats, Augment>::try_emplace(key_t &&key, Args &&...args)
 {
-    Iterator iter(*this);
-    iter.nodeStack.clear();
-    return iter;
+    TreeNode *parent;
+    ComparisonResult cmp;
+    TreeNode *node = findSlot(key, parent, cmp);
+    if (node != nullptr)
+        return {iterator(node, this), false};
+
+    node = createNode(TreeNode::RED, std::piecewise_construct, std::forward_as_tuple(std::move(key)),
+                      std::forward_as_tuple(std::forward<Args>(args)...));
+    attachNode(node, parent, cmp);
+    return {iterator(node, this), true};
 }
 
-template <typename key_t, typename value_t, typename Compare>
-typename Map<key_t, value_t, Compare>::Iterator Map<key_t, value_t, Compare>::find(const key_t &key)
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <typename K>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::TreeNode *Map<key_t, value_t, Compare, Allocator, Stats, Augment>::_subscript(K &&key)
 {
-    TreeNode *cur = root;
-
-    while (cur)
+    TreeNode *parent;
+    ComparisonResult cmp;
+    TreeNode *node = findSlot(key, parent, cmp);
+    if (node == nullptr)
     {
-        ComparisonResult cmp = comp(key, cur->p.first);
-        if (cmp == EQUAL_TO)
-        {
-            // Build iterator an clear stack
-            Iterator iter(*this);
-            iter.nodeStack.clear();
-            iter.nodeStack.push_front(cur);
-            return iter;
-        }
-        else if (cmp == LESS_THAN)
-            cur = cur->left;
-        else
-            cur = cur->right;
+        node = createNode(TreeNode::RED, std::piecewise_construct, std::forward_as_tuple(std::forward<K>(key)),
+                          std::forward_as_tuple());
+        attachNode(node, parent, cmp);
     }
 
-    return end();
+    return node;
 }
 
-/**
- * Tree processing
- */
-template <typename key_t, typename value_t, typename Compare>
-std::string Map<key_t, value_t, Compare>::serialize(const std::function<std::string(const key_t &)> &objToString, const std::string &delim, const std::string &nilStr) const
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+value_t &Map<key_t, value_t, Compare, Allocator, Stats, Augment>::operator[](const key_t &key)
 {
-    if (empty())
-        throw std::out_of_range("Invalid serialization of empty container");
-
-    // Reserve space: there will be 3 / 8 * size nil nodes on average.
-    // Reserve 1 additional byte for the null character.
-    std::string serializedTree;
-    size_t sizeDiv8 = size() >> 3;
-    size_t reserveSize = size() + (sizeDiv8 + sizeDiv8 + sizeDiv8) + 1;
+    static_assert(!AugmentNode<Augment>::AGGREGATED, "Writes through operator[] bypass the aggregates; use insert() or update()");
+    value_t &queryRef = _subscript(key)->p.second;
+    return queryRef;
+}
 
-    // Set upper bound to avoid buffer overflow
-    size_t requestSize = reserveSize < 512 ? reserveSize : 512;
-    serializedTree.reserve(requestSize);
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+value_t &Map<key_t, value_t, Compare, Allocator, Stats, Augment>::operator[](key_t &&key)
+{
+    static_assert(!AugmentNode<Augment>::AGGREGATED, "Writes through operator[] bypass the aggregates; use insert() or update()");
+    value_t &queryRef = _subscript(std::move(key))->p.second;
+    return queryRef;
+}
 
-    // Preorder DFS to serialize tree
-    Deque<const TreeNode *> nodeStack;
-    TreeNode const *cur;
-    TreeNode const *curLeft;
-    TreeNode const *curRight;
-    nodeStack.push_back(root);
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <typename V>
+void Map<key_t, value_t, Compare, Allocator, Stats, Augment>::_update(const key_t &key, V &&value)
+{
+    if (empty())
+        throw std::out_of_range("Invalid update in empty container");
 
-    while (nodeStack.size() > 0)
-    {
-        cur = nodeStack.pop_back();
-        curLeft = cur->left;
-        curRight = cur->right;
+    TreeNode *queryNode = _at(root, key);
+    if (queryNode == nullptr)
+        throw std::out_of_range("Query key not found");
 
-        serializedTree += objToString(cur->p.first) + delim;
-        if (curRight != nullptr)
-            nodeStack.push_back(curRight);
-        if (curLeft != nullptr)
-            nodeStack.push_back(curLeft);
+    queryNode->p.second = std::forward<V>(value);
+    pullToRoot(queryNode);
+}
 
-        if (curLeft == nullptr && curRight == nullptr)
-            serializedTree += nilStr;
-    }
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+void Map<key_t, value_t, Compare, Allocator, Stats, Augment>::update(const key_t &key, const value_t &value)
+{
+    _update(key, value);
+}
 
-    return serializedTree;
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+void Map<key_t, value_t, Compare, Allocator, Stats, Augment>::update(const key_t &key, value_t &&value)
+{
+    _update(key, std::move(value));
 }
 
-template <typename key_t, typename value_t, typename Compare>
-size_t Map<key_t, value_t, Compare>::depth() const
+/**
+ * Deletion
+ */
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+void Map<key_t, value_t, Compare, Allocator, Stats, Augment>::_unlink(TreeNode *target)
 {
-    if (empty())
-        return 0;
+    // The maximum has no right child, so its predecessor is a step away
+    if (target == rightmost)
+        rightmost = predecessor(target);
 
-    Deque<TreeNode *> nodeQueue;
-    Deque<size_t> depthQueue;
+    const key_t &key = target->p.first;
+    TreeNode *lastTouched = nullptr;
+    TreeNode *fixStart = nullptr;
+    TreeNode *node = root;
+    size_t depth = 1;
 
-    nodeQueue.push_back(root);
-    depthQueue.push_back(1);
-    size_t maxDepth = 0;
+    if (!isRed(root->left) && !isRed(root->right))
+        root->color = TreeNode::RED;
 
-    // Use BFS to find depth of the tree
-    while (!nodeQueue.empty())
+    // Top-down pass: keep the current node or its left child red
+    while (true)
     {
-        TreeNode *cur = nodeQueue.pop_front();
-        size_t curDepth = depthQueue.pop_front();
+        if (node != target && less(key, node->p.first))
+        {
+            // Push red link left if 2-node
+            if (!isRed(node->left) && !isRed(node->left->left))
+            {
+                node = relink(node, moveRedLeft(node));
+                lastTouched = lastTouched == nullptr ? node : lastTouched;
+            }
 
-        maxDepth = curDepth > maxDepth ? curDepth : maxDepth;
+            node = node->left;
+            depth++;
+            continue;
+        }
 
-        if (cur->left != nullptr)
+        if (isRed(node->left))
         {
-            nodeQueue.push_back(cur->left);
-            depthQueue.push_back(curDepth + 1);
+            node = relink(node, rotateRight(node));
+            lastTouched = lastTouched == nullptr ? node : lastTouched;
         }
-        if (cur->right != nullptr)
+
+        // Simple case: leaf node deletion
+        if (node == target && node->right == nullptr)
         {
-            nodeQueue.push_back(cur->right);
-            depthQueue.push_back(curDepth + 1);
+            fixStart = node->parent;
+            replaceChild(fixStart, node, nullptr);
+            break;
+        }
+
+        // Push red right if two black nodes
+        if (!isRed(node->right) && !isRed(node->right->left))
+        {
+            node = relink(node, moveRedRight(node));
+            lastTouched = lastTouched == nullptr ? node : lastTouched;
+        }
+
+        if (node != target)
+        {
+            node = node->right;
+            depth++;
+            continue;
+        }
+
+        // Complex case: detach the successor and move it into target's place
+        TreeNode *succ = node->right;
+        depth++;
+        while (succ->left != nullptr)
+        {
+            if (!isRed(succ->left) && !isRed(succ->left->left))
+            {
+                succ = relink(succ, moveRedLeft(succ));
+                lastTouched = lastTouched == nullptr ? succ : lastTouched;
+            }
+            succ = succ->left;
+            depth++;
         }
+
+        fixStart = succ->parent == target ? succ : succ->parent;
+        replaceChild(succ->parent, succ, nullptr);
+
+        succ->left = target->left;
+        succ->right = target->right;
+        succ->parent = target->parent;
+        succ->takeSummary(*target);
+        succ->color = target->color;
+        if (succ->left != nullptr)
+            succ->left->parent = succ;
+        if (succ->right != nullptr)
+            succ->right->parent = succ;
+        replaceChild(succ->parent, target, succ);
+
+        if (lastTouched == target)
+            lastTouched = succ;
+        break;
     }
 
-    return maxDepth;
+    statistics.path(TreeOperation::ERASE, depth);
+
+    if (root == nullptr)
+        return;
+
+    // Backtrack clean up transformation
+    fixUpward(fixStart, lastTouched, false);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+void Map<key_t, value_t, Compare, Allocator, Stats, Augment>::_erase(TreeNode *target)
+{
+    _unlink(target);
+    destroyNode(target);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+void Map<key_t, value_t, Compare, Allocator, Stats, Augment>::erase(const key_t &key)
+{
+    if (root == nullptr)
+        throw std::out_of_range("Invalid erase from empty container");
+
+    TreeNode *target = _at(root, key);
+    if (target == nullptr)
+        throw std::out_of_range("Erase query key not found");
+
+    _erase(target);
+}
+
+/**
+ * Node handles
+ */
+
+// A detached node as a new red leaf: its links and summary are stale
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::TreeNode *Map<key_t, value_t, Compare, Allocator, Stats, Augment>::adoptNode(TreeNode *node)
+{
+    node->left = nullptr;
+    node->right = nullptr;
+    node->parent = nullptr;
+    node->color = TreeNode::RED;
+    pull(node);
+    counter.add();
+    return node;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::node_type Map<key_t, value_t, Compare, Allocator, Stats, Augment>::extract(const key_t &key)
+{
+    if (root == nullptr)
+        throw std::out_of_range("Invalid extract from empty container");
+
+    TreeNode *target = _at(root, key);
+    if (target == nullptr)
+        throw std::out_of_range("Extract query key not found");
+
+    _unlink(target);
+    counter.remove();
+    return NodeHandle(target, alloc);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::node_type Map<key_t, value_t, Compare, Allocator, Stats, Augment>::extract(const_iterator position)
+{
+    if (position.node == nullptr)
+        throw std::out_of_range("Iterator out of bounds");
+
+    _unlink(position.node);
+    counter.remove();
+    return NodeHandle(position.node, alloc);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+std::pair<typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::iterator, bool> Map<key_t, value_t, Compare, Allocator, Stats, Augment>::insert(node_type &&handle)
+{
+    if (handle.node == nullptr)
+        return {end(), false};
+
+    TreeNode *parent;
+    ComparisonResult cmp;
+    TreeNode *node = findSlot(handle.node->p.first, parent, cmp);
+    if (node != nullptr)
+        return {iterator(node, this), false};
+
+    if (alloc == handle.alloc)
+    {
+        node = adoptNode(handle.node);
+        handle.node = nullptr;
+    }
+    else
+    {
+        node = createNode(TreeNode::RED, std::move(handle.node->p));
+        handle.reset();
+    }
+
+    attachNode(node, parent, cmp);
+    return {iterator(node, this), true};
+}
+
+// Unlinking a node leaves every other node in place, so the successor
+// found beforehand is still the next node of that
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+void Map<key_t, value_t, Compare, Allocator, Stats, Augment>::merge(Map &that)
+{
+    if (&that == this)
+        return;
+
+    bool relink = alloc == that.alloc;
+    TreeNode *node = that.minNode();
+    while (node != nullptr)
+    {
+        TreeNode *next = successor(node);
+        TreeNode *parent;
+        ComparisonResult cmp;
+        if (findSlot(node->p.first, parent, cmp) == nullptr)
+        {
+            TreeNode *moved;
+            if (relink)
+            {
+                that._unlink(node);
+                that.counter.remove();
+                moved = adoptNode(node);
+            }
+            else
+            {
+                moved = createNode(TreeNode::RED, node->p);
+                that._erase(node);
+            }
+
+            attachNode(moved, parent, cmp);
+        }
+
+        node = next;
+    }
+}
+
+/**
+ * Join-based set algebra
+ */
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+void Map<key_t, value_t, Compare, Allocator, Stats, Augment>::installRoot(TreeNode *node)
+{
+    root = node;
+    rightmost = node;
+    if (root != nullptr)
+    {
+        root->parent = nullptr;
+        root->color = TreeNode::BLACK;
+        while (rightmost->right != nullptr)
+            rightmost = rightmost->right;
+    }
+}
+
+// Black nodes on any path from node down to a leaf, once node is blackened.
+// Only taken at the roots; the split and join recursions derive the height
+// of each child from its parent.
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+size_t Map<key_t, value_t, Compare, Allocator, Stats, Augment>::blackHeight(TreeNode *node)
+{
+    size_t height = isRed(node) ? 1 : 0;
+    for (; node != nullptr; node = node->left)
+        if (!isRed(node))
+            height++;
+    return height;
+}
+
+// Height of child once blackened, given the height of its parent
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+size_t Map<key_t, value_t, Compare, Allocator, Stats, Augment>::childHeight(TreeNode *child, size_t height)
+{
+    return isRed(child) ? height : height - 1;
+}
+
+/**
+ * Join two detached trees around mid, where every key in left is less
+ * than mid and every key in right is greater. mid is hung as a red node
+ * off the spine of the taller tree at the black height of the shorter
+ * one and fixed up like an inserted node. The black heights of left and
+ * right are passed in, so a join costs O(|leftHeight - rightHeight| + 1).
+ * Returns the new black root; its black height is stored in height.
+ */
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::TreeNode *Map<key_t, value_t, Compare, Allocator, Stats, Augment>::joinTrees(TreeNode *left, size_t leftHeight, TreeNode *mid, TreeNode *right, size_t rightHeight, size_t &height)
+{
+    // Blacken the roots so that black heights count from them
+    if (left != nullptr)
+    {
+        left->parent = nullptr;
+        left->color = TreeNode::BLACK;
+    }
+    if (right != nullptr)
+    {
+        right->parent = nullptr;
+        right->color = TreeNode::BLACK;
+    }
+
+    TreeNode *top = nullptr;
+    TreeNode *parent = nullptr;
+
+    if (leftHeight > rightHeight)
+    {
+        // Right links are black, so every step descends one black level
+        top = left;
+        parent = left;
+        for (size_t height = leftHeight; height > rightHeight + 1; height--)
+            parent = parent->right;
+        left = parent->right;
+        parent->right = mid;
+    }
+    else if (rightHeight > leftHeight)
+    {
+        // Stop on a black node; red left links do not change the height
+        top = right;
+        TreeNode *node = right;
+        for (size_t height = rightHeight; height > leftHeight; height--)
+        {
+            parent = node;
+            node = node->left;
+            if (isRed(node))
+            {
+                parent = node;
+                node = node->left;
+            }
+        }
+        right = node;
+        parent->left = mid;
+    }
+
+    mid->left = left;
+    mid->right = right;
+    mid->parent = parent;
+    if (left != nullptr)
+        left->parent = mid;
+    if (right != nullptr)
+        right->parent = mid;
+    pull(mid);
+
+    if (parent == nullptr)
+    {
+        mid->color = TreeNode::BLACK;
+        height = leftHeight + 1;
+        return mid;
+    }
+
+    mid->color = TreeNode::RED;
+    for (TreeNode *node = parent; node != nullptr;)
+    {
+        TreeNode *up = node->parent;
+        TreeNode *fixed = rbFix(node);
+        if (up == nullptr)
+            top = fixed;
+        else if (up->left == node)
+            up->left = fixed;
+        else
+            up->right = fixed;
+        node = up;
+    }
+
+    // A color flip at the top leaves it red, and blackening it adds a level
+    height = std::max(leftHeight, rightHeight) + (isRed(top) ? 1 : 0);
+    top->color = TreeNode::BLACK;
+    return top;
+}
+
+// Join without a middle key: the maximum of left takes its place
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::TreeNode *Map<key_t, value_t, Compare, Allocator, Stats, Augment>::concatTrees(TreeNode *left, size_t leftHeight, TreeNode *right, size_t rightHeight, size_t &height)
+{
+    if (left == nullptr)
+    {
+        height = rightHeight;
+        return right;
+    }
+    if (right == nullptr)
+    {
+        height = leftHeight;
+        return left;
+    }
+
+    TreeNode *rest = nullptr;
+    size_t restHeight = 0;
+    TreeNode *last = splitLast(left, leftHeight, rest, restHeight);
+    return joinTrees(rest, restHeight, last, right, rightHeight, height);
+}
+
+// Detach the maximum node; the remaining tree is returned through rest
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::TreeNode *Map<key_t, value_t, Compare, Allocator, Stats, Augment>::splitLast(TreeNode *node, size_t height, TreeNode *&rest, size_t &restHeight)
+{
+    TreeNode *left = node->left;
+    TreeNode *right = node->right;
+    size_t leftHeight = childHeight(left, height);
+    if (left != nullptr)
+        left->parent = nullptr;
+
+    if (right == nullptr)
+    {
+        rest = left;
+        restHeight = leftHeight;
+        return node;
+    }
+
+    right->parent = nullptr;
+    TreeNode *last = splitLast(right, childHeight(right, height), rest, restHeight);
+    rest = joinTrees(left, leftHeight, node, rest, restHeight, restHeight);
+    return last;
+}
+
+/**
+ * Split the detached tree at node into the keys less than key (left)
+ * and greater than key (right), with black height height. The node
+ * holding key is detached and returned, or nullptr if there is none.
+ * The black heights of both halves are returned alongside them.
+ */
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <typename K>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::TreeNode *Map<key_t, value_t, Compare, Allocator, Stats, Augment>::splitTree(TreeNode *node, size_t height, const K &key, TreeNode *&left, size_t &leftHeight, TreeNode *&right, size_t &rightHeight)
+{
+    if (node == nullptr)
+    {
+        left = nullptr;
+        right = nullptr;
+        leftHeight = 0;
+        rightHeight = 0;
+        return nullptr;
+    }
+
+    TreeNode *nodeLeft = node->left;
+    TreeNode *nodeRight = node->right;
+    size_t nodeLeftHeight = childHeight(nodeLeft, height);
+    size_t nodeRightHeight = childHeight(nodeRight, height);
+    if (nodeLeft != nullptr)
+        nodeLeft->parent = nullptr;
+    if (nodeRight != nullptr)
+        nodeRight->parent = nullptr;
+
+    ComparisonResult cmp = comp(key, node->p.first);
+    if (cmp == LESS_THAN)
+    {
+        TreeNode *match = splitTree(nodeLeft, nodeLeftHeight, key, left, leftHeight, right, rightHeight);
+        right = joinTrees(right, rightHeight, node, nodeRight, nodeRightHeight, rightHeight);
+        return match;
+    }
+    else if (cmp == GREATER_THAN)
+    {
+        TreeNode *match = splitTree(nodeRight, nodeRightHeight, key, left, leftHeight, right, rightHeight);
+        left = joinTrees(nodeLeft, nodeLeftHeight, node, left, leftHeight, leftHeight);
+        return match;
+    }
+
+    left = nodeLeft;
+    right = nodeRight;
+    leftHeight = nodeLeftHeight;
+    rightHeight = nodeRightHeight;
+    node->left = nullptr;
+    node->right = nullptr;
+    node->parent = nullptr;
+    pull(node);
+    return node;
+}
+
+// Walk both trees in lockstep until one runs out; O(min(|a|, |b|))
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+size_t Map<key_t, value_t, Compare, Allocator, Stats, Augment>::countSmaller(TreeNode *a, TreeNode *b, bool &aSmaller)
+{
+    std::vector<TreeNode *> pendingA;
+    std::vector<TreeNode *> pendingB;
+    if (a != nullptr)
+        pendingA.push_back(a);
+    if (b != nullptr)
+        pendingB.push_back(b);
+
+    size_t count = 0;
+    while (!pendingA.empty() && !pendingB.empty())
+    {
+        for (std::vector<TreeNode *> *pending : {&pendingA, &pendingB})
+        {
+            TreeNode *node = pending->back();
+            pending->pop_back();
+            if (node->left != nullptr)
+                pending->push_back(node->left);
+            if (node->right != nullptr)
+                pending->push_back(node->right);
+        }
+        count++;
+    }
+
+    aSmaller = pendingA.empty();
+    return count;
+}
+
+// Split node by the keys of other, which is only read
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::TreeNode *Map<key_t, value_t, Compare, Allocator, Stats, Augment>::unionTree(TreeNode *node, size_t &height, TreeNode const *other, size_t otherHeight)
+{
+    if (other == nullptr)
+        return node;
+    if (node == nullptr)
+    {
+        height = otherHeight;
+        return copyTree(other);
+    }
+
+    TreeNode *left = nullptr;
+    TreeNode *right = nullptr;
+    size_t leftHeight = 0;
+    size_t rightHeight = 0;
+    TreeNode *mid = splitTree(node, height, other->p.first, left, leftHeight, right, rightHeight);
+    if (mid == nullptr)
+        mid = createNode(TreeNode::RED, other->p);
+    else
+        mid->p.second = other->p.second;
+
+    left = unionTree(left, leftHeight, other->left, childHeight(other->left, otherHeight));
+    right = unionTree(right, rightHeight, other->right, childHeight(other->right, otherHeight));
+    return joinTrees(left, leftHeight, mid, right, rightHeight, height);
+}
+
+// Same as unionTree, but the nodes of other are relinked
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::TreeNode *Map<key_t, value_t, Compare, Allocator, Stats, Augment>::unionSteal(TreeNode *node, size_t &height, TreeNode *other, size_t otherHeight, BulkRun<TreeNode> *run)
+{
+    if (other == nullptr)
+        return node;
+    if (node == nullptr)
+    {
+        height = otherHeight;
+        return other;
+    }
+
+    TreeNode *otherLeft = other->left;
+    TreeNode *otherRight = other->right;
+    size_t otherLeftHeight = childHeight(otherLeft, otherHeight);
+    size_t otherRightHeight = childHeight(otherRight, otherHeight);
+    if (otherLeft != nullptr)
+        otherLeft->parent = nullptr;
+    if (otherRight != nullptr)
+        otherRight->parent = nullptr;
+
+    TreeNode *left = nullptr;
+    TreeNode *right = nullptr;
+    size_t leftHeight = 0;
+    size_t rightHeight = 0;
+    TreeNode *mid = splitTree(node, height, other->p.first, left, leftHeight, right, rightHeight);
+    if (mid == nullptr)
+        mid = other;
+    else
+    {
+        // Values of the other tree win, as with insert()
+        mid->p.second = std::move(other->p.second);
+        other->left = nullptr;
+        other->right = nullptr;
+        discardTree(other, run);
+    }
+
+    size_t work = TreeNode::weight(left) + TreeNode::weight(right) + TreeNode::weight(otherLeft) + TreeNode::weight(otherRight);
+    forkJoin(run, work, [&]
+             { left = unionSteal(left, leftHeight, otherLeft, otherLeftHeight, run); },
+             [&]
+             { right = unionSteal(right, rightHeight, otherRight, otherRightHeight, run); });
+    return joinTrees(left, leftHeight, mid, right, rightHeight, height);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::TreeNode *Map<key_t, value_t, Compare, Allocator, Stats, Augment>::intersectTree(TreeNode *node, size_t &height, TreeNode const *other, BulkRun<TreeNode> *run)
+{
+    if (node == nullptr)
+        return nullptr;
+    if (other == nullptr)
+    {
+        discardTree(node, run);
+        height = 0;
+        return nullptr;
+    }
+
+    TreeNode *left = nullptr;
+    TreeNode *right = nullptr;
+    size_t leftHeight = 0;
+    size_t rightHeight = 0;
+    TreeNode *mid = splitTree(node, height, other->p.first, left, leftHeight, right, rightHeight);
+    forkJoin(run, TreeNode::weight(left) + TreeNode::weight(right) + TreeNode::weight(other), [&]
+             { left = intersectTree(left, leftHeight, other->left, run); },
+             [&]
+             { right = intersectTree(right, rightHeight, other->right, run); });
+
+    if (mid == nullptr)
+        return concatTrees(left, leftHeight, right, rightHeight, height);
+    return joinTrees(left, leftHeight, mid, right, rightHeight, height);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::TreeNode *Map<key_t, value_t, Compare, Allocator, Stats, Augment>::differenceTree(TreeNode *node, size_t &height, TreeNode const *other, BulkRun<TreeNode> *run)
+{
+    if (node == nullptr || other == nullptr)
+        return node;
+
+    TreeNode *left = nullptr;
+    TreeNode *right = nullptr;
+    size_t leftHeight = 0;
+    size_t rightHeight = 0;
+    TreeNode *mid = splitTree(node, height, other->p.first, left, leftHeight, right, rightHeight);
+    if (mid != nullptr)
+        discardTree(mid, run);
+
+    forkJoin(run, TreeNode::weight(left) + TreeNode::weight(right) + TreeNode::weight(other), [&]
+             { left = differenceTree(left, leftHeight, other->left, run); },
+             [&]
+             { right = differenceTree(right, rightHeight, other->right, run); });
+    return concatTrees(left, leftHeight, right, rightHeight, height);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+void Map<key_t, value_t, Compare, Allocator, Stats, Augment>::unionWith(const Map &that)
+{
+    if (&that != this)
+    {
+        size_t height = blackHeight(root);
+        installRoot(unionTree(root, height, that.root, blackHeight(that.root)));
+    }
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+void Map<key_t, value_t, Compare, Allocator, Stats, Augment>::unionWith(Map &&that)
+{
+    if (&that == this)
+        return;
+
+    // Nodes can only change hands between equal allocators
+    if (!(alloc == that.alloc))
+    {
+        unionWith(static_cast<const Map &>(that));
+        return;
+    }
+
+    TreeNode *other = that.root;
+    that.installRoot(nullptr);
+    counter.take(that.counter);
+    size_t height = blackHeight(root);
+    installRoot(unionSteal(root, height, other, blackHeight(other)));
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+void Map<key_t, value_t, Compare, Allocator, Stats, Augment>::intersect(const Map &that)
+{
+    if (&that != this)
+    {
+        size_t height = blackHeight(root);
+        installRoot(intersectTree(root, height, that.root));
+    }
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+void Map<key_t, value_t, Compare, Allocator, Stats, Augment>::difference(const Map &that)
+{
+    if (&that == this)
+    {
+        _deleteTree(root);
+        installRoot(nullptr);
+    }
+    else
+    {
+        size_t height = blackHeight(root);
+        installRoot(differenceTree(root, height, that.root));
+    }
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+Map<key_t, value_t, Compare, Allocator, Stats, Augment> Map<key_t, value_t, Compare, Allocator, Stats, Augment>::split(const key_t &key)
+{
+    // The result shares the allocator, so nodes move without copying
+    Map result{Allocator(alloc)};
+    result.comparator = comparator;
+
+    TreeNode *left = nullptr;
+    TreeNode *right = nullptr;
+    size_t leftHeight = 0;
+    size_t rightHeight = 0;
+    TreeNode *mid = splitTree(root, blackHeight(root), key, left, leftHeight, right, rightHeight);
+    if (mid != nullptr)
+        right = joinTrees(nullptr, 0, mid, right, rightHeight, rightHeight);
+
+    // Without sizes, count whichever half is smaller
+    if (!AugmentNode<Augment>::SIZED)
+    {
+        size_t total = size();
+        bool leftSmaller = false;
+        size_t smaller = countSmaller(left, right, leftSmaller);
+        counter.set(leftSmaller ? smaller : total - smaller);
+        result.counter.set(leftSmaller ? total - smaller : smaller);
+    }
+
+    installRoot(left);
+    result.installRoot(right);
+    return result;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+void Map<key_t, value_t, Compare, Allocator, Stats, Augment>::join(Map &&that)
+{
+    if (&that == this || that.root == nullptr)
+        return;
+    if (root != nullptr && !less(maxNode()->p.first, that.minNode()->p.first))
+        throw std::invalid_argument("Keys passed to join() must be greater than every key in the container");
+
+    TreeNode *other = that.root;
+    if (alloc == that.alloc)
+    {
+        that.installRoot(nullptr);
+        counter.take(that.counter);
+    }
+    else
+        other = copyTree(that.root);
+    size_t height = 0;
+    installRoot(concatTrees(root, blackHeight(root), other, blackHeight(other), height));
+}
+
+/**
+ * Bulk updates
+ */
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+void Map<key_t, value_t, Compare, Allocator, Stats, Augment>::discardTree(TreeNode *node, BulkRun<TreeNode> *run)
+{
+    if (run == nullptr)
+        _deleteTree(node);
+    else
+        run->discard(node);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+void Map<key_t, value_t, Compare, Allocator, Stats, Augment>::releaseDiscarded(BulkRun<TreeNode> &run)
+{
+    run.release([this](TreeNode *node)
+                { _deleteTree(node); });
+}
+
+// Remove the strictly increasing keys from the detached tree at node
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::TreeNode *Map<key_t, value_t, Compare, Allocator, Stats, Augment>::eraseSorted(TreeNode *node, size_t &height, const key_t *keys, size_t count, BulkRun<TreeNode> *run)
+{
+    if (node == nullptr || count == 0)
+        return node;
+
+    size_t middle = count / 2;
+    TreeNode *left = nullptr;
+    TreeNode *right = nullptr;
+    size_t leftHeight = 0;
+    size_t rightHeight = 0;
+    TreeNode *match = splitTree(node, height, keys[middle], left, leftHeight, right, rightHeight);
+    if (match != nullptr)
+        discardTree(match, run);
+
+    forkJoin(run, TreeNode::weight(left) + TreeNode::weight(right) + count, [&]
+             { left = eraseSorted(left, leftHeight, keys, middle, run); },
+             [&]
+             { right = eraseSorted(right, rightHeight, keys + middle + 1, count - middle - 1, run); });
+    return concatTrees(left, leftHeight, right, rightHeight, height);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <typename InputIt>
+void Map<key_t, value_t, Compare, Allocator, Stats, Augment>::_insertBatch(InputIt first, InputIt last, BulkRun<TreeNode> *run)
+{
+    std::vector<std::pair<key_t, value_t>> batch(first, last);
+    auto byKey = [this](const std::pair<key_t, value_t> &lhs, const std::pair<key_t, value_t> &rhs)
+    { return less(lhs.first, rhs.first); };
+    if (run != nullptr)
+        parallelSort(run->executor(), batch.begin(), batch.end(), byKey, run->grain());
+    else
+        std::stable_sort(batch.begin(), batch.end(), byKey);
+
+    // Keep the last pair of every run of equal keys, as repeated insert() would
+    size_t kept = 0;
+    for (size_t i = 0; i < batch.size(); i++)
+    {
+        if (i + 1 < batch.size() && !less(batch[i].first, batch[i + 1].first))
+            continue;
+        if (kept != i)
+            batch[kept] = std::move(batch[i]);
+        kept++;
+    }
+
+    // Nodes are allocated here, on the calling thread, before any fork
+    TreeNode *batchTree = buildTree(std::make_move_iterator(batch.begin()), kept);
+    size_t height = blackHeight(root);
+    installRoot(unionSteal(root, height, batchTree, blackHeight(batchTree), run));
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <typename InputIt>
+void Map<key_t, value_t, Compare, Allocator, Stats, Augment>::_eraseBatch(InputIt first, InputIt last, BulkRun<TreeNode> *run)
+{
+    std::vector<key_t> keys(first, last);
+    auto byKey = [this](const key_t &lhs, const key_t &rhs)
+    { return less(lhs, rhs); };
+    if (run != nullptr)
+        parallelSort(run->executor(), keys.begin(), keys.end(), byKey, run->grain());
+    else
+        std::stable_sort(keys.begin(), keys.end(), byKey);
+
+    size_t kept = 0;
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        if (kept != 0 && !less(keys[kept - 1], keys[i]))
+            continue;
+        if (kept != i)
+            keys[kept] = std::move(keys[i]);
+        kept++;
+    }
+
+    size_t height = blackHeight(root);
+    installRoot(eraseSorted(root, height, keys.data(), kept, run));
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <typename InputIt>
+void Map<key_t, value_t, Compare, Allocator, Stats, Augment>::insertBatch(InputIt first, InputIt last)
+{
+    _insertBatch(first, last, nullptr);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <typename InputIt>
+void Map<key_t, value_t, Compare, Allocator, Stats, Augment>::insertBatch(InputIt first, InputIt last, const ParallelPolicy &policy)
+{
+    BulkRun<TreeNode> run(policy);
+    _insertBatch(first, last, &run);
+    releaseDiscarded(run);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <typename InputIt>
+void Map<key_t, value_t, Compare, Allocator, Stats, Augment>::eraseBatch(InputIt first, InputIt last)
+{
+    _eraseBatch(first, last, nullptr);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <typename InputIt>
+void Map<key_t, value_t, Compare, Allocator, Stats, Augment>::eraseBatch(InputIt first, InputIt last, const ParallelPolicy &policy)
+{
+    BulkRun<TreeNode> run(policy);
+    _eraseBatch(first, last, &run);
+    releaseDiscarded(run);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+void Map<key_t, value_t, Compare, Allocator, Stats, Augment>::unionWith(const Map &that, const ParallelPolicy &policy)
+{
+    if (&that == this)
+        return;
+
+    // Copy up front so that workers never call the allocator
+    BulkRun<TreeNode> run(policy);
+    TreeNode *other = copyTree(that.root);
+    size_t height = blackHeight(root);
+    installRoot(unionSteal(root, height, other, blackHeight(other), &run));
+    releaseDiscarded(run);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+void Map<key_t, value_t, Compare, Allocator, Stats, Augment>::unionWith(Map &&that, const ParallelPolicy &policy)
+{
+    if (&that == this)
+        return;
+    if (!(alloc == that.alloc))
+    {
+        unionWith(static_cast<const Map &>(that), policy);
+        return;
+    }
+
+    BulkRun<TreeNode> run(policy);
+    TreeNode *other = that.root;
+    that.installRoot(nullptr);
+    counter.take(that.counter);
+    size_t height = blackHeight(root);
+    installRoot(unionSteal(root, height, other, blackHeight(other), &run));
+    releaseDiscarded(run);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+void Map<key_t, value_t, Compare, Allocator, Stats, Augment>::intersect(const Map &that, const ParallelPolicy &policy)
+{
+    if (&that == this)
+        return;
+
+    BulkRun<TreeNode> run(policy);
+    size_t height = blackHeight(root);
+    installRoot(intersectTree(root, height, that.root, &run));
+    releaseDiscarded(run);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+void Map<key_t, value_t, Compare, Allocator, Stats, Augment>::difference(const Map &that, const ParallelPolicy &policy)
+{
+    if (&that == this)
+    {
+        difference(that);
+        return;
+    }
+
+    BulkRun<TreeNode> run(policy);
+    size_t height = blackHeight(root);
+    installRoot(differenceTree(root, height, that.root, &run));
+    releaseDiscarded(run);
+}
+
+/**
+ * Inorder iterator
+ */
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::TreeNode *Map<key_t, value_t, Compare, Allocator, Stats, Augment>::minNode() const
+{
+    TreeNode *cur = root;
+    if (cur != nullptr)
+        while (cur->left != nullptr)
+            cur = cur->left;
+
+    return cur;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::TreeNode *Map<key_t, value_t, Compare, Allocator, Stats, Augment>::maxNode() const
+{
+    return rightmost;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::TreeNode *Map<key_t, value_t, Compare, Allocator, Stats, Augment>::successor(TreeNode *node)
+{
+    if (node->right != nullptr)
+    {
+        node = node->right;
+        while (node->left != nullptr)
+            node = node->left;
+        return node;
+    }
+
+    // Climb until we leave a left subtree
+    TreeNode *parent = node->parent;
+    while (parent != nullptr && node == parent->right)
+    {
+        node = parent;
+        parent = parent->parent;
+    }
+
+    return parent;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::TreeNode *Map<key_t, value_t, Compare, Allocator, Stats, Augment>::predecessor(TreeNode *node)
+{
+    if (node->left != nullptr)
+    {
+        node = node->left;
+        while (node->right != nullptr)
+            node = node->right;
+        return node;
+    }
+
+    // Climb until we leave a right subtree
+    TreeNode *parent = node->parent;
+    while (parent != nullptr && node == parent->left)
+    {
+        node = parent;
+        parent = parent->parent;
+    }
+
+    return parent;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <bool isConst>
+Map<key_t, value_t, Compare, Allocator, Stats, Augment>::Iterator<isConst>::Iterator(TreeNode *node, const Map *tree)
+    : node(node), tree(tree) {}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <bool isConst>
+Map<key_t, value_t, Compare, Allocator, Stats, Augment>::Iterator<isConst>::Iterator()
+    : node(nullptr), tree(nullptr) {}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <bool isConst>
+template <bool thatConst, typename>
+Map<key_t, value_t, Compare, Allocator, Stats, Augment>::Iterator<isConst>::Iterator(const Iterator<thatConst> &that)
+    : node(that.node), tree(that.tree) {}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <bool isConst>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::Iterator<isConst>::reference Map<key_t, value_t, Compare, Allocator, Stats, Augment>::Iterator<isConst>::operator*() const
+{
+    if (node == nullptr)
+        throw std::out_of_range("Invalid attempt to dereference null iterator");
+    return node->p;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <bool isConst>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::Iterator<isConst>::pointer Map<key_t, value_t, Compare, Allocator, Stats, Augment>::Iterator<isConst>::operator->() const
+{
+    if (node == nullptr)
+        throw std::out_of_range("Invalid attempt access pointer with null iterator");
+    return &(node->p);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <bool isConst>
+template <bool thatConst>
+bool Map<key_t, value_t, Compare, Allocator, Stats, Augment>::Iterator<isConst>::operator==(const Iterator<thatConst> &that) const
+{
+    return this->node == that.node;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <bool isConst>
+template <bool thatConst>
+bool Map<key_t, value_t, Compare, Allocator, Stats, Augment>::Iterator<isConst>::operator!=(const Iterator<thatConst> &that) const
+{
+    return this->node != that.node;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <bool isConst>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::template Iterator<isConst> &Map<key_t, value_t, Compare, Allocator, Stats, Augment>::Iterator<isConst>::operator++()
+{
+    if (node == nullptr)
+        throw std::out_of_range("Iterator cannot be incremented past the end");
+
+    node = successor(node);
+    return *this;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <bool isConst>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::template Iterator<isConst> Map<key_t, value_t, Compare, Allocator, Stats, Augment>::Iterator<isConst>::operator++(int)
+{
+    Iterator prev = *this;
+    ++*this;
+    return prev;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <bool isConst>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::template Iterator<isConst> &Map<key_t, value_t, Compare, Allocator, Stats, Augment>::Iterator<isConst>::operator--()
+{
+    // Decrementing end() yields the largest key
+    TreeNode *prev = node == nullptr ? tree->maxNode() : predecessor(node);
+    if (prev == nullptr)
+        throw std::out_of_range("Iterator cannot be decremented past the beginning");
+
+    node = prev;
+    return *this;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <bool isConst>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::template Iterator<isConst> Map<key_t, value_t, Compare, Allocator, Stats, Augment>::Iterator<isConst>::operator--(int)
+{
+    Iterator next = *this;
+    --*this;
+    return next;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::iterator Map<key_t, value_t, Compare, Allocator, Stats, Augment>::begin()
+{
+    return iterator(minNode(), this);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::iterator Map<key_t, value_t, Compare, Allocator, Stats, Augment>::end()
+{
+    return iterator(nullptr, this);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::const_iterator Map<key_t, value_t, Compare, Allocator, Stats, Augment>::begin() const
+{
+    return const_iterator(minNode(), this);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::const_iterator Map<key_t, value_t, Compare, Allocator, Stats, Augment>::end() const
+{
+    return const_iterator(nullptr, this);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::const_iterator Map<key_t, value_t, Compare, Allocator, Stats, Augment>::cbegin() const
+{
+    return begin();
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::const_iterator Map<key_t, value_t, Compare, Allocator, Stats, Augment>::cend() const
+{
+    return end();
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::reverse_iterator Map<key_t, value_t, Compare, Allocator, Stats, Augment>::rbegin()
+{
+    return reverse_iterator(end());
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::reverse_iterator Map<key_t, value_t, Compare, Allocator, Stats, Augment>::rend()
+{
+    return reverse_iterator(begin());
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::const_reverse_iterator Map<key_t, value_t, Compare, Allocator, Stats, Augment>::rbegin() const
+{
+    return const_reverse_iterator(end());
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::const_reverse_iterator Map<key_t, value_t, Compare, Allocator, Stats, Augment>::rend() const
+{
+    return const_reverse_iterator(begin());
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::const_reverse_iterator Map<key_t, value_t, Compare, Allocator, Stats, Augment>::crbegin() const
+{
+    return rbegin();
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::const_reverse_iterator Map<key_t, value_t, Compare, Allocator, Stats, Augment>::crend() const
+{
+    return rend();
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::iterator Map<key_t, value_t, Compare, Allocator, Stats, Augment>::find(const key_t &key)
+{
+    return iterator(_at(root, key), this);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <typename K, typename C, typename>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::iterator Map<key_t, value_t, Compare, Allocator, Stats, Augment>::find(const K &key)
+{
+    return iterator(_at(root, key), this);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::const_iterator Map<key_t, value_t, Compare, Allocator, Stats, Augment>::find(const key_t &key) const
+{
+    return const_iterator(_at(root, key), this);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <typename K, typename C, typename>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::const_iterator Map<key_t, value_t, Compare, Allocator, Stats, Augment>::find(const K &key) const
+{
+    return const_iterator(_at(root, key), this);
+}
+
+/**
+ * Node handle
+ */
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+Map<key_t, value_t, Compare, Allocator, Stats, Augment>::NodeHandle::NodeHandle() : node(nullptr), alloc() {}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+Map<key_t, value_t, Compare, Allocator, Stats, Augment>::NodeHandle::NodeHandle(TreeNode *node, const NodeAllocator &alloc) : node(node), alloc(alloc) {}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+Map<key_t, value_t, Compare, Allocator, Stats, Augment>::NodeHandle::NodeHandle(NodeHandle &&that) : node(that.node), alloc(std::move(that.alloc))
+{
+    that.node = nullptr;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::NodeHandle &Map<key_t, value_t, Compare, Allocator, Stats, Augment>::NodeHandle::operator=(NodeHandle &&that)
+{
+    if (&that != this)
+    {
+        reset();
+        node = that.node;
+        alloc = std::move(that.alloc);
+        that.node = nullptr;
+    }
+
+    return *this;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+Map<key_t, value_t, Compare, Allocator, Stats, Augment>::NodeHandle::~NodeHandle()
+{
+    reset();
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+void Map<key_t, value_t, Compare, Allocator, Stats, Augment>::NodeHandle::reset()
+{
+    if (node == nullptr)
+        return;
+
+    NodeAllocTraits::destroy(alloc, node);
+    NodeAllocTraits::deallocate(alloc, node, 1);
+    node = nullptr;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+bool Map<key_t, value_t, Compare, Allocator, Stats, Augment>::NodeHandle::empty() const
+{
+    return node == nullptr;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+Map<key_t, value_t, Compare, Allocator, Stats, Augment>::NodeHandle::operator bool() const
+{
+    return node != nullptr;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+key_t &Map<key_t, value_t, Compare, Allocator, Stats, Augment>::NodeHandle::key() const
+{
+    if (node == nullptr)
+        throw std::out_of_range("Empty node handle");
+    return node->p.first;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+value_t &Map<key_t, value_t, Compare, Allocator, Stats, Augment>::NodeHandle::mapped() const
+{
+    if (node == nullptr)
+        throw std::out_of_range("Empty node handle");
+    return node->p.second;
+}
+
+/**
+ * Range queries
+ */
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::iterator Map<key_t, value_t, Compare, Allocator, Stats, Augment>::lower_bound(const key_t &key)
+{
+    return iterator(_ceiling(root, key), this);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::iterator Map<key_t, value_t, Compare, Allocator, Stats, Augment>::upper_bound(const key_t &key)
+{
+    return iterator(_upper(root, key), this);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+std::pair<typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::iterator, typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::iterator> Map<key_t, value_t, Compare, Allocator, Stats, Augment>::equal_range(const key_t &key)
+{
+    return std::make_pair(lower_bound(key), upper_bound(key));
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+IteratorRange<typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::iterator> Map<key_t, value_t, Compare, Allocator, Stats, Augment>::range(const key_t &lo, const key_t &hi)
+{
+    // An inverted range has its upper bound before lo; lo and hi are
+    // never compared with each other
+    iterator first = lower_bound(lo);
+    iterator last = lower_bound(hi);
+    if (last.node != nullptr && less(last.node->p.first, lo))
+        return IteratorRange<iterator>(first, first);
+    return IteratorRange<iterator>(first, last);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <typename K, typename C, typename>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::iterator Map<key_t, value_t, Compare, Allocator, Stats, Augment>::lower_bound(const K &key)
+{
+    return iterator(_ceiling(root, key), this);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <typename K, typename C, typename>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::iterator Map<key_t, value_t, Compare, Allocator, Stats, Augment>::upper_bound(const K &key)
+{
+    return iterator(_upper(root, key), this);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <typename K, typename C, typename>
+std::pair<typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::iterator, typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::iterator> Map<key_t, value_t, Compare, Allocator, Stats, Augment>::equal_range(const K &key)
+{
+    return std::make_pair(lower_bound(key), upper_bound(key));
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <typename K, typename C, typename>
+IteratorRange<typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::iterator> Map<key_t, value_t, Compare, Allocator, Stats, Augment>::range(const K &lo, const K &hi)
+{
+    // An inverted range has its upper bound before lo; lo and hi are
+    // never compared with each other
+    iterator first = lower_bound(lo);
+    iterator last = lower_bound(hi);
+    if (last.node != nullptr && less(last.node->p.first, lo))
+        return IteratorRange<iterator>(first, first);
+    return IteratorRange<iterator>(first, last);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::const_iterator Map<key_t, value_t, Compare, Allocator, Stats, Augment>::lower_bound(const key_t &key) const
+{
+    return const_iterator(_ceiling(root, key), this);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::const_iterator Map<key_t, value_t, Compare, Allocator, Stats, Augment>::upper_bound(const key_t &key) const
+{
+    return const_iterator(_upper(root, key), this);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+std::pair<typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::const_iterator, typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::const_iterator> Map<key_t, value_t, Compare, Allocator, Stats, Augment>::equal_range(const key_t &key) const
+{
+    return std::make_pair(lower_bound(key), upper_bound(key));
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+IteratorRange<typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::const_iterator> Map<key_t, value_t, Compare, Allocator, Stats, Augment>::range(const key_t &lo, const key_t &hi) const
+{
+    // An inverted range has its upper bound before lo; lo and hi are
+    // never compared with each other
+    const_iterator first = lower_bound(lo);
+    const_iterator last = lower_bound(hi);
+    if (last.node != nullptr && less(last.node->p.first, lo))
+        return IteratorRange<const_iterator>(first, first);
+    return IteratorRange<const_iterator>(first, last);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <typename K, typename C, typename>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::const_iterator Map<key_t, value_t, Compare, Allocator, Stats, Augment>::lower_bound(const K &key) const
+{
+    return const_iterator(_ceiling(root, key), this);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <typename K, typename C, typename>
+typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::const_iterator Map<key_t, value_t, Compare, Allocator, Stats, Augment>::upper_bound(const K &key) const
+{
+    return const_iterator(_upper(root, key), this);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <typename K, typename C, typename>
+std::pair<typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::const_iterator, typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::const_iterator> Map<key_t, value_t, Compare, Allocator, Stats, Augment>::equal_range(const K &key) const
+{
+    return std::make_pair(lower_bound(key), upper_bound(key));
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <typename K, typename C, typename>
+IteratorRange<typename Map<key_t, value_t, Compare, Allocator, Stats, Augment>::const_iterator> Map<key_t, value_t, Compare, Allocator, Stats, Augment>::range(const K &lo, const K &hi) const
+{
+    // An inverted range has its upper bound before lo; lo and hi are
+    // never compared with each other
+    const_iterator first = lower_bound(lo);
+    const_iterator last = lower_bound(hi);
+    if (last.node != nullptr && less(last.node->p.first, lo))
+        return IteratorRange<const_iterator>(first, first);
+    return IteratorRange<const_iterator>(first, last);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+size_t Map<key_t, value_t, Compare, Allocator, Stats, Augment>::rangeCount(const key_t &lo, const key_t &hi) const
+{
+    static_assert(AugmentNode<Augment>::SIZED, "rangeCount() needs subtree sizes, which NoOrderStatistics drops");
+    int loRank = _rank(root, lo);
+    int hiRank = _rank(root, hi);
+    return hiRank > loRank ? hiRank - loRank : 0;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <typename K, typename C, typename>
+size_t Map<key_t, value_t, Compare, Allocator, Stats, Augment>::rangeCount(const K &lo, const K &hi) const
+{
+    static_assert(AugmentNode<Augment>::SIZED, "rangeCount() needs subtree sizes, which NoOrderStatistics drops");
+    int loRank = _rank(root, lo);
+    int hiRank = _rank(root, hi);
+    return hiRank > loRank ? hiRank - loRank : 0;
+}
+
+/**
+ * Tree processing
+ */
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <typename Commit, typename KeyWriter>
+void Map<key_t, value_t, Compare, Allocator, Stats, Augment>::_serialize(std::string &out, Commit &&commit, KeyWriter &&writeKey, const std::string &delim, const std::string &nilStr) const
+{
+    // Preorder DFS to serialize tree; the stack holds at most one path
+    std::vector<const TreeNode *> nodeStack;
+    nodeStack.push_back(root);
+    while (!nodeStack.empty())
+    {
+        const TreeNode *cur = nodeStack.back();
+        nodeStack.pop_back();
+        writeKey(cur->p.first, out);
+        out += delim;
+
+        if (cur->right != nullptr)
+            nodeStack.push_back(cur->right);
+        if (cur->left != nullptr)
+            nodeStack.push_back(cur->left);
+
+        if (cur->left == nullptr && cur->right == nullptr)
+            out += nilStr;
+        commit();
+    }
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+std::string Map<key_t, value_t, Compare, Allocator, Stats, Augment>::serialize(const std::function<std::string(const key_t &)> &objToString, const std::string &delim, const std::string &nilStr) const
+{
+    if (empty())
+        throw std::out_of_range("Invalid serialization of empty container");
+
+    // Reserve space: there will be 3 / 8 * size nil nodes on average.
+    std::string serializedTree;
+    size_t sizeDiv8 = size() >> 3;
+    serializedTree.reserve(size() * (1 + delim.size()) + (sizeDiv8 + sizeDiv8 + sizeDiv8) * nilStr.size());
+
+    _serialize(
+        serializedTree, [] {},
+        [&](const key_t &key, std::string &out)
+        { out += objToString(key); },
+        delim, nilStr);
+    return serializedTree;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <typename Sink, typename KeyWriter>
+void Map<key_t, value_t, Compare, Allocator, Stats, Augment>::serializeTo(Sink &&sink, KeyWriter &&writeKey, const std::string &delim, const std::string &nilStr) const
+{
+    if (empty())
+        throw std::out_of_range("Invalid serialization of empty container");
+
+    ChunkedOutput<decltype(sinkWriter(sink))> output(sinkWriter(sink));
+    _serialize(
+        output.buffer(), [&]
+        { output.commit(); },
+        writeKey, delim, nilStr);
+    output.flush();
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <typename Commit, typename KeyCodec, typename ValueCodec>
+void Map<key_t, value_t, Compare, Allocator, Stats, Augment>::_serializeBinary(std::string &out, Commit &&commit, const KeyCodec &keyCodec, const ValueCodec &valueCodec) const
+{
+    TreeFormat::appendHeader(out, size());
+    if (empty())
+        return;
+
+    std::vector<const TreeNode *> nodeStack;
+    nodeStack.push_back(root);
+    while (!nodeStack.empty())
+    {
+        const TreeNode *cur = nodeStack.back();
+        nodeStack.pop_back();
+        unsigned char flags = (cur->color == TreeNode::RED ? TreeFormat::RED : 0) |
+                              (cur->left != nullptr ? TreeFormat::HAS_LEFT : 0) |
+                              (cur->right != nullptr ? TreeFormat::HAS_RIGHT : 0);
+        out.push_back(static_cast<char>(flags));
+        keyCodec.encode(cur->p.first, out);
+        valueCodec.encode(cur->p.second, out);
+
+        if (cur->right != nullptr)
+            nodeStack.push_back(cur->right);
+        if (cur->left != nullptr)
+            nodeStack.push_back(cur->left);
+        commit();
+    }
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <typename KeyCodec, typename ValueCodec>
+std::string Map<key_t, value_t, Compare, Allocator, Stats, Augment>::serializeBinary(const KeyCodec &keyCodec, const ValueCodec &valueCodec) const
+{
+    // Exact for fixed-size payloads, a lower bound otherwise
+    std::string bytes;
+    bytes.reserve(13 + size() * (1 + sizeof(key_t) + sizeof(value_t)));
+    _serializeBinary(bytes, [] {}, keyCodec, valueCodec);
+    return bytes;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <typename Sink, typename KeyCodec, typename ValueCodec>
+void Map<key_t, value_t, Compare, Allocator, Stats, Augment>::serializeBinaryTo(Sink &&sink, const KeyCodec &keyCodec, const ValueCodec &valueCodec) const
+{
+    ChunkedOutput<decltype(sinkWriter(sink))> output(sinkWriter(sink));
+    _serializeBinary(
+        output.buffer(), [&]
+        { output.commit(); },
+        keyCodec, valueCodec);
+    output.flush();
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <typename KeyCodec, typename ValueCodec>
+Map<key_t, value_t, Compare, Allocator, Stats, Augment> Map<key_t, value_t, Compare, Allocator, Stats, Augment>::deserializeBinary(const std::string &bytes, const KeyCodec &keyCodec, const ValueCodec &valueCodec)
+{
+    return deserializeBinary(bytes.data(), bytes.size(), keyCodec, valueCodec);
+}
+
+// Keys are trusted to be in order; the shape is checked to be a valid LLRB
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+template <typename KeyCodec, typename ValueCodec>
+Map<key_t, value_t, Compare, Allocator, Stats, Augment> Map<key_t, value_t, Compare, Allocator, Stats, Augment>::deserializeBinary(const char *data, size_t length, const KeyCodec &keyCodec, const ValueCodec &valueCodec)
+{
+    const char *cursor = data;
+    const char *end = data + length;
+    uint64_t count = TreeFormat::readHeader(cursor, end, 1 + CodecMinBytes<KeyCodec>::value + CodecMinBytes<ValueCodec>::value);
+
+    // Child link still to be filled, with the black nodes above it
+    struct Slot
+    {
+        TreeNode *parent;
+        bool right;
+        size_t blackDepth;
+    };
+
+    Map tree;
+    std::vector<TreeNode *> preorder;
+    preorder.reserve(count);
+    std::vector<Slot> slots;
+    if (count > 0)
+        slots.push_back({nullptr, false, 0});
+
+    size_t nilBlackDepth = 0;
+    for (uint64_t i = 0; i < count; i++)
+    {
+        if (slots.empty())
+            throw std::invalid_argument("Serialized input has more nodes than its shape");
+
+        Slot slot = slots.back();
+        slots.pop_back();
+        unsigned char flags = TreeFormat::readFlags(cursor, end);
+        bool red = (flags & TreeFormat::RED) != 0;
+        if (red && (slot.parent == nullptr || slot.right || slot.parent->color == TreeNode::RED))
+            throw std::invalid_argument("Serialized input is not a left-leaning red-black tree");
+
+        key_t key = keyCodec.decode(cursor, end);
+        value_t value = valueCodec.decode(cursor, end);
+        TreeNode *node = tree.createNode(red, std::move(key), std::move(value));
+        node->parent = slot.parent;
+        if (slot.parent == nullptr)
+            tree.root = node;
+        else if (slot.right)
+            slot.parent->right = node;
+        else
+            slot.parent->left = node;
+        preorder.push_back(node);
+
+        // Every nil link must lie below the same number of black nodes
+        size_t blackDepth = slot.blackDepth + (red ? 0 : 1);
+        if (blackDepth > 64)
+            throw std::invalid_argument("Serialized input is not a left-leaning red-black tree");
+        if ((flags & TreeFormat::HAS_LEFT) == 0 || (flags & TreeFormat::HAS_RIGHT) == 0)
+        {
+            if (nilBlackDepth == 0)
+                nilBlackDepth = blackDepth;
+            else if (blackDepth != nilBlackDepth)
+                throw std::invalid_argument("Serialized input is not a left-leaning red-black tree");
+        }
+
+        if (flags & TreeFormat::HAS_RIGHT)
+            slots.push_back({node, true, blackDepth});
+        if (flags & TreeFormat::HAS_LEFT)
+            slots.push_back({node, false, blackDepth});
+    }
+
+    if (!slots.empty())
+        throw std::invalid_argument("Serialized input has fewer nodes than its shape");
+    if (cursor != end)
+        throw std::invalid_argument("Serialized input has trailing bytes");
+
+    // Children follow their parent in preorder
+    for (size_t i = preorder.size(); i-- > 0;)
+        tree.pull(preorder[i]);
+    tree.installRoot(tree.root);
+    return tree;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+size_t Map<key_t, value_t, Compare, Allocator, Stats, Augment>::depth() const
+{
+    if (empty())
+        return 0;
+
+    Deque<TreeNode *> nodeQueue;
+    Deque<size_t> depthQueue;
+
+    nodeQueue.push_back(root);
+    depthQueue.push_back(1);
+    size_t maxDepth = 0;
+
+    // Use BFS to find depth of the tree
+    while (!nodeQueue.empty())
+    {
+        TreeNode *cur = nodeQueue.pop_front();
+        size_t curDepth = depthQueue.pop_front();
+
+        maxDepth = curDepth > maxDepth ? curDepth : maxDepth;
+
+        if (cur->left != nullptr)
+        {
+            nodeQueue.push_back(cur->left);
+            depthQueue.push_back(curDepth + 1);
+        }
+        if (cur->right != nullptr)
+        {
+            nodeQueue.push_back(cur->right);
+            depthQueue.push_back(curDepth + 1);
+        }
+    }
+
+    return maxDepth;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+FrozenMap<key_t, value_t, Compare> Map<key_t, value_t, Compare, Allocator, Stats, Augment>::freeze() const
+{
+    std::vector<std::pair<key_t, value_t>> sorted;
+    sorted.reserve(size());
+    for (auto it = cbegin(); it != cend(); ++it)
+        sorted.push_back(*it);
+    return FrozenMap<key_t, value_t, Compare>(std::move(sorted), comparator, false);
 }
 
 /**
  * Delete Tree
  */
-template <typename key_t, typename value_t, typename Compare>
-void Map<key_t, value_t, Compare>::_deleteTree(TreeNode *node)
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+void Map<key_t, value_t, Compare, Allocator, Stats, Augment>::_deleteTree(TreeNode *node)
 {
     if (node == nullptr)
         return;
 
     _deleteTree(node->left);
     _deleteTree(node->right);
-    delete node;
+    destroyNode(node);
 }
 
-template <typename key_t, typename value_t, typename Compare>
-Map<key_t, value_t, Compare>::~Map()
+template <typename key_t, typename value_t, typename Compare, typename Allocator, typename Stats, typename Augment>
+Map<key_t, value_t, Compare, Allocator, Stats, Augment>::~Map()
 {
     _deleteTree(root);
 }
@@ -0,0 +1,185 @@
+/**multi_map.hpp
+ *
+ * Interface for a left-leaning red black tree ordered symbol table
+ * that keeps duplicate keys. Equal keys stay in insertion order: an
+ * insert goes after every equal key already present. Subtree sizes
+ * count every copy, so count, rank and rankSelect take O(log n) time,
+ * and erasure finds its node by rank rather than by key.
+ */
+
+#ifndef RBMULTIMAP_H
+#define RBMULTIMAP_H
+
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "compare.hpp"
+#include "link_tree.hpp"
+#include "pool.hpp"
+
+template <typename key_t, typename value_t, typename Compare = std::less<key_t>,
+          typename Allocator = PoolAllocator<std::pair<key_t, value_t>>>
+class MultiMap
+{
+private:
+    /**
+     * TreeNode
+     */
+
+    class TreeNode
+    {
+    public:
+        const static bool RED = true;
+        const static bool BLACK = false;
+
+        std::pair<key_t, value_t> p;
+        TreeNode *left;
+        TreeNode *right;
+        size_t sz;
+        bool color;
+
+        template <typename... Args>
+        TreeNode(bool c, Args &&...args)
+            : p(std::forward<Args>(args)...), left(nullptr), right(nullptr), sz(1), color(c) {}
+
+        void pull() { sz = 1 + (left ? left->sz : 0) + (right ? right->sz : 0); }
+    };
+
+    using NodeAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<TreeNode>;
+    using NodeAllocTraits = std::allocator_traits<NodeAllocator>;
+    using Links = LinkTree<TreeNode>;
+
+    // Tree attributes
+    TreeNode *root;
+    Compare comparator;
+    NodeAllocator alloc;
+
+    // Node allocation
+    template <typename... Args>
+    TreeNode *createNode(bool color, Args &&...args);
+    void destroyNode(TreeNode *node);
+    TreeNode *copyTree(const TreeNode *node);
+    void deleteTree(TreeNode *node);
+
+    // Utilities
+    bool less(const key_t &k1, const key_t &k2) const;
+    static size_t nodeSize(const TreeNode *node);
+
+    // Recursive updates
+    template <typename P>
+    void _insert(TreeNode *&link, P &&pair);
+    void _eraseAt(TreeNode *&link, size_t rank);
+    void eraseAt(size_t rank);
+
+    // Search helpers
+    size_t lowerRank(const key_t &key) const; // Entries with smaller keys
+    size_t upperRank(const key_t &key) const; // Entries with keys not greater
+
+public:
+    class Iterator;
+    using iterator = Iterator;
+    using const_iterator = Iterator;
+
+    /**
+     * Constructors
+     */
+
+    MultiMap();
+    MultiMap(const std::initializer_list<std::pair<key_t, value_t>> &init);
+    explicit MultiMap(const Allocator &allocator);
+    MultiMap(const MultiMap &that); // Deep copy
+    MultiMap(MultiMap &&that);
+
+    /**
+     * Utilities
+     */
+
+    size_t size() const;
+    bool empty() const;
+
+    MultiMap &operator=(const MultiMap &that);
+    MultiMap &operator=(MultiMap &&that);
+
+    /**
+     * Search
+     */
+
+    bool contains(const key_t &key) const;
+    size_t count(const key_t &key) const; // O(log n) however many copies
+
+    /**
+     * Ordered symbol table operations
+     */
+
+    int rank(const key_t &key) const; // Every copy counts
+    key_t min() const;
+    key_t max() const;
+    key_t rankSelect(int rank) const;
+
+    /**
+     * Insertion & deletion
+     */
+
+    // Always adds an entry, after any with an equal key
+    void insert(const std::pair<key_t, value_t> &pair);
+    void insert(std::pair<key_t, value_t> &&pair);
+    size_t erase(const key_t &key); // Every copy; returns how many
+    void eraseOne(const key_t &key); // The earliest inserted copy
+
+    /**
+     * Destructor
+     */
+
+    ~MultiMap();
+
+    /**
+     * Inorder iterator
+     */
+
+    class Iterator
+    {
+    private:
+        friend class MultiMap;
+
+        std::vector<const TreeNode *> path; // Nodes still to visit; back() is current
+
+        explicit Iterator(const TreeNode *root);
+        void pushLeft(const TreeNode *node);
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::pair<key_t, value_t>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const value_type *;
+        using reference = const value_type &;
+
+        Iterator();
+
+        reference operator*() const;
+        pointer operator->() const;
+        bool operator==(const Iterator &that) const;
+        bool operator!=(const Iterator &that) const;
+
+        Iterator &operator++();
+        Iterator operator++(int);
+    };
+
+    const_iterator begin() const;
+    const_iterator end() const;
+    const_iterator cbegin() const;
+    const_iterator cend() const;
+
+    // Bounds: first entry not less than / greater than key
+    const_iterator lower_bound(const key_t &key) const;
+    const_iterator upper_bound(const key_t &key) const;
+    std::pair<const_iterator, const_iterator> equal_range(const key_t &key) const;
+};
+
+#include "multi_map.ipp"
+
+#endif /*RBMULTIMAP_H*/
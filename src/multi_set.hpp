@@ -0,0 +1,184 @@
+/**multi_set.hpp
+ *
+ * Interface for a left-leaning red black tree ordered set that keeps
+ * duplicate keys. Equivalent keys stay in insertion order: an insert
+ * goes after every equivalent key already present. Subtree sizes count
+ * every copy, so count, rank and rankSelect take O(log n) time, and
+ * erasure finds its node by rank rather than by key.
+ */
+
+#ifndef RBMULTISET_H
+#define RBMULTISET_H
+
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "compare.hpp"
+#include "link_tree.hpp"
+#include "pool.hpp"
+
+template <typename key_t, typename Compare = std::less<key_t>, typename Allocator = PoolAllocator<key_t>>
+class MultiSet
+{
+private:
+    /**
+     * TreeNode
+     */
+
+    class TreeNode
+    {
+    public:
+        const static bool RED = true;
+        const static bool BLACK = false;
+
+        key_t key;
+        TreeNode *left;
+        TreeNode *right;
+        size_t sz;
+        bool color;
+
+        template <typename... Args>
+        TreeNode(bool c, Args &&...args)
+            : key(std::forward<Args>(args)...), left(nullptr), right(nullptr), sz(1), color(c) {}
+
+        void pull() { sz = 1 + (left ? left->sz : 0) + (right ? right->sz : 0); }
+    };
+
+    using NodeAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<TreeNode>;
+    using NodeAllocTraits = std::allocator_traits<NodeAllocator>;
+    using Links = LinkTree<TreeNode>;
+
+    // Tree attributes
+    TreeNode *root;
+    Compare comparator;
+    NodeAllocator alloc;
+
+    // Node allocation
+    template <typename... Args>
+    TreeNode *createNode(bool color, Args &&...args);
+    void destroyNode(TreeNode *node);
+    TreeNode *copyTree(const TreeNode *node);
+    void deleteTree(TreeNode *node);
+
+    // Utilities
+    bool less(const key_t &k1, const key_t &k2) const;
+    static size_t nodeSize(const TreeNode *node);
+
+    // Recursive updates
+    template <typename P>
+    void _insert(TreeNode *&link, P &&key);
+    void _eraseAt(TreeNode *&link, size_t rank);
+    void eraseAt(size_t rank);
+
+    // Search helpers
+    size_t lowerRank(const key_t &key) const; // Keys less than key
+    size_t upperRank(const key_t &key) const; // Keys not greater than key
+
+public:
+    class Iterator;
+    using iterator = Iterator;
+    using const_iterator = Iterator;
+
+    /**
+     * Constructors
+     */
+
+    MultiSet();
+    MultiSet(const std::initializer_list<key_t> &init);
+    explicit MultiSet(const Allocator &allocator);
+    MultiSet(const MultiSet &that); // Deep copy
+    MultiSet(MultiSet &&that);
+
+    /**
+     * Utilities
+     */
+
+    size_t size() const;
+    bool empty() const;
+
+    MultiSet &operator=(const MultiSet &that);
+    MultiSet &operator=(MultiSet &&that);
+
+    /**
+     * Search
+     */
+
+    bool contains(const key_t &key) const;
+    size_t count(const key_t &key) const; // O(log n) however many copies
+
+    /**
+     * Ordered set operations
+     */
+
+    int rank(const key_t &key) const; // Every copy counts
+    key_t min() const;
+    key_t max() const;
+    key_t rankSelect(int rank) const;
+
+    /**
+     * Insertion & deletion
+     */
+
+    // Always adds a copy, after any equal key
+    void insert(const key_t &key);
+    void insert(key_t &&key);
+    size_t erase(const key_t &key); // Every copy; returns how many
+    void eraseOne(const key_t &key); // The earliest inserted copy
+
+    /**
+     * Destructor
+     */
+
+    ~MultiSet();
+
+    /**
+     * Inorder iterator
+     */
+
+    class Iterator
+    {
+    private:
+        friend class MultiSet;
+
+        std::vector<const TreeNode *> path; // Nodes still to visit; back() is current
+
+        explicit Iterator(const TreeNode *root);
+        void pushLeft(const TreeNode *node);
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = key_t;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const value_type *;
+        using reference = const value_type &;
+
+        Iterator();
+
+        reference operator*() const;
+        pointer operator->() const;
+        bool operator==(const Iterator &that) const;
+        bool operator!=(const Iterator &that) const;
+
+        Iterator &operator++();
+        Iterator operator++(int);
+    };
+
+    const_iterator begin() const;
+    const_iterator end() const;
+    const_iterator cbegin() const;
+    const_iterator cend() const;
+
+    // Bounds: first key not less than / greater than key
+    const_iterator lower_bound(const key_t &key) const;
+    const_iterator upper_bound(const key_t &key) const;
+    std::pair<const_iterator, const_iterator> equal_range(const key_t &key) const;
+};
+
+#include "multi_set.ipp"
+
+#endif /*RBMULTISET_H*/
@@ -0,0 +1,578 @@
+/**multi_set.ipp
+ *
+ * Implementation for the left-leaning red black tree ordered set
+ * with duplicate keys.
+ */
+
+#ifndef RBMULTISET_I
+#define RBMULTISET_I
+
+#include <stdexcept>
+#include <utility>
+
+#include "multi_set.hpp"
+
+// Node allocation
+template <typename key_t, typename Compare, typename Allocator>
+template <typename... Args>
+typename MultiSet<key_t, Compare, Allocator>::TreeNode *MultiSet<key_t, Compare, Allocator>::createNode(bool color, Args &&...args)
+{
+    TreeNode *node = NodeAllocTraits::allocate(alloc, 1);
+    try
+    {
+        NodeAllocTraits::construct(alloc, node, color, std::forward<Args>(args)...);
+    }
+    catch (...)
+    {
+        NodeAllocTraits::deallocate(alloc, node, 1);
+        throw;
+    }
+
+    return node;
+}
+
+template <typename key_t, typename Compare, typename Allocator>
+void MultiSet<key_t, Compare, Allocator>::destroyNode(TreeNode *node)
+{
+    NodeAllocTraits::destroy(alloc, node);
+    NodeAllocTraits::deallocate(alloc, node, 1);
+}
+
+template <typename key_t, typename Compare, typename Allocator>
+typename MultiSet<key_t, Compare, Allocator>::TreeNode *MultiSet<key_t, Compare, Allocator>::copyTree(const TreeNode *node)
+{
+    if (node == nullptr)
+        return nullptr;
+
+    TreeNode *curNode = createNode(node->color, node->key);
+    curNode->sz = node->sz;
+    try
+    {
+        curNode->left = copyTree(node->left);
+        curNode->right = copyTree(node->right);
+    }
+    catch (...)
+    {
+        deleteTree(curNode);
+        throw;
+    }
+
+    return curNode;
+}
+
+template <typename key_t, typename Compare, typename Allocator>
+void MultiSet<key_t, Compare, Allocator>::deleteTree(TreeNode *node)
+{
+    if (node == nullptr)
+        return;
+
+    deleteTree(node->left);
+    deleteTree(node->right);
+    destroyNode(node);
+}
+
+/**
+ * Utilities
+ */
+
+template <typename key_t, typename Compare, typename Allocator>
+bool MultiSet<key_t, Compare, Allocator>::less(const key_t &k1, const key_t &k2) const
+{
+    return keyLess(comparator, k1, k2, HasThreeWayCompare<Compare, key_t, key_t>());
+}
+
+template <typename key_t, typename Compare, typename Allocator>
+size_t MultiSet<key_t, Compare, Allocator>::nodeSize(const TreeNode *node)
+{
+    return node == nullptr ? 0 : node->sz;
+}
+
+/**
+ * Recursive updates
+ */
+
+// Equal keys go right, behind the copies already present
+template <typename key_t, typename Compare, typename Allocator>
+template <typename P>
+void MultiSet<key_t, Compare, Allocator>::_insert(TreeNode *&link, P &&key)
+{
+    if (link == nullptr)
+    {
+        link = createNode(TreeNode::RED, std::forward<P>(key));
+        return;
+    }
+
+    if (less(key, link->key))
+        _insert(link->left, std::forward<P>(key));
+    else
+        _insert(link->right, std::forward<P>(key));
+
+    Links::rbFix(link);
+}
+
+// Keys cannot tell copies apart, so the descent is steered by rank. The
+// fixups keep the entries of a subtree in order, so a rank relative to
+// the subtree only changes when the descent moves right.
+template <typename key_t, typename Compare, typename Allocator>
+void MultiSet<key_t, Compare, Allocator>::_eraseAt(TreeNode *&link, size_t rank)
+{
+    if (rank < nodeSize(link->left))
+    {
+        // Push red link left if 2-node
+        if (!Links::isRed(link->left) && !Links::isRed(link->left->left))
+            Links::moveRedLeft(link);
+
+        _eraseAt(link->left, rank);
+    }
+    else
+    {
+        if (Links::isRed(link->left))
+            Links::rotateRight(link);
+
+        // Simple case: leaf node deletion
+        if (rank == nodeSize(link->left) && link->right == nullptr)
+        {
+            destroyNode(link);
+            link = nullptr;
+            return;
+        }
+
+        // Push red link right if two black nodes
+        if (!Links::isRed(link->right) && !Links::isRed(link->right->left))
+            Links::moveRedRight(link);
+
+        // Complex case: take over the payload of the successor
+        size_t leftSize = nodeSize(link->left);
+        if (rank == leftSize)
+        {
+            TreeNode *successor = link->right;
+            while (successor->left != nullptr)
+                successor = successor->left;
+
+            link->key = std::move(successor->key);
+            destroyNode(Links::takeMin(link->right));
+        }
+        else
+            _eraseAt(link->right, rank - leftSize - 1);
+    }
+
+    Links::rbFix(link);
+}
+
+template <typename key_t, typename Compare, typename Allocator>
+void MultiSet<key_t, Compare, Allocator>::eraseAt(size_t rank)
+{
+    if (!Links::isRed(root->left) && !Links::isRed(root->right))
+        root->color = TreeNode::RED;
+
+    _eraseAt(root, rank);
+    if (root != nullptr)
+        root->color = TreeNode::BLACK;
+}
+
+/**
+ * Search helpers
+ */
+
+template <typename key_t, typename Compare, typename Allocator>
+size_t MultiSet<key_t, Compare, Allocator>::lowerRank(const key_t &key) const
+{
+    size_t rank = 0;
+    const TreeNode *node = root;
+    while (node != nullptr)
+    {
+        if (less(node->key, key))
+        {
+            rank += nodeSize(node->left) + 1;
+            node = node->right;
+        }
+        else
+            node = node->left;
+    }
+
+    return rank;
+}
+
+template <typename key_t, typename Compare, typename Allocator>
+size_t MultiSet<key_t, Compare, Allocator>::upperRank(const key_t &key) const
+{
+    size_t rank = 0;
+    const TreeNode *node = root;
+    while (node != nullptr)
+    {
+        if (less(key, node->key))
+            node = node->left;
+        else
+        {
+            rank += nodeSize(node->left) + 1;
+            node = node->right;
+        }
+    }
+
+    return rank;
+}
+
+/**
+ * Constructors
+ */
+
+template <typename key_t, typename Compare, typename Allocator>
+MultiSet<key_t, Compare, Allocator>::MultiSet()
+    : root(nullptr), alloc() {}
+
+template <typename key_t, typename Compare, typename Allocator>
+MultiSet<key_t, Compare, Allocator>::MultiSet(const std::initializer_list<key_t> &init)
+    : MultiSet()
+{
+    for (const key_t &key : init)
+        insert(key);
+}
+
+template <typename key_t, typename Compare, typename Allocator>
+MultiSet<key_t, Compare, Allocator>::MultiSet(const Allocator &allocator)
+    : root(nullptr), alloc(allocator) {}
+
+template <typename key_t, typename Compare, typename Allocator>
+MultiSet<key_t, Compare, Allocator>::MultiSet(const MultiSet &that)
+    : root(nullptr), comparator(that.comparator), alloc(NodeAllocTraits::select_on_container_copy_construction(that.alloc))
+{
+    root = copyTree(that.root);
+}
+
+// The allocator is copied rather than moved so that the emptied source
+// can still allocate nodes.
+template <typename key_t, typename Compare, typename Allocator>
+MultiSet<key_t, Compare, Allocator>::MultiSet(MultiSet &&that)
+    : root(that.root), comparator(that.comparator), alloc(that.alloc)
+{
+    that.root = nullptr;
+}
+
+/**
+ * Utilities
+ */
+
+template <typename key_t, typename Compare, typename Allocator>
+size_t MultiSet<key_t, Compare, Allocator>::size() const
+{
+    return nodeSize(root);
+}
+
+template <typename key_t, typename Compare, typename Allocator>
+bool MultiSet<key_t, Compare, Allocator>::empty() const
+{
+    return root == nullptr;
+}
+
+template <typename key_t, typename Compare, typename Allocator>
+MultiSet<key_t, Compare, Allocator> &MultiSet<key_t, Compare, Allocator>::operator=(const MultiSet &that)
+{
+    // Copy into a temporary on this allocator, which is not propagated,
+    // then swap; nodes keep moving between containers sharing a pool
+    MultiSet temp{Allocator(alloc)};
+    temp.comparator = that.comparator;
+    temp.root = temp.copyTree(that.root);
+    std::swap(this->root, temp.root);
+    std::swap(this->comparator, temp.comparator);
+
+    return *this;
+}
+
+template <typename key_t, typename Compare, typename Allocator>
+MultiSet<key_t, Compare, Allocator> &MultiSet<key_t, Compare, Allocator>::operator=(MultiSet &&that)
+{
+    // The old nodes leave with that and are freed by its destructor
+    std::swap(this->root, that.root);
+    std::swap(this->comparator, that.comparator);
+    std::swap(this->alloc, that.alloc);
+
+    return *this;
+}
+
+/**
+ * Search
+ */
+
+template <typename key_t, typename Compare, typename Allocator>
+bool MultiSet<key_t, Compare, Allocator>::contains(const key_t &key) const
+{
+    const TreeNode *node = root;
+    while (node != nullptr)
+    {
+        if (less(key, node->key))
+            node = node->left;
+        else if (less(node->key, key))
+            node = node->right;
+        else
+            return true;
+    }
+
+    return false;
+}
+
+template <typename key_t, typename Compare, typename Allocator>
+size_t MultiSet<key_t, Compare, Allocator>::count(const key_t &key) const
+{
+    return upperRank(key) - lowerRank(key);
+}
+
+/**
+ * Ordered set operations
+ */
+
+template <typename key_t, typename Compare, typename Allocator>
+int MultiSet<key_t, Compare, Allocator>::rank(const key_t &key) const
+{
+    return static_cast<int>(lowerRank(key));
+}
+
+template <typename key_t, typename Compare, typename Allocator>
+key_t MultiSet<key_t, Compare, Allocator>::min() const
+{
+    if (empty())
+        throw std::out_of_range("Invalid call to min() with empty container");
+
+    const TreeNode *node = root;
+    while (node->left != nullptr)
+        node = node->left;
+    return node->key;
+}
+
+template <typename key_t, typename Compare, typename Allocator>
+key_t MultiSet<key_t, Compare, Allocator>::max() const
+{
+    if (empty())
+        throw std::out_of_range("Invalid call to max() with empty container");
+
+    const TreeNode *node = root;
+    while (node->right != nullptr)
+        node = node->right;
+    return node->key;
+}
+
+template <typename key_t, typename Compare, typename Allocator>
+key_t MultiSet<key_t, Compare, Allocator>::rankSelect(int rank) const
+{
+    if (empty())
+        throw std::out_of_range("Invalid call to rankSelect() with empty container");
+    if (rank < 0 || static_cast<size_t>(rank) >= size())
+        throw std::out_of_range("Argument to rankSelect() is invalid");
+
+    const TreeNode *node = root;
+    size_t remaining = rank;
+    while (true)
+    {
+        size_t leftSize = nodeSize(node->left);
+        if (remaining < leftSize)
+            node = node->left;
+        else if (remaining > leftSize)
+        {
+            remaining -= leftSize + 1;
+            node = node->right;
+        }
+        else
+            return node->key;
+    }
+}
+
+/**
+ * Insertion & deletion
+ */
+
+template <typename key_t, typename Compare, typename Allocator>
+void MultiSet<key_t, Compare, Allocator>::insert(const key_t &key)
+{
+    _insert(root, key);
+    root->color = TreeNode::BLACK;
+}
+
+template <typename key_t, typename Compare, typename Allocator>
+void MultiSet<key_t, Compare, Allocator>::insert(key_t &&key)
+{
+    _insert(root, std::move(key));
+    root->color = TreeNode::BLACK;
+}
+
+// The copies are contiguous by rank: split them off as one subtree
+// and join what is left, O(log^2 n) however many copies there are
+template <typename key_t, typename Compare, typename Allocator>
+size_t MultiSet<key_t, Compare, Allocator>::erase(const key_t &key)
+{
+    if (empty())
+        throw std::out_of_range("Invalid erase from empty container");
+
+    size_t first = lowerRank(key);
+    size_t copies = upperRank(key) - first;
+    if (copies == 0)
+        throw std::out_of_range("Erase query key not found");
+
+    TreeNode *below, *rest, *doomed, *above;
+    Links::splitRank(root, first, below, rest);
+    Links::splitRank(rest, copies, doomed, above);
+    deleteTree(doomed);
+    root = Links::join(below, above);
+    return copies;
+}
+
+template <typename key_t, typename Compare, typename Allocator>
+void MultiSet<key_t, Compare, Allocator>::eraseOne(const key_t &key)
+{
+    if (empty())
+        throw std::out_of_range("Invalid erase from empty container");
+    if (!contains(key))
+        throw std::out_of_range("Erase query key not found");
+
+    eraseAt(lowerRank(key));
+}
+
+/**
+ * Destructor
+ */
+
+template <typename key_t, typename Compare, typename Allocator>
+MultiSet<key_t, Compare, Allocator>::~MultiSet()
+{
+    deleteTree(root);
+}
+
+/**
+ * Inorder iterator
+ */
+
+template <typename key_t, typename Compare, typename Allocator>
+MultiSet<key_t, Compare, Allocator>::Iterator::Iterator() {}
+
+template <typename key_t, typename Compare, typename Allocator>
+MultiSet<key_t, Compare, Allocator>::Iterator::Iterator(const TreeNode *root)
+{
+    pushLeft(root);
+}
+
+template <typename key_t, typename Compare, typename Allocator>
+void MultiSet<key_t, Compare, Allocator>::Iterator::pushLeft(const TreeNode *node)
+{
+    for (; node != nullptr; node = node->left)
+        path.push_back(node);
+}
+
+template <typename key_t, typename Compare, typename Allocator>
+typename MultiSet<key_t, Compare, Allocator>::Iterator::reference MultiSet<key_t, Compare, Allocator>::Iterator::operator*() const
+{
+    if (path.empty())
+        throw std::out_of_range("Iterator out of bounds");
+    return path.back()->key;
+}
+
+template <typename key_t, typename Compare, typename Allocator>
+typename MultiSet<key_t, Compare, Allocator>::Iterator::pointer MultiSet<key_t, Compare, Allocator>::Iterator::operator->() const
+{
+    if (path.empty())
+        throw std::out_of_range("Iterator out of bounds");
+    return &path.back()->key;
+}
+
+template <typename key_t, typename Compare, typename Allocator>
+bool MultiSet<key_t, Compare, Allocator>::Iterator::operator==(const Iterator &that) const
+{
+    const TreeNode *node = path.empty() ? nullptr : path.back();
+    const TreeNode *thatNode = that.path.empty() ? nullptr : that.path.back();
+    return node == thatNode;
+}
+
+template <typename key_t, typename Compare, typename Allocator>
+bool MultiSet<key_t, Compare, Allocator>::Iterator::operator!=(const Iterator &that) const
+{
+    return !(*this == that);
+}
+
+template <typename key_t, typename Compare, typename Allocator>
+typename MultiSet<key_t, Compare, Allocator>::Iterator &MultiSet<key_t, Compare, Allocator>::Iterator::operator++()
+{
+    if (path.empty())
+        throw std::out_of_range("Iterator out of bounds");
+
+    const TreeNode *node = path.back();
+    path.pop_back();
+    pushLeft(node->right);
+    return *this;
+}
+
+template <typename key_t, typename Compare, typename Allocator>
+typename MultiSet<key_t, Compare, Allocator>::Iterator MultiSet<key_t, Compare, Allocator>::Iterator::operator++(int)
+{
+    Iterator prev = *this;
+    ++*this;
+    return prev;
+}
+
+template <typename key_t, typename Compare, typename Allocator>
+typename MultiSet<key_t, Compare, Allocator>::const_iterator MultiSet<key_t, Compare, Allocator>::begin() const
+{
+    return Iterator(root);
+}
+
+template <typename key_t, typename Compare, typename Allocator>
+typename MultiSet<key_t, Compare, Allocator>::const_iterator MultiSet<key_t, Compare, Allocator>::end() const
+{
+    return Iterator();
+}
+
+template <typename key_t, typename Compare, typename Allocator>
+typename MultiSet<key_t, Compare, Allocator>::const_iterator MultiSet<key_t, Compare, Allocator>::cbegin() const
+{
+    return begin();
+}
+
+template <typename key_t, typename Compare, typename Allocator>
+typename MultiSet<key_t, Compare, Allocator>::const_iterator MultiSet<key_t, Compare, Allocator>::cend() const
+{
+    return end();
+}
+
+// The path keeps the nodes where the descent went left: the keys
+// still to visit above the bound
+template <typename key_t, typename Compare, typename Allocator>
+typename MultiSet<key_t, Compare, Allocator>::const_iterator MultiSet<key_t, Compare, Allocator>::lower_bound(const key_t &key) const
+{
+    Iterator it;
+    const TreeNode *node = root;
+    while (node != nullptr)
+    {
+        if (less(node->key, key))
+            node = node->right;
+        else
+        {
+            it.path.push_back(node);
+            node = node->left;
+        }
+    }
+
+    return it;
+}
+
+template <typename key_t, typename Compare, typename Allocator>
+typename MultiSet<key_t, Compare, Allocator>::const_iterator MultiSet<key_t, Compare, Allocator>::upper_bound(const key_t &key) const
+{
+    Iterator it;
+    const TreeNode *node = root;
+    while (node != nullptr)
+    {
+        if (less(key, node->key))
+        {
+            it.path.push_back(node);
+            node = node->left;
+        }
+        else
+            node = node->right;
+    }
+
+    return it;
+}
+
+template <typename key_t, typename Compare, typename Allocator>
+std::pair<typename MultiSet<key_t, Compare, Allocator>::const_iterator, typename MultiSet<key_t, Compare, Allocator>::const_iterator> MultiSet<key_t, Compare, Allocator>::equal_range(const key_t &key) const
+{
+    return std::make_pair(lower_bound(key), upper_bound(key));
+}
+
+#endif /*RBMULTISET_I*/
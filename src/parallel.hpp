@@ -0,0 +1,323 @@
+/**parallel.hpp
+ *
+ * Execution support for the parallel bulk operations of Map and Set.
+ * WorkStealingPool runs fork-join recursions: every worker owns a deque
+ * of tasks, pushes and pops its own forks at the back and steals from
+ * the front of other deques when it runs dry. The thread that creates
+ * the pool takes part as worker 0. Idle workers spin, so a pool is
+ * meant to live for the duration of one bulk operation.
+ */
+
+#ifndef RBPARALLEL_H
+#define RBPARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Options of a parallel bulk operation; zero threads means one per core
+struct ParallelPolicy
+{
+    unsigned threads = 0;
+    size_t cutoff = 2048; // Subproblems smaller than this run sequentially
+};
+
+/**
+ * WorkStealingPool
+ */
+
+class WorkStealingPool
+{
+private:
+    struct Task
+    {
+        std::function<void()> run;
+        std::atomic<bool> done;
+        std::exception_ptr error;
+
+        Task() : done(false) {}
+    };
+
+    struct Worker
+    {
+        std::mutex lock;
+        std::deque<Task *> tasks;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+    std::atomic<bool> stopping;
+
+    // Registration of the current thread
+    WorkStealingPool *savedPool;
+    size_t savedIndex;
+
+    static WorkStealingPool *&currentPool()
+    {
+        static thread_local WorkStealingPool *pool = nullptr;
+        return pool;
+    }
+
+    static size_t &currentIndex()
+    {
+        static thread_local size_t index = 0;
+        return index;
+    }
+
+    static void execute(Task *task)
+    {
+        try
+        {
+            task->run();
+        }
+        catch (...)
+        {
+            task->error = std::current_exception();
+        }
+        task->done.store(true, std::memory_order_release);
+    }
+
+    Task *popLocal(size_t index)
+    {
+        Worker &self = *workers[index];
+        std::lock_guard<std::mutex> guard(self.lock);
+        if (self.tasks.empty())
+            return nullptr;
+
+        Task *task = self.tasks.back();
+        self.tasks.pop_back();
+        return task;
+    }
+
+    Task *steal(size_t index)
+    {
+        for (size_t i = 1; i < workers.size(); i++)
+        {
+            Worker &victim = *workers[(index + i) % workers.size()];
+            std::lock_guard<std::mutex> guard(victim.lock);
+            if (!victim.tasks.empty())
+            {
+                Task *task = victim.tasks.front();
+                victim.tasks.pop_front();
+                return task;
+            }
+        }
+
+        return nullptr;
+    }
+
+    bool runOne(size_t index)
+    {
+        Task *task = popLocal(index);
+        if (task == nullptr)
+            task = steal(index);
+        if (task == nullptr)
+            return false;
+
+        execute(task);
+        return true;
+    }
+
+    void workerLoop(size_t index)
+    {
+        currentPool() = this;
+        currentIndex() = index;
+        while (!stopping.load(std::memory_order_acquire))
+            if (!runOne(index))
+                std::this_thread::yield();
+    }
+
+public:
+    explicit WorkStealingPool(unsigned threadCount = 0)
+        : stopping(false), savedPool(currentPool()), savedIndex(currentIndex())
+    {
+        if (threadCount == 0)
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+        for (unsigned i = 0; i < threadCount; i++)
+            workers.emplace_back(new Worker());
+
+        currentPool() = this;
+        currentIndex() = 0;
+        for (unsigned i = 1; i < threadCount; i++)
+            threads.emplace_back(&WorkStealingPool::workerLoop, this, i);
+    }
+
+    WorkStealingPool(const WorkStealingPool &) = delete;
+    WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+    ~WorkStealingPool()
+    {
+        stopping.store(true, std::memory_order_release);
+        for (std::thread &thread : threads)
+            thread.join();
+
+        currentPool() = savedPool;
+        currentIndex() = savedIndex;
+    }
+
+    size_t size() const
+    {
+        return workers.size();
+    }
+
+    // Index of the calling worker, in [0, size())
+    size_t workerIndex() const
+    {
+        return currentPool() == this ? currentIndex() : 0;
+    }
+
+    /**
+     * Run first and second, possibly in parallel, and return once both
+     * have finished. second is offered to thieves while first runs on
+     * the calling thread; if nobody took it, it runs here too. While
+     * waiting for a thief, the caller executes other pending tasks.
+     */
+    template <typename F1, typename F2>
+    void forkJoin(F1 &&first, F2 &&second)
+    {
+        size_t index = workerIndex();
+        Worker &self = *workers[index];
+
+        Task task;
+        task.run = std::forward<F2>(second);
+        {
+            std::lock_guard<std::mutex> guard(self.lock);
+            self.tasks.push_back(&task);
+        }
+
+        // task lives on this stack frame, so it must finish before unwinding
+        std::exception_ptr error;
+        try
+        {
+            first();
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+
+        bool reclaimed = false;
+        {
+            std::lock_guard<std::mutex> guard(self.lock);
+            if (!self.tasks.empty() && self.tasks.back() == &task)
+            {
+                self.tasks.pop_back();
+                reclaimed = true;
+            }
+        }
+
+        if (reclaimed)
+            execute(&task);
+        else
+            while (!task.done.load(std::memory_order_acquire))
+                if (!runOne(index))
+                    std::this_thread::yield();
+
+        if (error)
+            std::rethrow_exception(error);
+        if (task.error)
+            std::rethrow_exception(task.error);
+    }
+};
+
+// Stable merge sort that forks on halves larger than cutoff
+template <typename RandomIt, typename Less>
+void parallelSort(WorkStealingPool &pool, RandomIt first, RandomIt last, Less less, size_t cutoff)
+{
+    if (static_cast<size_t>(last - first) <= std::max<size_t>(cutoff, 1))
+    {
+        std::stable_sort(first, last, less);
+        return;
+    }
+
+    RandomIt middle = first + (last - first) / 2;
+    pool.forkJoin([&]
+                  { parallelSort(pool, first, middle, less, cutoff); },
+                  [&]
+                  { parallelSort(pool, middle, last, less, cutoff); });
+    std::inplace_merge(first, middle, last, less);
+}
+
+/**
+ * BulkRun
+ *
+ * State of one parallel bulk operation on a tree. Tree allocators need
+ * not be thread-safe, so workers never free nodes: detached subtrees are
+ * collected per worker and handed back to the caller by release().
+ */
+
+template <typename Node>
+class BulkRun
+{
+private:
+    WorkStealingPool pool;
+    size_t cutoff;
+    std::vector<std::vector<Node *>> discarded;
+
+public:
+    explicit BulkRun(const ParallelPolicy &policy)
+        : pool(policy.threads), cutoff(policy.cutoff), discarded(pool.size()) {}
+
+    WorkStealingPool &executor()
+    {
+        return pool;
+    }
+
+    size_t grain() const
+    {
+        return cutoff;
+    }
+
+    // Fork only when the subproblem is large enough to pay for a task
+    template <typename F1, typename F2>
+    void fork(size_t work, F1 &&first, F2 &&second)
+    {
+        if (work >= cutoff && pool.size() > 1)
+            pool.forkJoin(std::forward<F1>(first), std::forward<F2>(second));
+        else
+        {
+            first();
+            second();
+        }
+    }
+
+    void discard(Node *subtree)
+    {
+        discarded[pool.workerIndex()].push_back(subtree);
+    }
+
+    // Single-threaded: pass every discarded subtree to destroy
+    template <typename F>
+    void release(F &&destroy)
+    {
+        for (std::vector<Node *> &nodes : discarded)
+        {
+            for (Node *node : nodes)
+                destroy(node);
+            nodes.clear();
+        }
+    }
+};
+
+// Sequential when run is nullptr
+template <typename Node, typename F1, typename F2>
+void forkJoin(BulkRun<Node> *run, size_t work, F1 &&first, F2 &&second)
+{
+    if (run != nullptr)
+        run->fork(work, std::forward<F1>(first), std::forward<F2>(second));
+    else
+    {
+        first();
+        second();
+    }
+}
+
+#endif /*RBPARALLEL_H*/
@@ -0,0 +1,207 @@
+/**persistent_map.hpp
+ *
+ * Interface for a persistent left-leaning red black tree ordered
+ * symbol table. Copies share all of their nodes and take O(1) time.
+ * Nodes are reference counted; insert and erase copy only the nodes
+ * on their path that are shared with another version, and update
+ * nodes owned by a single version in place. The counts are atomic, so
+ * versions sharing nodes may be copied, written and destroyed on
+ * different threads, given an allocator that is itself thread-safe.
+ */
+
+#ifndef RBPERSISTENTMAP_H
+#define RBPERSISTENTMAP_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "compare.hpp"
+#include "pool.hpp"
+
+template <typename key_t, typename value_t, typename Compare = std::less<key_t>,
+          typename Allocator = PoolAllocator<std::pair<key_t, value_t>>>
+class PersistentMap
+{
+private:
+    using ComparisonResult = std::int8_t;
+    constexpr static ComparisonResult LESS_THAN = -1;
+    constexpr static ComparisonResult EQUAL_TO = 0;
+    constexpr static ComparisonResult GREATER_THAN = 1;
+
+    /**
+     * TreeNode
+     */
+
+    class TreeNode
+    {
+    public:
+        const static bool RED = true;
+        const static bool BLACK = false;
+
+        std::pair<key_t, value_t> p;
+        TreeNode *left;
+        TreeNode *right;
+        size_t sz;
+        std::atomic<size_t> refs; // Links to this node from parents and versions
+        bool color;
+
+        template <typename... Args>
+        TreeNode(bool c, Args &&...args)
+            : p(std::forward<Args>(args)...), left(nullptr), right(nullptr), sz(1), refs(1), color(c) {}
+    };
+
+    using NodeAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<TreeNode>;
+    using NodeAllocTraits = std::allocator_traits<NodeAllocator>;
+
+    // Tree attributes
+    TreeNode *root;
+    Compare comparator;
+    NodeAllocator alloc;
+    bool rebalancing; // Set once the current write has broken a tree invariant
+
+    // Node allocation and reference counting
+    template <typename... Args>
+    TreeNode *createNode(bool color, Args &&...args);
+    void destroyNode(TreeNode *node);
+    void releaseTree(TreeNode *node);
+
+    // Utilities
+    ComparisonResult comp(const key_t &k1, const key_t &k2) const;
+    static size_t nodeSize(const TreeNode *node);
+    static bool isRed(const TreeNode *node);
+    bool treeEqual(const TreeNode *node1, const TreeNode *node2) const;
+
+    // Copy-on-write: make link point to a node of this version only
+    void ownLink(TreeNode *&link);
+
+    // Tree rotation & coloring; links are updated in place so that
+    // reference counts stay exact if a copy throws halfway through
+    void rotateLeft(TreeNode *&link);
+    void rotateRight(TreeNode *&link);
+    void flipColors(TreeNode *node);
+    void rbFix(TreeNode *&link);
+    void moveRedLeft(TreeNode *&link);
+    void moveRedRight(TreeNode *&link);
+
+    // Recursive writers on owned links
+    template <typename F>
+    void write(F &&mutate);
+    template <typename P>
+    void _insert(TreeNode *&link, P &&pair);
+    void _eraseMin(TreeNode *&link);
+    void _erase(TreeNode *&link, const key_t &key);
+
+    // Search helpers
+    const TreeNode *_at(const TreeNode *node, const key_t &key) const;
+    int _rank(const TreeNode *node, const key_t &key) const;
+    const TreeNode *_floor(const TreeNode *node, const key_t &key) const;
+    const TreeNode *_ceiling(const TreeNode *node, const key_t &key) const;
+
+public:
+    class Iterator;
+    using iterator = Iterator;
+    using const_iterator = Iterator;
+
+    /**
+     * Constructors
+     */
+
+    PersistentMap();
+    PersistentMap(const std::initializer_list<std::pair<key_t, value_t>> &init);
+    explicit PersistentMap(const Allocator &allocator);
+    PersistentMap(const PersistentMap &that); // O(1): shares every node
+    PersistentMap(PersistentMap &&that);
+
+    /**
+     * Utilities
+     */
+
+    size_t size() const;
+    bool empty() const;
+
+    PersistentMap &operator=(const PersistentMap &that); // O(1)
+    PersistentMap &operator=(PersistentMap &&that);
+    bool operator==(const PersistentMap &that) const; // Shared subtrees compare in O(1)
+    bool operator!=(const PersistentMap &that) const;
+    void swap(PersistentMap &that);
+
+    /**
+     * Search
+     */
+
+    value_t at(const key_t &key) const;
+    bool contains(const key_t &key) const;
+
+    /**
+     * Ordered symbol table operations
+     */
+
+    int rank(const key_t &key) const;
+    key_t min() const;
+    key_t max() const;
+    key_t floor(const key_t &key) const;
+    key_t ceiling(const key_t &key) const;
+    key_t rankSelect(int rank) const;
+
+    /**
+     * Insertion & deletion: copy the shared part of one path
+     */
+
+    void insert(const std::pair<key_t, value_t> &pair);
+    void insert(std::pair<key_t, value_t> &&pair);
+    void erase(const key_t &key);
+
+    /**
+     * Destructor
+     */
+
+    ~PersistentMap();
+
+    /**
+     * Inorder iterator
+     */
+
+    class Iterator
+    {
+    private:
+        friend class PersistentMap;
+
+        std::vector<const TreeNode *> path; // Nodes still to visit; back() is current
+
+        explicit Iterator(const TreeNode *root);
+        void pushLeft(const TreeNode *node);
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::pair<key_t, value_t>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const value_type *;
+        using reference = const value_type &;
+
+        Iterator();
+
+        reference operator*() const;
+        pointer operator->() const;
+        bool operator==(const Iterator &that) const;
+        bool operator!=(const Iterator &that) const;
+
+        Iterator &operator++();
+        Iterator operator++(int);
+    };
+
+    const_iterator begin() const;
+    const_iterator end() const;
+    const_iterator cbegin() const;
+    const_iterator cend() const;
+};
+
+#include "persistent_map.ipp"
+
+#endif /*RBPERSISTENTMAP_H*/
@@ -0,0 +1,757 @@
+/**persistent_map.ipp
+ *
+ * Implementation for the persistent left-leaning red black tree
+ * ordered symbol table.
+ *
+ * refs counts the links to a node: parent links and version roots. A
+ * node with a single link belongs to one version and is changed in
+ * place. A copy is stored into its link before anything else changes,
+ * so counts stay exact even when a copy throws; other versions are
+ * never written to.
+ *
+ * A new link is only made from one that is already held, so counts go
+ * up relaxed. The drop that frees a node is acq_rel, so the freeing
+ * thread sees every earlier access through the other links. A count of
+ * 1, loaded with acquire, cannot change while the only link is ours.
+ */
+
+#ifndef RBPERSISTENTMAP_I
+#define RBPERSISTENTMAP_I
+
+#include <stdexcept>
+#include <utility>
+
+#include "persistent_map.hpp"
+
+// Node allocation and reference counting
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+template <typename... Args>
+typename PersistentMap<key_t, value_t, Compare, Allocator>::TreeNode *PersistentMap<key_t, value_t, Compare, Allocator>::createNode(bool color, Args &&...args)
+{
+    TreeNode *node = NodeAllocTraits::allocate(alloc, 1);
+    try
+    {
+        NodeAllocTraits::construct(alloc, node, color, std::forward<Args>(args)...);
+    }
+    catch (...)
+    {
+        NodeAllocTraits::deallocate(alloc, node, 1);
+        throw;
+    }
+
+    return node;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+void PersistentMap<key_t, value_t, Compare, Allocator>::destroyNode(TreeNode *node)
+{
+    NodeAllocTraits::destroy(alloc, node);
+    NodeAllocTraits::deallocate(alloc, node, 1);
+}
+
+// Drop one link to node; subtrees still linked from other versions survive
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+void PersistentMap<key_t, value_t, Compare, Allocator>::releaseTree(TreeNode *node)
+{
+    if (node == nullptr || node->refs.fetch_sub(1, std::memory_order_acq_rel) > 1)
+        return;
+
+    releaseTree(node->left);
+    releaseTree(node->right);
+    destroyNode(node);
+}
+
+/**
+ * Utilities
+ */
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+typename PersistentMap<key_t, value_t, Compare, Allocator>::ComparisonResult PersistentMap<key_t, value_t, Compare, Allocator>::comp(const key_t &k1, const key_t &k2) const
+{
+    return static_cast<ComparisonResult>(keyCompare(comparator, k1, k2, HasThreeWayCompare<Compare, key_t, key_t>()));
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+size_t PersistentMap<key_t, value_t, Compare, Allocator>::nodeSize(const TreeNode *node)
+{
+    return node == nullptr ? 0 : node->sz;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+bool PersistentMap<key_t, value_t, Compare, Allocator>::isRed(const TreeNode *node)
+{
+    if (node == nullptr)
+        return TreeNode::BLACK;
+    else
+        return node->color;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+bool PersistentMap<key_t, value_t, Compare, Allocator>::treeEqual(const TreeNode *node1, const TreeNode *node2) const
+{
+    if (node1 == node2)
+        return true;
+    else if (node1 == nullptr)
+        return false;
+    else if (node2 == nullptr)
+        return false;
+
+    bool nodeEquality = node1->p == node2->p && node1->sz == node2->sz && node1->color == node2->color;
+    return nodeEquality && treeEqual(node1->left, node2->left) && treeEqual(node1->right, node2->right);
+}
+
+/**
+ * Copy-on-write
+ */
+
+// link must hang from an owned node or be the root of this version
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+void PersistentMap<key_t, value_t, Compare, Allocator>::ownLink(TreeNode *&link)
+{
+    if (link->refs.load(std::memory_order_acquire) == 1)
+        return;
+
+    TreeNode *copy = createNode(link->color, link->p);
+    copy->left = link->left;
+    copy->right = link->right;
+    copy->sz = link->sz;
+    if (copy->left != nullptr)
+        copy->left->refs.fetch_add(1, std::memory_order_relaxed);
+    if (copy->right != nullptr)
+        copy->right->refs.fetch_add(1, std::memory_order_relaxed);
+
+    // Another version may have dropped its link meanwhile
+    TreeNode *shared = link;
+    link = copy;
+    releaseTree(shared);
+}
+
+/**
+ * Red-black scheme helpers
+ */
+
+// Every step goes through ownLink(), which copies nodes with more than one reference
+
+// Rotations move links without adding or removing any
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+void PersistentMap<key_t, value_t, Compare, Allocator>::rotateLeft(TreeNode *&link)
+{
+    ownLink(link->right);
+    rebalancing = true;
+    TreeNode *node = link;
+    TreeNode *newNode = node->right;
+    node->right = newNode->left;
+    newNode->left = node;
+    link = newNode;
+
+    // Enforce color
+    newNode->color = node->color;
+    node->color = TreeNode::RED;
+
+    // Size update
+    newNode->sz = node->sz;
+    node->sz = 1 + nodeSize(node->left) + nodeSize(node->right);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+void PersistentMap<key_t, value_t, Compare, Allocator>::rotateRight(TreeNode *&link)
+{
+    ownLink(link->left);
+    rebalancing = true;
+    TreeNode *node = link;
+    TreeNode *newNode = node->left;
+    node->left = newNode->right;
+    newNode->right = node;
+    link = newNode;
+
+    // Enforce color
+    newNode->color = node->color;
+    node->color = TreeNode::RED;
+
+    // Size update
+    newNode->sz = node->sz;
+    node->sz = 1 + nodeSize(node->left) + nodeSize(node->right);
+}
+
+// node must be owned; its children are owned before they change color
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+void PersistentMap<key_t, value_t, Compare, Allocator>::flipColors(TreeNode *node)
+{
+    ownLink(node->left);
+    ownLink(node->right);
+    rebalancing = true;
+
+    node->color = !node->color;
+    node->left->color = !node->left->color;
+    node->right->color = !node->right->color;
+}
+
+// Fixup on the way back up, link must be owned
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+void PersistentMap<key_t, value_t, Compare, Allocator>::rbFix(TreeNode *&link)
+{
+    if (isRed(link->right) && !isRed(link->left))
+        rotateLeft(link);
+    if (isRed(link->left) && isRed(link->left->left))
+        rotateRight(link);
+    if (isRed(link->left) && isRed(link->right))
+        flipColors(link);
+
+    link->sz = 1 + nodeSize(link->left) + nodeSize(link->right);
+}
+
+// Deletion 2-node fixups, link must be owned
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+void PersistentMap<key_t, value_t, Compare, Allocator>::moveRedLeft(TreeNode *&link)
+{
+    flipColors(link);
+    if (isRed(link->right->left))
+    {
+        rotateRight(link->right);
+        rotateLeft(link);
+        flipColors(link);
+    }
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+void PersistentMap<key_t, value_t, Compare, Allocator>::moveRedRight(TreeNode *&link)
+{
+    flipColors(link);
+    if (isRed(link->left->left))
+    {
+        rotateRight(link);
+        flipColors(link);
+    }
+}
+
+/**
+ * Recursive writers
+ */
+
+// A write that throws before it restructures anything leaves this version
+// unchanged; one that throws later may leave it unbalanced, so it is cleared
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+template <typename F>
+void PersistentMap<key_t, value_t, Compare, Allocator>::write(F &&mutate)
+{
+    rebalancing = false;
+    try
+    {
+        mutate();
+    }
+    catch (...)
+    {
+        if (rebalancing)
+        {
+            releaseTree(root);
+            root = nullptr;
+        }
+        throw;
+    }
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+template <typename P>
+void PersistentMap<key_t, value_t, Compare, Allocator>::_insert(TreeNode *&link, P &&pair)
+{
+    if (link == nullptr)
+    {
+        link = createNode(TreeNode::RED, std::forward<P>(pair));
+        rebalancing = true;
+        return;
+    }
+
+    ownLink(link);
+    ComparisonResult cmp = comp(pair.first, link->p.first);
+    if (cmp == LESS_THAN)
+        _insert(link->left, std::forward<P>(pair));
+    else if (cmp == GREATER_THAN)
+        _insert(link->right, std::forward<P>(pair));
+    else
+        link->p.second = std::forward<P>(pair).second;
+
+    rbFix(link);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+void PersistentMap<key_t, value_t, Compare, Allocator>::_eraseMin(TreeNode *&link)
+{
+    if (link->left == nullptr)
+    {
+        rebalancing = true;
+        releaseTree(link);
+        link = nullptr;
+        return;
+    }
+
+    // Fix 2-node if necessary
+    ownLink(link);
+    if (!isRed(link->left) && !isRed(link->left->left))
+        moveRedLeft(link);
+
+    _eraseMin(link->left);
+    rbFix(link);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+void PersistentMap<key_t, value_t, Compare, Allocator>::_erase(TreeNode *&link, const key_t &key)
+{
+    ownLink(link);
+    if (comp(key, link->p.first) == LESS_THAN)
+    {
+        // Push red link left if 2-node
+        if (!isRed(link->left) && !isRed(link->left->left))
+            moveRedLeft(link);
+
+        _erase(link->left, key);
+    }
+    else
+    {
+        if (isRed(link->left))
+            rotateRight(link);
+
+        // Simple case: leaf node deletion
+        if (comp(key, link->p.first) == EQUAL_TO && link->right == nullptr)
+        {
+            rebalancing = true;
+            releaseTree(link);
+            link = nullptr;
+            return;
+        }
+
+        // Push red link right if two black nodes
+        if (!isRed(link->right) && !isRed(link->right->left))
+            moveRedRight(link);
+
+        // Complex case: take over the payload of the successor
+        if (comp(key, link->p.first) == EQUAL_TO)
+        {
+            const TreeNode *successor = link->right;
+            while (successor->left != nullptr)
+                successor = successor->left;
+
+            rebalancing = true;
+            link->p = successor->p;
+            _eraseMin(link->right);
+        }
+        else
+            _erase(link->right, key);
+    }
+
+    rbFix(link);
+}
+
+/**
+ * Search helpers
+ */
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+const typename PersistentMap<key_t, value_t, Compare, Allocator>::TreeNode *PersistentMap<key_t, value_t, Compare, Allocator>::_at(const TreeNode *node, const key_t &key) const
+{
+    while (node != nullptr)
+    {
+        ComparisonResult cmp = comp(key, node->p.first);
+        if (cmp == EQUAL_TO)
+            return node;
+        node = cmp == LESS_THAN ? node->left : node->right;
+    }
+
+    return nullptr;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+int PersistentMap<key_t, value_t, Compare, Allocator>::_rank(const TreeNode *node, const key_t &key) const
+{
+    int rank = 0;
+    while (node != nullptr)
+    {
+        if (comp(node->p.first, key) == LESS_THAN)
+        {
+            rank += nodeSize(node->left) + 1;
+            node = node->right;
+        }
+        else
+            node = node->left;
+    }
+
+    return rank;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+const typename PersistentMap<key_t, value_t, Compare, Allocator>::TreeNode *PersistentMap<key_t, value_t, Compare, Allocator>::_floor(const TreeNode *node, const key_t &key) const
+{
+    const TreeNode *candidate = nullptr;
+    while (node != nullptr)
+    {
+        if (comp(key, node->p.first) == LESS_THAN)
+            node = node->left;
+        else
+        {
+            candidate = node;
+            node = node->right;
+        }
+    }
+
+    return candidate;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+const typename PersistentMap<key_t, value_t, Compare, Allocator>::TreeNode *PersistentMap<key_t, value_t, Compare, Allocator>::_ceiling(const TreeNode *node, const key_t &key) const
+{
+    const TreeNode *candidate = nullptr;
+    while (node != nullptr)
+    {
+        if (comp(node->p.first, key) == LESS_THAN)
+            node = node->right;
+        else
+        {
+            candidate = node;
+            node = node->left;
+        }
+    }
+
+    return candidate;
+}
+
+/**
+ * Constructors
+ */
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+PersistentMap<key_t, value_t, Compare, Allocator>::PersistentMap()
+    : root(nullptr), alloc(), rebalancing(false) {}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+PersistentMap<key_t, value_t, Compare, Allocator>::PersistentMap(const std::initializer_list<std::pair<key_t, value_t>> &init)
+    : PersistentMap()
+{
+    for (const std::pair<key_t, value_t> &pair : init)
+        insert(pair);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+PersistentMap<key_t, value_t, Compare, Allocator>::PersistentMap(const Allocator &allocator)
+    : root(nullptr), alloc(allocator), rebalancing(false) {}
+
+// Versions keep the allocator of the nodes they share
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+PersistentMap<key_t, value_t, Compare, Allocator>::PersistentMap(const PersistentMap &that)
+    : root(that.root), comparator(that.comparator), alloc(that.alloc), rebalancing(false)
+{
+    if (root != nullptr)
+        root->refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+PersistentMap<key_t, value_t, Compare, Allocator>::PersistentMap(PersistentMap &&that)
+    : root(that.root), comparator(std::move(that.comparator)), alloc(that.alloc), rebalancing(false)
+{
+    that.root = nullptr;
+}
+
+/**
+ * Utilities
+ */
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+size_t PersistentMap<key_t, value_t, Compare, Allocator>::size() const
+{
+    return nodeSize(root);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+bool PersistentMap<key_t, value_t, Compare, Allocator>::empty() const
+{
+    return root == nullptr;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+PersistentMap<key_t, value_t, Compare, Allocator> &PersistentMap<key_t, value_t, Compare, Allocator>::operator=(const PersistentMap &that)
+{
+    // Copy and swap; the old nodes are released with their own allocator
+    PersistentMap temp(that);
+    swap(temp);
+    return *this;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+PersistentMap<key_t, value_t, Compare, Allocator> &PersistentMap<key_t, value_t, Compare, Allocator>::operator=(PersistentMap &&that)
+{
+    PersistentMap temp(std::move(that));
+    swap(temp);
+    return *this;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+bool PersistentMap<key_t, value_t, Compare, Allocator>::operator==(const PersistentMap &that) const
+{
+    return treeEqual(this->root, that.root);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+bool PersistentMap<key_t, value_t, Compare, Allocator>::operator!=(const PersistentMap &that) const
+{
+    return !treeEqual(this->root, that.root);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+void PersistentMap<key_t, value_t, Compare, Allocator>::swap(PersistentMap &that)
+{
+    using std::swap;
+    swap(root, that.root);
+    swap(comparator, that.comparator);
+    swap(alloc, that.alloc);
+}
+
+/**
+ * Search
+ */
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+value_t PersistentMap<key_t, value_t, Compare, Allocator>::at(const key_t &key) const
+{
+    if (empty())
+        throw std::out_of_range("Invalid search in empty container");
+
+    const TreeNode *queryNode = _at(root, key);
+    if (queryNode == nullptr)
+        throw std::out_of_range("Query key not found");
+    return queryNode->p.second;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+bool PersistentMap<key_t, value_t, Compare, Allocator>::contains(const key_t &key) const
+{
+    return _at(root, key) != nullptr;
+}
+
+/**
+ * Ordered symbol table operations
+ */
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+int PersistentMap<key_t, value_t, Compare, Allocator>::rank(const key_t &key) const
+{
+    return _rank(root, key);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+key_t PersistentMap<key_t, value_t, Compare, Allocator>::min() const
+{
+    if (empty())
+        throw std::out_of_range("Invalid call to min() with empty container");
+
+    const TreeNode *node = root;
+    while (node->left != nullptr)
+        node = node->left;
+    return node->p.first;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+key_t PersistentMap<key_t, value_t, Compare, Allocator>::max() const
+{
+    if (empty())
+        throw std::out_of_range("Invalid call to max() with empty container");
+
+    const TreeNode *node = root;
+    while (node->right != nullptr)
+        node = node->right;
+    return node->p.first;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+key_t PersistentMap<key_t, value_t, Compare, Allocator>::floor(const key_t &key) const
+{
+    if (empty())
+        throw std::out_of_range("Invalid call to floor() with empty container");
+
+    const TreeNode *queryNode = _floor(root, key);
+    if (queryNode == nullptr)
+        throw std::out_of_range("Argument to floor() is too small");
+    return queryNode->p.first;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+key_t PersistentMap<key_t, value_t, Compare, Allocator>::ceiling(const key_t &key) const
+{
+    if (empty())
+        throw std::out_of_range("Invalid call to ceiling() with empty container");
+
+    const TreeNode *queryNode = _ceiling(root, key);
+    if (queryNode == nullptr)
+        throw std::out_of_range("Argument to ceiling() is too large");
+    return queryNode->p.first;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+key_t PersistentMap<key_t, value_t, Compare, Allocator>::rankSelect(int rank) const
+{
+    if (empty())
+        throw std::out_of_range("Invalid call to rankSelect() with empty container");
+    if (rank < 0 || static_cast<size_t>(rank) >= size())
+        throw std::out_of_range("Argument to rankSelect() is invalid");
+
+    const TreeNode *node = root;
+    size_t remaining = rank;
+    while (true)
+    {
+        size_t leftSize = nodeSize(node->left);
+        if (remaining < leftSize)
+            node = node->left;
+        else if (remaining > leftSize)
+        {
+            remaining -= leftSize + 1;
+            node = node->right;
+        }
+        else
+            return node->p.first;
+    }
+}
+
+/**
+ * Insertion & deletion
+ */
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+void PersistentMap<key_t, value_t, Compare, Allocator>::insert(const std::pair<key_t, value_t> &pair)
+{
+    write([&]
+          { _insert(root, pair); });
+    root->color = TreeNode::BLACK;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+void PersistentMap<key_t, value_t, Compare, Allocator>::insert(std::pair<key_t, value_t> &&pair)
+{
+    write([&]
+          { _insert(root, std::move(pair)); });
+    root->color = TreeNode::BLACK;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+void PersistentMap<key_t, value_t, Compare, Allocator>::erase(const key_t &key)
+{
+    if (empty())
+        throw std::out_of_range("Invalid erase from empty container");
+    if (_at(root, key) == nullptr)
+        throw std::out_of_range("Erase query key not found");
+
+    write([&]
+          {
+              if (!isRed(root->left) && !isRed(root->right))
+              {
+                  ownLink(root);
+                  rebalancing = true;
+                  root->color = TreeNode::RED;
+              }
+
+              _erase(root, key); });
+    if (root != nullptr)
+        root->color = TreeNode::BLACK;
+}
+
+/**
+ * Destructor
+ */
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+PersistentMap<key_t, value_t, Compare, Allocator>::~PersistentMap()
+{
+    releaseTree(root);
+}
+
+/**
+ * Inorder iterator
+ */
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+PersistentMap<key_t, value_t, Compare, Allocator>::Iterator::Iterator() {}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+PersistentMap<key_t, value_t, Compare, Allocator>::Iterator::Iterator(const TreeNode *root)
+{
+    pushLeft(root);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+void PersistentMap<key_t, value_t, Compare, Allocator>::Iterator::pushLeft(const TreeNode *node)
+{
+    for (; node != nullptr; node = node->left)
+        path.push_back(node);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+typename PersistentMap<key_t, value_t, Compare, Allocator>::Iterator::reference PersistentMap<key_t, value_t, Compare, Allocator>::Iterator::operator*() const
+{
+    if (path.empty())
+        throw std::out_of_range("Iterator out of bounds");
+    return path.back()->p;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+typename PersistentMap<key_t, value_t, Compare, Allocator>::Iterator::pointer PersistentMap<key_t, value_t, Compare, Allocator>::Iterator::operator->() const
+{
+    if (path.empty())
+        throw std::out_of_range("Iterator out of bounds");
+    return &path.back()->p;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+bool PersistentMap<key_t, value_t, Compare, Allocator>::Iterator::operator==(const Iterator &that) const
+{
+    const TreeNode *node = path.empty() ? nullptr : path.back();
+    const TreeNode *thatNode = that.path.empty() ? nullptr : that.path.back();
+    return node == thatNode;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+bool PersistentMap<key_t, value_t, Compare, Allocator>::Iterator::operator!=(const Iterator &that) const
+{
+    return !(*this == that);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+typename PersistentMap<key_t, value_t, Compare, Allocator>::Iterator &PersistentMap<key_t, value_t, Compare, Allocator>::Iterator::operator++()
+{
+    if (path.empty())
+        throw std::out_of_range("Iterator out of bounds");
+
+    const TreeNode *node = path.back();
+    path.pop_back();
+    pushLeft(node->right);
+    return *this;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+typename PersistentMap<key_t, value_t, Compare, Allocator>::Iterator PersistentMap<key_t, value_t, Compare, Allocator>::Iterator::operator++(int)
+{
+    Iterator prev = *this;
+    ++*this;
+    return prev;
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+typename PersistentMap<key_t, value_t, Compare, Allocator>::const_iterator PersistentMap<key_t, value_t, Compare, Allocator>::begin() const
+{
+    return Iterator(root);
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+typename PersistentMap<key_t, value_t, Compare, Allocator>::const_iterator PersistentMap<key_t, value_t, Compare, Allocator>::end() const
+{
+    return Iterator();
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+typename PersistentMap<key_t, value_t, Compare, Allocator>::const_iterator PersistentMap<key_t, value_t, Compare, Allocator>::cbegin() const
+{
+    return begin();
+}
+
+template <typename key_t, typename value_t, typename Compare, typename Allocator>
+typename PersistentMap<key_t, value_t, Compare, Allocator>::const_iterator PersistentMap<key_t, value_t, Compare, Allocator>::cend() const
+{
+    return end();
+}
+
+#endif /*RBPERSISTENTMAP_I*/
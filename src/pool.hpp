@@ -0,0 +1,300 @@
+/**pool.hpp
+ *
+ * Slab allocator for tree nodes. Nodes are carved out of contiguous
+ * chunks and recycled through an intrusive free list, so inserting
+ * and erasing keys does not round-trip through the global heap.
+ *
+ * PoolAllocator satisfies the standard Allocator requirements and is
+ * the default allocator of Map and Set. Copies of an allocator share
+ * the same pool; containers that are copy-constructed receive a fresh
+ * pool of their own. The pool is created on first use, so empty
+ * containers never touch the heap. The pool is not thread-safe.
+ */
+
+#ifndef RBPOOL_H
+#define RBPOOL_H
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/**
+ * SlabPool
+ *
+ * Fixed-size block allocator. Chunks grow geometrically up to
+ * MAX_CHUNK_BLOCKS blocks and are only returned to the system when
+ * the pool itself is destroyed.
+ */
+
+class SlabPool
+{
+private:
+    constexpr static size_t MIN_CHUNK_BLOCKS = 64;
+    constexpr static size_t MAX_CHUNK_BLOCKS = 1 << 16;
+
+    struct FreeBlock
+    {
+        FreeBlock *next;
+    };
+
+    struct Chunk
+    {
+        Chunk *next;
+    };
+
+    size_t blockSize;
+    size_t blockAlign;
+    size_t headerSize;
+    size_t nextChunkBlocks;
+
+    Chunk *chunks;
+    FreeBlock *freeList;
+
+    // Bump region inside the most recent chunk
+    char *bumpCur;
+    char *bumpEnd;
+
+    void grow()
+    {
+        size_t bytes = headerSize + blockSize * nextChunkBlocks;
+        Chunk *chunk = static_cast<Chunk *>(::operator new(bytes));
+        chunk->next = chunks;
+        chunks = chunk;
+
+        bumpCur = reinterpret_cast<char *>(chunk) + headerSize;
+        bumpEnd = bumpCur + blockSize * nextChunkBlocks;
+
+        if (nextChunkBlocks < MAX_CHUNK_BLOCKS)
+            nextChunkBlocks <<= 1;
+    }
+
+public:
+    // Blocks must hold a free list link and keep every block aligned
+    static size_t roundedSize(size_t size, size_t align)
+    {
+        size_t minSize = size < sizeof(FreeBlock) ? sizeof(FreeBlock) : size;
+        return (minSize + align - 1) / align * align;
+    }
+
+    SlabPool(size_t size, size_t align)
+        : blockSize(roundedSize(size, align)), blockAlign(align),
+          headerSize(roundedSize(sizeof(Chunk), align)), nextChunkBlocks(MIN_CHUNK_BLOCKS),
+          chunks(nullptr), freeList(nullptr), bumpCur(nullptr), bumpEnd(nullptr) {}
+
+    SlabPool(const SlabPool &) = delete;
+    SlabPool &operator=(const SlabPool &) = delete;
+
+    ~SlabPool()
+    {
+        while (chunks != nullptr)
+        {
+            Chunk *next = chunks->next;
+            ::operator delete(chunks);
+            chunks = next;
+        }
+    }
+
+    bool serves(size_t size, size_t align) const
+    {
+        return align == blockAlign && roundedSize(size, align) == blockSize;
+    }
+
+    void *allocate()
+    {
+        if (freeList != nullptr)
+        {
+            FreeBlock *block = freeList;
+            freeList = block->next;
+            return block;
+        }
+
+        if (bumpCur == bumpEnd)
+            grow();
+
+        void *block = bumpCur;
+        bumpCur += blockSize;
+        return block;
+    }
+
+    void deallocate(void *ptr)
+    {
+        FreeBlock *block = static_cast<FreeBlock *>(ptr);
+        block->next = freeList;
+        freeList = block;
+    }
+};
+
+/**
+ * PoolResource
+ *
+ * Set of slab pools shared by all copies and rebinds of one
+ * PoolAllocator. Containers only ever request a single node type,
+ * so the lookup is a scan over a handful of size classes.
+ */
+
+class PoolResource
+{
+private:
+    constexpr static size_t MAX_SIZE_CLASSES = 4;
+
+    alignas(SlabPool) unsigned char storage[MAX_SIZE_CLASSES][sizeof(SlabPool)];
+    size_t poolCount;
+
+    SlabPool *poolAt(size_t i)
+    {
+        return reinterpret_cast<SlabPool *>(storage[i]);
+    }
+
+public:
+    PoolResource() : poolCount(0) {}
+
+    PoolResource(const PoolResource &) = delete;
+    PoolResource &operator=(const PoolResource &) = delete;
+
+    ~PoolResource()
+    {
+        for (size_t i = 0; i < poolCount; i++)
+            poolAt(i)->~SlabPool();
+    }
+
+    // Returns nullptr if no more size classes can be created
+    SlabPool *find(size_t size, size_t align)
+    {
+        for (size_t i = 0; i < poolCount; i++)
+            if (poolAt(i)->serves(size, align))
+                return poolAt(i);
+
+        if (poolCount == MAX_SIZE_CLASSES)
+            return nullptr;
+
+        return new (storage[poolCount++]) SlabPool(size, align);
+    }
+};
+
+/**
+ * PoolAllocator
+ */
+
+template <typename T>
+class PoolAllocator
+{
+private:
+    template <typename U>
+    friend class PoolAllocator;
+
+    // Created on first use; copying forces creation so that copies share it
+    mutable std::shared_ptr<PoolResource> resource;
+    SlabPool *pool;
+
+    const std::shared_ptr<PoolResource> &sharedResource() const
+    {
+        if (resource == nullptr)
+            resource = std::make_shared<PoolResource>();
+        return resource;
+    }
+
+    SlabPool *nodePool()
+    {
+        if (pool == nullptr)
+            pool = sharedResource()->find(sizeof(T), alignof(T));
+        return pool;
+    }
+
+    // Without a pool an allocator has never been copied, so it only equals itself
+    template <typename U>
+    bool samePool(const PoolAllocator<U> &that) const
+    {
+        if (resource == nullptr || that.resource == nullptr)
+            return static_cast<const void *>(this) == static_cast<const void *>(&that);
+        return resource == that.resource;
+    }
+
+public:
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::false_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+    using is_always_equal = std::false_type;
+
+    template <typename U>
+    struct rebind
+    {
+        using other = PoolAllocator<U>;
+    };
+
+    PoolAllocator() : resource(nullptr), pool(nullptr) {}
+
+    PoolAllocator(const PoolAllocator &that) : resource(that.sharedResource()), pool(that.pool) {}
+
+    PoolAllocator(PoolAllocator &&that) noexcept : resource(std::move(that.resource)), pool(that.pool)
+    {
+        that.pool = nullptr;
+    }
+
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U> &that) : resource(that.sharedResource()), pool(nullptr) {}
+
+    template <typename U>
+    PoolAllocator(PoolAllocator<U> &&that) noexcept : resource(std::move(that.resource)), pool(nullptr)
+    {
+        that.pool = nullptr;
+    }
+
+    PoolAllocator &operator=(const PoolAllocator &that)
+    {
+        resource = that.sharedResource();
+        pool = that.pool;
+        return *this;
+    }
+
+    PoolAllocator &operator=(PoolAllocator &&that) noexcept
+    {
+        if (&that != this)
+        {
+            resource = std::move(that.resource);
+            pool = that.pool;
+            that.pool = nullptr;
+        }
+        return *this;
+    }
+
+    // Copied containers get an independent pool
+    PoolAllocator select_on_container_copy_construction() const
+    {
+        return PoolAllocator();
+    }
+
+    T *allocate(size_t n)
+    {
+        // Only single nodes are pooled
+        SlabPool *slab = n == 1 ? nodePool() : nullptr;
+        if (slab == nullptr)
+            return static_cast<T *>(::operator new(n * sizeof(T)));
+        return static_cast<T *>(slab->allocate());
+    }
+
+    void deallocate(T *ptr, size_t n)
+    {
+        SlabPool *slab = n == 1 ? nodePool() : nullptr;
+        if (slab == nullptr)
+            ::operator delete(ptr);
+        else
+            slab->deallocate(ptr);
+    }
+
+    template <typename U>
+    bool operator==(const PoolAllocator<U> &that) const
+    {
+        return samePool(that);
+    }
+
+    template <typename U>
+    bool operator!=(const PoolAllocator<U> &that) const
+    {
+        return !samePool(that);
+    }
+};
+
+#endif /*RBPOOL_H*/
@@ -0,0 +1,26 @@
+/**range.hpp
+ *
+ * Half-open iterator pair returned by the range() queries of Map and
+ * Set. It is a lightweight view: it owns nothing and is invalidated
+ * together with the iterators it holds.
+ */
+
+#ifndef RBRANGE_H
+#define RBRANGE_H
+
+template <typename It>
+class IteratorRange
+{
+private:
+    It first;
+    It last;
+
+public:
+    IteratorRange(It first, It last) : first(first), last(last) {}
+
+    It begin() const { return first; }
+    It end() const { return last; }
+    bool empty() const { return first == last; }
+};
+
+#endif /*RBRANGE_H*/
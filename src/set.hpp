@@ -7,14 +7,31 @@
 #ifndef RBSET_H
 #define RBSET_H
 
+#include <algorithm>
+#include <cstddef>
 #include <cstdint>
 #include <functional>
 #include <initializer_list>
+#include <iterator>
+#include <memory>
 #include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
+#include "augment.hpp"
+#include "codec.hpp"
+#include "compare.hpp"
 #include "deque.hpp"
-
-template <typename key_t, typename Compare = std::less<key_t>>
+#include "frozen_set.hpp"
+#include "parallel.hpp"
+#include "pool.hpp"
+#include "range.hpp"
+#include "sink.hpp"
+#include "stats.hpp"
+
+template <typename key_t, typename Compare = std::less<key_t>, typename Allocator = PoolAllocator<key_t>, typename Stats = NoStats,
+          typename Augment = OrderStatistics>
 class Set
 {
 private:
@@ -27,66 +44,174 @@ private:
      * TreeNode
      */
 
-    class TreeNode
+    class TreeNode : public AugmentNode<Augment>
     {
     public:
         const static bool RED = true;
         const static bool BLACK = false;
 
+        // The color and subtree size live in the base
         key_t key;
         TreeNode *left;
         TreeNode *right;
-        size_t sz;
-        bool color;
+        TreeNode *parent;
 
-        TreeNode(key_t k, bool c)
-            : key(k), left(nullptr), right(nullptr), sz(1), color(c) {}
+        // Key is constructed in place from args
+        template <typename... Args>
+        TreeNode(bool c, Args &&...args)
+            : AugmentNode<Augment>(c), key(std::forward<Args>(args)...), left(nullptr), right(nullptr), parent(nullptr) {}
     };
 
+    using NodeAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<TreeNode>;
+    using NodeAllocTraits = std::allocator_traits<NodeAllocator>;
+
     // Tree attributes
     TreeNode *root;
+    TreeNode *rightmost; // Cached maximum; appends and --end() skip the right spine
     Compare comparator;
+    mutable Stats statistics; // Const searches count too
+    AugmentCount<Augment> counter;
+    NodeAllocator alloc;
+
+    // Node allocation
+    template <typename... Args>
+    TreeNode *createNode(bool color, Args &&...args);
+    void destroyNode(TreeNode *node);
 
     // Utilities
-    ComparisonResult comp(const key_t &k1, const key_t &k2) const;
+    template <typename K1, typename K2>
+    ComparisonResult comp(const K1 &k1, const K2 &k2) const;
+    template <typename K1, typename K2>
+    bool less(const K1 &k1, const K2 &k2) const;
     size_t nodeSize(TreeNode *node) const;
+    void pull(TreeNode *node); // Size from the children
     bool treeEqual(TreeNode *node1, TreeNode *node2) const;
 
     // Recursive deep copy
     TreeNode *copyTree(TreeNode const *node);
 
+    // Linear-time construction from sorted input
+    static size_t maxNodes(size_t blackHeight);
+    template <typename ForwardIt>
+    TreeNode *buildSorted(ForwardIt &it, size_t n, size_t blackHeight);
+    template <typename ForwardIt>
+    TreeNode *buildTree(ForwardIt first, size_t n);
+
+    // Join-based set algebra on detached subtrees
+    void installRoot(TreeNode *node);
+    // Subtrees carry their black heights so that joins never walk a spine to find them;
+    // a height& parameter holds that of the input tree on entry and of the result on return
+    size_t blackHeight(TreeNode *node);
+    size_t childHeight(TreeNode *child, size_t height);
+    TreeNode *joinTrees(TreeNode *left, size_t leftHeight, TreeNode *mid, TreeNode *right, size_t rightHeight, size_t &height);
+    TreeNode *concatTrees(TreeNode *left, size_t leftHeight, TreeNode *right, size_t rightHeight, size_t &height);
+    TreeNode *splitLast(TreeNode *node, size_t height, TreeNode *&rest, size_t &restHeight);
+    template <typename K>
+    TreeNode *splitTree(TreeNode *node, size_t height, const K &key, TreeNode *&left, size_t &leftHeight, TreeNode *&right, size_t &rightHeight);
+    size_t countSmaller(TreeNode *a, TreeNode *b, bool &aSmaller);
+    TreeNode *unionTree(TreeNode *node, size_t &height, TreeNode const *other, size_t otherHeight);
+    TreeNode *unionSteal(TreeNode *node, size_t &height, TreeNode *other, size_t otherHeight, BulkRun<TreeNode> *run = nullptr);
+    TreeNode *intersectTree(TreeNode *node, size_t &height, TreeNode const *other, BulkRun<TreeNode> *run = nullptr);
+    TreeNode *differenceTree(TreeNode *node, size_t &height, TreeNode const *other, BulkRun<TreeNode> *run = nullptr);
+
+    // Bulk updates; run is nullptr when sequential
+    void discardTree(TreeNode *node, BulkRun<TreeNode> *run);
+    void releaseDiscarded(BulkRun<TreeNode> &run);
+    TreeNode *eraseSorted(TreeNode *node, size_t &height, const key_t *keys, size_t count, BulkRun<TreeNode> *run);
+    template <typename InputIt>
+    void _insertBatch(InputIt first, InputIt last, BulkRun<TreeNode> *run);
+    template <typename InputIt>
+    void _eraseBatch(InputIt first, InputIt last, BulkRun<TreeNode> *run);
+
+    // In-order neighbours through parent links
+    TreeNode *minNode() const;
+    TreeNode *maxNode() const;
+    static TreeNode *successor(TreeNode *node);
+    static TreeNode *predecessor(TreeNode *node);
+
     // Tree rotation & coloring
     bool isRed(TreeNode *node);
     TreeNode *rotateLeft(TreeNode *node);
     TreeNode *rotateRight(TreeNode *node);
     void flipColors(TreeNode *node);
 
-    // Fixup during insertion
+    // Local fixup after a mutation below node
     TreeNode *rbFix(TreeNode *node);
 
     // Deletion 2-node fixups
     TreeNode *moveRedLeft(TreeNode *node);
     TreeNode *moveRedRight(TreeNode *node);
 
-    // Recursive helpers
-    TreeNode *_at(TreeNode *node, const key_t &key) const;
-    int _rank(TreeNode *node, const key_t &key) const;
-    TreeNode *_floor(TreeNode *node, const key_t &key) const;
-    TreeNode *_ceiling(TreeNode *node, const key_t &key) const;
-    const key_t &_rankSelect(TreeNode *node, int rank) const;
-
-    TreeNode *_insert(TreeNode *node, const key_t &key);
-    TreeNode *_eraseMin(TreeNode *node);
-    TreeNode *_erase(TreeNode *node, const key_t &key);
+    // Search helpers: one comparator call per level
+    template <typename K>
+    TreeNode *_at(TreeNode *node, const K &key) const;
+    template <typename K>
+    TreeNode *_at(TreeNode *node, const K &key, std::true_type threeWay) const;
+    template <typename K>
+    TreeNode *_at(TreeNode *node, const K &key, std::false_type threeWay) const;
+    template <typename K>
+    int _rank(TreeNode *node, const K &key) const;
+
+    // Lockstep descent of up to BATCH_WIDTH searches; finds the first node
+    // not less than each key and, if ranks is not nullptr, each rank
+    constexpr static size_t BATCH_WIDTH = 16;
+    void _lowerBatch(const key_t *keys, size_t count, TreeNode **candidates, int *ranks) const;
+    template <typename K>
+    TreeNode *_floor(TreeNode *node, const K &key) const;
+    template <typename K>
+    TreeNode *_ceiling(TreeNode *node, const K &key) const;
+    template <typename K>
+    TreeNode *_upper(TreeNode *node, const K &key) const;
+    const key_t &_rankSelect(TreeNode *node, int rank) const; // Recursive
+
+    // Preorder writers behind the in-memory and streaming serializers;
+    // commit() is called after every node
+    template <typename Commit, typename KeyWriter>
+    void _serialize(std::string &out, Commit &&commit, KeyWriter &&writeKey, const std::string &delim, const std::string &nilStr) const;
+    template <typename Commit, typename KeyCodec>
+    void _serializeBinary(std::string &out, Commit &&commit, const KeyCodec &keyCodec) const;
+
+    // Iterative mutation engine
+    void replaceChild(TreeNode *parent, TreeNode *oldChild, TreeNode *newChild);
+    TreeNode *relink(TreeNode *oldTop, TreeNode *newTop);
+    void fixUpward(TreeNode *node, TreeNode *lastTouched, bool grew);
+
+    TreeNode *findSlot(const key_t &key, TreeNode *&parent, ComparisonResult &cmp) const;
+    TreeNode *findSlot(const key_t &key, TreeNode *&parent, ComparisonResult &cmp, std::true_type threeWay) const;
+    TreeNode *findSlot(const key_t &key, TreeNode *&parent, ComparisonResult &cmp, std::false_type threeWay) const;
+    void attachNode(TreeNode *node, TreeNode *parent, ComparisonResult cmp);
+    void _unlink(TreeNode *target); // Detaches target without freeing it
+    TreeNode *adoptNode(TreeNode *node);
+    void _erase(TreeNode *target);
+    template <typename K>
+    TreeNode *_insertHint(TreeNode *hint, K &&key);
+    template <typename K>
+    void _append(K &&key);
 
 public:
+    // Inorder iterator, defined below. Keys are immutable, so both
+    // iterator types are read-only.
+    class Iterator;
+    using iterator = Iterator;
+    using const_iterator = Iterator;
+
+    // Owner of an extracted node, defined below
+    class NodeHandle;
+    using node_type = NodeHandle;
+
     /**
      * Constructors
      */
 
     Set();
     Set(const std::initializer_list<key_t> &init);
+    explicit Set(const Allocator &allocator);
     Set(const Set &that); // Deep copy
+    Set(Set &&that);      // Steals the nodes of that
+
+    // Linear-time construction from strictly increasing keys
+    template <typename ForwardIt>
+    static Set fromSorted(ForwardIt first, ForwardIt last, bool checkSorted = true);
 
     /**
      * Utilities
@@ -95,7 +220,12 @@ public:
     size_t size() const;
     bool empty() const;
 
+    // Counters of the Stats policy; always zero with NoStats
+    TreeStats stats() const;
+    void resetStats();
+
     Set &operator=(const Set &that); // Deep copy
+    Set &operator=(Set &&that);
     bool operator==(const Set &that) const;
     bool operator!=(const Set &that) const;
 
@@ -105,6 +235,14 @@ public:
 
     bool contains(const key_t &key) const;
 
+    // Heterogeneous lookup, enabled when Compare::is_transparent is defined
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    bool contains(const K &key) const;
+
+    // Batched lookups for count keys; searches advance together so their cache misses overlap
+    void containsBatch(const key_t *keys, size_t count, bool *out) const;
+    void rankBatch(const key_t *keys, size_t count, int *out) const;
+
     /**
      * Ordered set operations
      */
@@ -115,6 +253,13 @@ public:
 
     key_t floor(const key_t &key);
     key_t ceiling(const key_t &key);
+
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    int rank(const K &key) const;
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    key_t floor(const K &key);
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    key_t ceiling(const K &key);
     key_t rankSelect(int rank);
 
     /**
@@ -122,6 +267,21 @@ public:
      */
 
     void insert(const key_t &key);
+    void insert(key_t &&key);
+
+    // Without a descent if the key belongs right before hint (end() for
+    // the back), otherwise as insert(); returns the element of the key
+    iterator insert(const_iterator hint, const key_t &key);
+    iterator insert(const_iterator hint, key_t &&key);
+
+    // Insertion after the maximum, with a single comparison; throws
+    // std::invalid_argument unless the key is greater than every key
+    void append(const key_t &key);
+    void append(key_t &&key);
+
+    // Construct in place; existing keys are left untouched
+    template <typename... Args>
+    std::pair<iterator, bool> emplace(Args &&...args);
 
     /**
      * Deletion
@@ -129,6 +289,52 @@ public:
 
     void erase(const key_t &key);
 
+    /**
+     * Node handles
+     */
+
+    // Detach a node without freeing it; throws like erase()
+    node_type extract(const key_t &key);
+    node_type extract(const_iterator position);
+
+    // Relink the node of handle if the allocators are equal, otherwise move
+    // its key into a new node; an existing key is left untouched and the
+    // handle keeps its node
+    std::pair<iterator, bool> insert(node_type &&handle);
+
+    // Moves over the nodes of that whose keys are missing here; O(m log n)
+    void merge(Set &that);
+
+    /**
+     * Set algebra
+     */
+
+    // O(m log(n/m + 1)); nodes of this container are reused
+    void unionWith(const Set &that);
+    void unionWith(Set &&that); // Also reuses the nodes of that if allocators are equal
+    void intersect(const Set &that);
+    void difference(const Set &that);
+
+    // Parallel variants fork large subtree recursions onto a work-stealing pool
+    void unionWith(const Set &that, const ParallelPolicy &policy);
+    void unionWith(Set &&that, const ParallelPolicy &policy);
+    void intersect(const Set &that, const ParallelPolicy &policy);
+    void difference(const Set &that, const ParallelPolicy &policy);
+
+    // O(log n) split and concatenation
+    Set split(const key_t &key); // Moves keys not less than key into the result
+    void join(Set &&that);       // Every key of that must be greater than every key here
+
+    // Bulk updates: the batch is sorted and merged in a single pass
+    template <typename InputIt>
+    void insertBatch(InputIt first, InputIt last);
+    template <typename InputIt>
+    void insertBatch(InputIt first, InputIt last, const ParallelPolicy &policy);
+    template <typename InputIt>
+    void eraseBatch(InputIt first, InputIt last);
+    template <typename InputIt>
+    void eraseBatch(InputIt first, InputIt last, const ParallelPolicy &policy);
+
     /**
      * Tree processing
      */
@@ -136,6 +342,26 @@ public:
     std::string serialize(const std::function<std::string(const key_t &)> &objToString, const std::string &delim = ",", const std::string &nilStr = ")") const;
     size_t depth() const; // BFS: ~2n node accesses
 
+    // Read-only copy in one contiguous array, for search-heavy phases
+    FrozenSet<key_t, Compare> freeze() const;
+
+    // Keys, colors and shape in one preorder pass; see codec.hpp
+    template <typename KeyCodec = BinaryCodec<key_t>>
+    std::string serializeBinary(const KeyCodec &keyCodec = KeyCodec()) const;
+
+    // O(n) rebuild of the serialized tree, without comparisons or rebalancing
+    template <typename KeyCodec = BinaryCodec<key_t>>
+    static Set deserializeBinary(const std::string &bytes, const KeyCodec &keyCodec = KeyCodec());
+    template <typename KeyCodec = BinaryCodec<key_t>>
+    static Set deserializeBinary(const char *data, size_t length, const KeyCodec &keyCodec = KeyCodec());
+
+    // Streaming variants through a std::ostream, FileDescriptor or chunk callback;
+    // writeKey(key, out) appends the text of key to out
+    template <typename Sink, typename KeyWriter>
+    void serializeTo(Sink &&sink, KeyWriter &&writeKey, const std::string &delim = ",", const std::string &nilStr = ")") const;
+    template <typename Sink, typename KeyCodec = BinaryCodec<key_t>>
+    void serializeBinaryTo(Sink &&sink, const KeyCodec &keyCodec = KeyCodec()) const;
+
     /**
      * Delete tree
      */
@@ -146,23 +372,101 @@ public:
     /**
      * Inorder iterator
      */
-private:
+
     class Iterator
     {
+    private:
+        friend class Set;
+
+        TreeNode *node;
+        const Set *tree;
+
+        Iterator(TreeNode *node, const Set *tree);
+
     public:
-        Deque<TreeNode *> nodeStack;
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = key_t;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const key_t *;
+        using reference = const key_t &;
+
+        Iterator();
+
+        reference operator*() const;
+        pointer operator->() const;
+        bool operator==(const Iterator &that) const;
+        bool operator!=(const Iterator &that) const;
+
+        Iterator &operator++();
+        Iterator operator++(int);
+        Iterator &operator--();
+        Iterator operator--(int);
+    };
+
+    /**
+     * Node handle
+     */
 
-        Iterator(const Set<key_t, Compare> &tree);
-        key_t &operator*();
-        bool operator==(Iterator that) const;
-        bool operator!=(Iterator that) const;
-        void operator++();
+    class NodeHandle
+    {
+    private:
+        friend class Set;
+
+        TreeNode *node;
+        NodeAllocator alloc; // Frees the node if it is never inserted
+
+        NodeHandle(TreeNode *node, const NodeAllocator &alloc);
+        void reset();
+
+    public:
+        NodeHandle();
+        NodeHandle(NodeHandle &&that);
+        NodeHandle &operator=(NodeHandle &&that);
+        NodeHandle(const NodeHandle &) = delete;
+        NodeHandle &operator=(const NodeHandle &) = delete;
+        ~NodeHandle();
+
+        bool empty() const;
+        explicit operator bool() const;
+
+        // The key may change before the node is inserted again
+        key_t &value() const;
     };
 
-public:
-    Iterator begin() const;
-    Iterator end() const;
-    Iterator find(const key_t &key) const;
+    using reverse_iterator = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+    iterator begin() const;
+    iterator end() const;
+    const_iterator cbegin() const;
+    const_iterator cend() const;
+    reverse_iterator rbegin() const;
+    reverse_iterator rend() const;
+    const_reverse_iterator crbegin() const;
+    const_reverse_iterator crend() const;
+
+    iterator find(const key_t &key) const;
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    iterator find(const K &key) const;
+
+    // Bounds: first key not less than / greater than key
+    iterator lower_bound(const key_t &key) const;
+    iterator upper_bound(const key_t &key) const;
+    std::pair<iterator, iterator> equal_range(const key_t &key) const;
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    iterator lower_bound(const K &key) const;
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    iterator upper_bound(const K &key) const;
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    std::pair<iterator, iterator> equal_range(const K &key) const;
+
+    // Keys in [lo, hi)
+    IteratorRange<iterator> range(const key_t &lo, const key_t &hi) const;
+    size_t rangeCount(const key_t &lo, const key_t &hi) const; // O(log n)
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    IteratorRange<iterator> range(const K &lo, const K &hi) const;
+    template <typename K, typename C = Compare, typename = typename C::is_transparent>
+    size_t rangeCount(const K &lo, const K &hi) const;
 };
 
 #include "set.ipp"
@@ -0,0 +1,139 @@
+/**sink.hpp
+ *
+ * Output targets for the streaming serializers of Map and Set. A sink
+ * is a std::ostream, a FileDescriptor, or any callable taking
+ * (const char *data, size_t size). Serializers write into a chunk
+ * buffer and hand full chunks to the sink, so the output never has to
+ * fit in memory.
+ */
+
+#ifndef RBSINK_H
+#define RBSINK_H
+
+#include <cerrno>
+#include <cstddef>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+// Raw file descriptor, written with write(2); it is not closed
+struct FileDescriptor
+{
+    int fd;
+};
+
+class OstreamWriter
+{
+private:
+    std::ostream *stream;
+
+public:
+    explicit OstreamWriter(std::ostream &stream) : stream(&stream) {}
+
+    void operator()(const char *data, size_t size)
+    {
+        stream->write(data, static_cast<std::streamsize>(size));
+        if (!*stream)
+            throw std::runtime_error("Write to output stream failed");
+    }
+};
+
+class FileDescriptorWriter
+{
+private:
+    int fd;
+
+public:
+    explicit FileDescriptorWriter(FileDescriptor target) : fd(target.fd) {}
+
+    // Retries partial and interrupted writes
+    void operator()(const char *data, size_t size)
+    {
+        while (size > 0)
+        {
+#if defined(_WIN32)
+            long written = _write(fd, data, static_cast<unsigned>(size));
+#else
+            long written = ::write(fd, data, size);
+#endif
+            if (written < 0 && errno == EINTR)
+                continue;
+            if (written <= 0)
+                throw std::system_error(errno, std::generic_category(), "Write to file descriptor failed");
+
+            data += written;
+            size -= static_cast<size_t>(written);
+        }
+    }
+};
+
+inline OstreamWriter sinkWriter(std::ostream &stream)
+{
+    return OstreamWriter(stream);
+}
+
+inline FileDescriptorWriter sinkWriter(FileDescriptor target)
+{
+    return FileDescriptorWriter(target);
+}
+
+// Callables are used as they are; streams derived from std::ostream are not callables
+template <typename F, typename = typename std::enable_if<!std::is_base_of<std::ostream, typename std::decay<F>::type>::value>::type>
+F &sinkWriter(F &callback)
+{
+    return callback;
+}
+
+/**
+ * ChunkedOutput
+ *
+ * Buffer that serializers append to directly. commit() hands the buffer
+ * to the writer once it holds a full chunk; flush() hands over the rest.
+ */
+
+template <typename Writer>
+class ChunkedOutput
+{
+private:
+    Writer write;
+    std::string chunk;
+    size_t chunkSize;
+
+public:
+    constexpr static size_t DEFAULT_CHUNK_SIZE = 1 << 16;
+
+    explicit ChunkedOutput(Writer write, size_t chunkSize = DEFAULT_CHUNK_SIZE)
+        : write(std::forward<Writer>(write)), chunkSize(chunkSize)
+    {
+        chunk.reserve(chunkSize);
+    }
+
+    std::string &buffer()
+    {
+        return chunk;
+    }
+
+    void commit()
+    {
+        if (chunk.size() >= chunkSize)
+            flush();
+    }
+
+    void flush()
+    {
+        if (!chunk.empty())
+            write(chunk.data(), chunk.size());
+        chunk.clear();
+    }
+};
+
+#endif /*RBSINK_H*/
@@ -0,0 +1,140 @@
+/**stats.hpp
+ *
+ * Statistics policies for Map and Set. The tree reports every
+ * comparator call, rotation, color flip, node allocation and release,
+ * and the number of nodes each lookup, insert and erase visited.
+ *
+ * NoStats, the default, ignores all of it: its hooks are empty inline
+ * functions, so they compile to nothing. CountingStats keeps the
+ * totals in relaxed atomic counters, which stay correct under the
+ * parallel set algebra and concurrent readers.
+ */
+
+#ifndef RBSTATS_H
+#define RBSTATS_H
+
+#include <atomic>
+#include <cstddef>
+
+enum class TreeOperation
+{
+    LOOKUP,
+    INSERT,
+    ERASE
+};
+
+// Nodes visited on the way down, per operation type
+struct PathStats
+{
+    size_t operations = 0;
+    size_t nodesVisited = 0;
+    size_t longest = 0;
+};
+
+struct TreeStats
+{
+    size_t comparisons = 0;
+    size_t rotations = 0;
+    size_t colorFlips = 0;
+    size_t allocations = 0;
+    size_t deallocations = 0;
+    PathStats lookup;
+    PathStats insert;
+    PathStats erase;
+};
+
+struct NoStats
+{
+    void comparison() {}
+    void rotation() {}
+    void colorFlip() {}
+    void allocation() {}
+    void deallocation() {}
+    void path(TreeOperation, size_t) {}
+
+    TreeStats snapshot() const { return TreeStats(); }
+    void reset() {}
+};
+
+class CountingStats
+{
+private:
+    struct PathCounters
+    {
+        std::atomic<size_t> operations{0};
+        std::atomic<size_t> nodesVisited{0};
+        std::atomic<size_t> longest{0};
+
+        void record(size_t length)
+        {
+            operations.fetch_add(1, std::memory_order_relaxed);
+            nodesVisited.fetch_add(length, std::memory_order_relaxed);
+
+            size_t seen = longest.load(std::memory_order_relaxed);
+            while (seen < length && !longest.compare_exchange_weak(seen, length, std::memory_order_relaxed))
+                ;
+        }
+
+        PathStats load() const
+        {
+            PathStats stats;
+            stats.operations = operations.load(std::memory_order_relaxed);
+            stats.nodesVisited = nodesVisited.load(std::memory_order_relaxed);
+            stats.longest = longest.load(std::memory_order_relaxed);
+            return stats;
+        }
+
+        void clear()
+        {
+            operations.store(0, std::memory_order_relaxed);
+            nodesVisited.store(0, std::memory_order_relaxed);
+            longest.store(0, std::memory_order_relaxed);
+        }
+    };
+
+    std::atomic<size_t> comparisons{0};
+    std::atomic<size_t> rotations{0};
+    std::atomic<size_t> colorFlips{0};
+    std::atomic<size_t> allocations{0};
+    std::atomic<size_t> deallocations{0};
+    PathCounters paths[3];
+
+public:
+    void comparison() { comparisons.fetch_add(1, std::memory_order_relaxed); }
+    void rotation() { rotations.fetch_add(1, std::memory_order_relaxed); }
+    void colorFlip() { colorFlips.fetch_add(1, std::memory_order_relaxed); }
+    void allocation() { allocations.fetch_add(1, std::memory_order_relaxed); }
+    void deallocation() { deallocations.fetch_add(1, std::memory_order_relaxed); }
+
+    void path(TreeOperation operation, size_t length)
+    {
+        paths[static_cast<size_t>(operation)].record(length);
+    }
+
+    TreeStats snapshot() const
+    {
+        TreeStats stats;
+        stats.comparisons = comparisons.load(std::memory_order_relaxed);
+        stats.rotations = rotations.load(std::memory_order_relaxed);
+        stats.colorFlips = colorFlips.load(std::memory_order_relaxed);
+        stats.allocations = allocations.load(std::memory_order_relaxed);
+        stats.deallocations = deallocations.load(std::memory_order_relaxed);
+        stats.lookup = paths[static_cast<size_t>(TreeOperation::LOOKUP)].load();
+        stats.insert = paths[static_cast<size_t>(TreeOperation::INSERT)].load();
+        stats.erase = paths[static_cast<size_t>(TreeOperation::ERASE)].load();
+        return stats;
+    }
+
+    void reset()
+    {
+        comparisons.store(0, std::memory_order_relaxed);
+        rotations.store(0, std::memory_order_relaxed);
+        colorFlips.store(0, std::memory_order_relaxed);
+        allocations.store(0, std::memory_order_relaxed);
+        deallocations.store(0, std::memory_order_relaxed);
+        for (PathCounters &counters : paths)
+            counters.clear();
+    }
+};
+
+#endif /*RBSTATS_H*/
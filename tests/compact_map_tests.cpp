@@ -0,0 +1,131 @@
+/**compact_map_tests.cpp
+ *
+ * Unit tests for the compact map
+ */
+
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "compact_map.hpp"
+
+TEST(CompactMapOperations, InsertEraseAndLookup)
+{
+    CompactMap<int, int> tree{{3, 30}, {1, 10}, {2, 20}};
+    EXPECT_EQ(tree.size(), 3);
+    EXPECT_EQ(tree.at(2), 20);
+
+    tree.insert({2, 200});
+    tree.erase(1);
+    EXPECT_EQ(tree.size(), 2);
+    EXPECT_EQ(tree.at(2), 200);
+    EXPECT_FALSE(tree.contains(1));
+    EXPECT_THROW(tree.erase(1), std::out_of_range);
+    EXPECT_THROW(tree.at(1), std::out_of_range);
+
+    EXPECT_EQ(tree.min(), 2);
+    EXPECT_EQ(tree.max(), 3);
+    EXPECT_EQ(tree.floor(5), 3);
+    EXPECT_EQ(tree.ceiling(0), 2);
+    EXPECT_THROW(tree.floor(1), std::out_of_range);
+    EXPECT_THROW(tree.ceiling(4), std::out_of_range);
+    EXPECT_EQ(tree.rank(3), 1);
+    EXPECT_EQ(tree.rankSelect(0), 2);
+    EXPECT_THROW(tree.rankSelect(2), std::out_of_range);
+
+    tree.clear();
+    EXPECT_TRUE(tree.empty());
+    EXPECT_THROW(tree.min(), std::out_of_range);
+}
+
+TEST(CompactMapOperations, MatchesReferenceMap)
+{
+    CompactMap<int, int> tree;
+    std::map<int, int> reference;
+
+    for (int i = 0; i < 60000; i++)
+    {
+        int key = (i * 7919) % 20011;
+        if (i % 3 == 2 && reference.count(key) == 1)
+        {
+            tree.erase(key);
+            reference.erase(key);
+        }
+        else
+        {
+            tree.insert({key, i});
+            reference[key] = i;
+        }
+    }
+
+    EXPECT_EQ(tree.size(), reference.size());
+    std::vector<std::pair<int, int>> seen(tree.begin(), tree.end());
+    std::vector<std::pair<int, int>> wanted(reference.begin(), reference.end());
+    EXPECT_EQ(seen, wanted);
+
+    for (int key = 0; key < 20011; key += 7)
+    {
+        auto lower = reference.lower_bound(key);
+        EXPECT_EQ(tree.rank(key), std::distance(reference.begin(), lower));
+        EXPECT_EQ(tree.contains(key), reference.count(key) == 1);
+        if (lower != reference.end())
+        {
+            EXPECT_EQ(tree.ceiling(key), lower->first);
+        }
+    }
+
+    // Erased slots are reused before the array grows
+    for (auto &entry : reference)
+        tree.erase(entry.first);
+    EXPECT_TRUE(tree.empty());
+}
+
+TEST(CompactMapOperations, CopyMoveAndStringPayloads)
+{
+    CompactMap<std::string, std::string> tree;
+    for (int i = 0; i < 1000; i++)
+        tree.insert({"key number " + std::to_string(i), std::string(40, 'a' + i % 26)});
+    for (int i = 0; i < 1000; i += 2)
+        tree.erase("key number " + std::to_string(i));
+
+    CompactMap<std::string, std::string> copy(tree);
+    tree.insert({"key number 1", "changed"});
+    EXPECT_EQ(copy.at("key number 1"), std::string(40, 'b'));
+    EXPECT_EQ(copy.size(), 500);
+
+    CompactMap<std::string, std::string> moved(std::move(copy));
+    EXPECT_TRUE(copy.empty());
+    EXPECT_EQ(moved.size(), 500);
+    EXPECT_FALSE(moved.contains("key number 0"));
+
+    copy = moved;
+    EXPECT_EQ(copy.rankSelect(0), moved.rankSelect(0));
+    moved = std::move(tree);
+    EXPECT_EQ(moved.at("key number 1"), "changed");
+}
+
+TEST(CompactMapOperations, NodeIsHalfTheSize)
+{
+    // Two 32-bit indices and a 32-bit size with the color in its top bit
+    EXPECT_EQ((CompactMap<uint32_t, uint32_t>::nodeBytes()), 20);
+}
+
+// 2^31 entries will not fit in a test, but every slot comes from the
+// same grow() check, which reserve() reaches directly
+TEST(CompactMapOperations, RefusesToGrowIntoTheColorBit)
+{
+    CompactMap<uint32_t, uint32_t> tree{{1, 10}, {2, 20}};
+    EXPECT_THROW(tree.reserve(size_t(1) << 31), std::length_error);
+    EXPECT_THROW(tree.reserve((size_t(1) << 32) + 4), std::length_error);
+
+    // Nothing changed, and the tree still grows below the limit
+    EXPECT_EQ(tree.size(), 2);
+    tree.reserve(1000);
+    for (uint32_t i = 3; i < 1000; i++)
+        tree.insert({i, i * 10});
+    EXPECT_EQ(tree.size(), 999);
+    EXPECT_EQ(tree.at(999), 9990);
+}
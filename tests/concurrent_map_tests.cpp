@@ -0,0 +1,112 @@
+/**concurrent_map_tests.cpp
+ *
+ * Unit tests for the multi-version concurrent map
+ */
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <map>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "concurrent_map.hpp"
+
+TEST(ConcurrentMapOperations, InsertEraseAndLookup)
+{
+    ConcurrentMap<int, int> tree{{3, 30}, {1, 10}, {2, 20}};
+    EXPECT_EQ(tree.size(), 3);
+    EXPECT_EQ(tree.at(2), 20);
+
+    tree.insert({2, 200});
+    tree.erase(1);
+    EXPECT_EQ(tree.at(2), 200);
+    EXPECT_FALSE(tree.contains(1));
+    EXPECT_THROW(tree.erase(1), std::out_of_range);
+    EXPECT_THROW(tree.at(1), std::out_of_range);
+
+    auto snapshot = tree.snapshot();
+    EXPECT_EQ(snapshot.min(), 2);
+    EXPECT_EQ(snapshot.max(), 3);
+    EXPECT_EQ(snapshot.floor(5), 3);
+    EXPECT_EQ(snapshot.ceiling(0), 2);
+    EXPECT_EQ(snapshot.rank(3), 1);
+    EXPECT_EQ(snapshot.rankSelect(0), 2);
+}
+
+TEST(ConcurrentMapOperations, SnapshotIsolation)
+{
+    ConcurrentMap<int, int> tree;
+    std::map<int, int> reference;
+    for (int i = 0; i < 1000; i++)
+    {
+        tree.insert({i, i});
+        reference[i] = i;
+    }
+
+    auto before = tree.snapshot();
+    for (int i = 0; i < 1000; i += 2)
+        tree.erase(i);
+    for (int i = 1000; i < 1500; i++)
+        tree.insert({i, -i});
+
+    // The old version is unaffected by later writes
+    std::vector<std::pair<int, int>> seen(before.begin(), before.end());
+    std::vector<std::pair<int, int>> expected(reference.begin(), reference.end());
+    EXPECT_EQ(seen, expected);
+    EXPECT_EQ(before.size(), 1000);
+    EXPECT_EQ(tree.size(), 1000);
+    EXPECT_GT(tree.retiredCount(), 0);
+
+    // Nodes replaced since the snapshot are freed once it is gone
+    before = tree.snapshot();
+    tree.insert({0, 0});
+    EXPECT_GT(tree.retiredCount(), 0);
+    {
+        auto released = std::move(before);
+    }
+    tree.insert({0, 1});
+    EXPECT_EQ(tree.retiredCount(), 0);
+}
+
+TEST(ConcurrentMapOperations, ReadersDuringWrites)
+{
+    constexpr int WRITES = 20000;
+    ConcurrentMap<int, int> tree;
+    std::atomic<bool> done(false);
+    std::atomic<int> failures(0);
+
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 3; t++)
+        readers.emplace_back([&]
+                             {
+                                 while (!done.load())
+                                 {
+                                     auto snapshot = tree.snapshot();
+                                     size_t count = 0;
+                                     int prev = -1;
+                                     for (const auto &entry : snapshot)
+                                     {
+                                         if (entry.first != entry.second || entry.first <= prev)
+                                             failures++;
+                                         prev = entry.first;
+                                         count++;
+                                     }
+                                     if (count != snapshot.size())
+                                         failures++;
+                                 } });
+
+    for (int i = 0; i < WRITES; i++)
+    {
+        tree.insert({i, i});
+        if (i % 2 == 1)
+            tree.erase(i / 2);
+    }
+    done.store(true);
+    for (std::thread &reader : readers)
+        reader.join();
+
+    EXPECT_EQ(failures.load(), 0);
+    EXPECT_EQ(tree.size(), WRITES / 2);
+    EXPECT_EQ(tree.retiredCount(), 0);
+}
@@ -0,0 +1,153 @@
+/**frozen_tests.cpp
+ *
+ * Unit tests for the frozen map and set
+ */
+
+#include <gtest/gtest.h>
+#include <functional>
+#include <iterator>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "map.hpp"
+#include "set.hpp"
+
+TEST(FrozenMapOperations, MatchesTreeAtEverySize)
+{
+    // Every shape of the last Eytzinger level, including the empty map
+    for (int n = 0; n <= 70; n++)
+    {
+        Map<int, int> tree;
+        for (int i = 0; i < n; i++)
+            tree.insert({2 * i, -i});
+        FrozenMap<int, int> frozen = tree.freeze();
+        EXPECT_EQ(frozen.size(), static_cast<size_t>(n));
+
+        // Sorted positions are derived from the slot numbers
+        std::vector<std::pair<int, int>> seen(frozen.begin(), frozen.end());
+        std::vector<std::pair<int, int>> wanted(tree.begin(), tree.end());
+        EXPECT_EQ(seen, wanted);
+        for (int i = 0; i < n; i++)
+            EXPECT_EQ(frozen.rankSelect(i), 2 * i);
+        if (n > 0)
+        {
+            EXPECT_EQ(frozen.min(), 0);
+            EXPECT_EQ(frozen.max(), 2 * (n - 1));
+        }
+
+        for (int key = -1; key <= 2 * n; key++)
+        {
+            EXPECT_EQ(frozen.contains(key), tree.contains(key));
+            if (n == 0)
+                continue;
+
+            EXPECT_EQ(frozen.rank(key), tree.rank(key));
+            if (tree.contains(key))
+            {
+                EXPECT_EQ(frozen.at(key), tree.at(key));
+            }
+            else
+            {
+                EXPECT_THROW(frozen.at(key), std::out_of_range);
+            }
+
+            if (key >= 0)
+            {
+                EXPECT_EQ(frozen.floor(key), tree.floor(key));
+            }
+            else
+            {
+                EXPECT_THROW(frozen.floor(key), std::out_of_range);
+            }
+            if (key <= 2 * (n - 1))
+            {
+                EXPECT_EQ(frozen.ceiling(key), tree.ceiling(key));
+            }
+            else
+            {
+                EXPECT_THROW(frozen.ceiling(key), std::out_of_range);
+            }
+        }
+    }
+}
+
+TEST(FrozenMapOperations, OrderedQueriesAndIteration)
+{
+    Map<std::string, int> tree{{"pear", 1}, {"apple", 2}, {"fig", 3}, {"kiwi", 4}};
+    FrozenMap<std::string, int> frozen = tree.freeze();
+
+    // The frozen copy does not follow later writes
+    tree.insert({"banana", 5});
+    EXPECT_FALSE(frozen.contains("banana"));
+
+    EXPECT_EQ(frozen.min(), "apple");
+    EXPECT_EQ(frozen.max(), "pear");
+    EXPECT_EQ(frozen.rankSelect(2), "kiwi");
+    EXPECT_THROW(frozen.rankSelect(4), std::out_of_range);
+    EXPECT_EQ(frozen.floor("grape"), "fig");
+    EXPECT_EQ(frozen.ceiling("grape"), "kiwi");
+    EXPECT_EQ(frozen.at("fig"), 3);
+
+    std::vector<std::pair<std::string, int>> seen(frozen.begin(), frozen.end());
+    std::vector<std::pair<std::string, int>> wanted{{"apple", 2}, {"fig", 3}, {"kiwi", 4}, {"pear", 1}};
+    EXPECT_EQ(seen, wanted);
+    auto it = frozen.begin();
+    ++it;
+    EXPECT_EQ(it->first, "fig");
+    EXPECT_EQ((*it++).second, 3);
+    EXPECT_EQ(it->second, 4);
+
+    FrozenMap<std::string, int> empty;
+    EXPECT_TRUE(empty.begin() == empty.end());
+    EXPECT_TRUE(empty.empty());
+    EXPECT_FALSE(empty.contains("fig"));
+    EXPECT_THROW(empty.at("fig"), std::out_of_range);
+    EXPECT_THROW(empty.min(), std::out_of_range);
+    EXPECT_THROW(empty.rank("fig"), std::out_of_range);
+}
+
+TEST(FrozenMapOperations, RejectsUnsortedInput)
+{
+    std::vector<std::pair<int, int>> unsorted{{1, 1}, {3, 3}, {2, 2}};
+    EXPECT_THROW((FrozenMap<int, int>(unsorted)), std::invalid_argument);
+    std::vector<std::pair<int, int>> duplicate{{1, 1}, {1, 2}};
+    EXPECT_THROW((FrozenMap<int, int>(duplicate)), std::invalid_argument);
+}
+
+TEST(FrozenSetOperations, MatchesReferenceSet)
+{
+    Set<int, std::greater<int>> tree;
+    std::set<int, std::greater<int>> reference;
+    for (int i = 0; i < 5000; i++)
+    {
+        int key = (i * 7919) % 10007;
+        tree.insert(key);
+        reference.insert(key);
+    }
+    FrozenSet<int, std::greater<int>> frozen = tree.freeze();
+
+    std::vector<int> seen(frozen.begin(), frozen.end());
+    std::vector<int> wanted(reference.begin(), reference.end());
+    EXPECT_EQ(seen, wanted);
+
+    for (int key = -5; key < 10012; key++)
+    {
+        EXPECT_EQ(frozen.contains(key), reference.count(key) == 1);
+        auto lower = reference.lower_bound(key);
+        EXPECT_EQ(frozen.rank(key), std::distance(reference.begin(), lower));
+        if (lower != reference.end())
+        {
+            EXPECT_EQ(frozen.ceiling(key), *lower);
+        }
+    }
+    EXPECT_EQ(frozen.min(), *reference.begin());
+    EXPECT_EQ(frozen.floor(-1), 0);
+    EXPECT_EQ(frozen.rankSelect(100), *std::next(reference.begin(), 100));
+
+    FrozenSet<int> empty;
+    EXPECT_TRUE(empty.begin() == empty.end());
+    EXPECT_FALSE(empty.contains(0));
+}
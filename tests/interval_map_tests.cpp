@@ -0,0 +1,136 @@
+/**interval_map_tests.cpp
+ *
+ * Unit tests for the interval map
+ */
+
+#include <gtest/gtest.h>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "interval_map.hpp"
+
+using Entry = std::pair<std::pair<int, int>, int>;
+
+// Brute force over a reference map with the same ordering
+static std::vector<Entry> overlapsOf(const std::map<std::pair<int, int>, int> &reference, int a, int b)
+{
+    std::vector<Entry> result;
+    for (const auto &entry : reference)
+        if (entry.first.first < b && a < entry.first.second)
+            result.push_back(entry);
+    return result;
+}
+
+TEST(IntervalMapOperations, InsertEraseAndLookup)
+{
+    IntervalMap<int, int, std::string> tree{{{1, 5}, "a"}, {{3, 4}, "b"}, {{1, 2}, "c"}};
+    EXPECT_EQ(tree.size(), 3);
+    EXPECT_EQ(tree.at(3, 4), "b");
+    EXPECT_TRUE(tree.contains(1, 2));
+    EXPECT_FALSE(tree.contains(1, 3));
+
+    tree.insert({{3, 4}, "d"});
+    EXPECT_EQ(tree.size(), 3);
+    EXPECT_EQ(tree.at(3, 4), "d");
+
+    tree.erase(1, 5);
+    EXPECT_EQ(tree.size(), 2);
+    EXPECT_THROW(tree.erase(1, 5), std::out_of_range);
+    EXPECT_THROW(tree.at(1, 5), std::out_of_range);
+    EXPECT_THROW(tree.insert({{6, 6}, "empty"}), std::invalid_argument);
+    EXPECT_THROW(tree.insert({{7, 6}, "reversed"}), std::invalid_argument);
+
+    std::vector<std::pair<int, int>> order;
+    for (const auto &entry : tree)
+        order.push_back(entry.first);
+    EXPECT_EQ(order, (std::vector<std::pair<int, int>>{{1, 2}, {3, 4}}));
+}
+
+TEST(IntervalMapOperations, HalfOpenBounds)
+{
+    IntervalMap<int, int, int> tree{{{10, 20}, 1}, {{20, 30}, 2}};
+
+    EXPECT_FALSE(tree.overlaps(0, 10));
+    EXPECT_TRUE(tree.overlaps(0, 11));
+    EXPECT_FALSE(tree.overlaps(30, 40));
+    EXPECT_TRUE(tree.overlaps(19, 20));
+    EXPECT_EQ(tree.overlapping(19, 21).size(), 2);
+    EXPECT_EQ(tree.overlapping(20, 21).size(), 1);
+
+    std::vector<Entry> atBoundary = tree.stab(20);
+    ASSERT_EQ(atBoundary.size(), 1);
+    EXPECT_EQ(atBoundary[0].second, 2);
+    EXPECT_TRUE(tree.stab(30).empty());
+    EXPECT_EQ(tree.stab(10).size(), 1);
+
+    IntervalMap<int, int, int> none;
+    EXPECT_FALSE(none.overlaps(0, 100));
+    EXPECT_TRUE(none.stab(0).empty());
+}
+
+TEST(IntervalMapOperations, MatchesBruteForce)
+{
+    IntervalMap<int, int, int> tree;
+    std::map<std::pair<int, int>, int> reference;
+
+    for (int i = 0; i < 20000; i++)
+    {
+        int lo = (i * 7919) % 5003;
+        int hi = lo + 1 + (i * 104729) % 97;
+        if (i % 3 == 2 && !reference.empty())
+        {
+            auto victim = reference.lower_bound({lo, 0});
+            if (victim == reference.end())
+                victim = reference.begin();
+            tree.erase(victim->first.first, victim->first.second);
+            reference.erase(victim);
+        }
+        else
+        {
+            tree.insert({{lo, hi}, i});
+            reference[{lo, hi}] = i;
+        }
+    }
+
+    EXPECT_EQ(tree.size(), reference.size());
+    std::vector<Entry> seen(tree.begin(), tree.end());
+    std::vector<Entry> wanted(reference.begin(), reference.end());
+    EXPECT_EQ(seen, wanted);
+
+    for (int a = -50; a < 5200; a += 13)
+    {
+        for (int width : {1, 5, 40, 300})
+        {
+            std::vector<Entry> expected = overlapsOf(reference, a, a + width);
+            EXPECT_EQ(tree.overlapping(a, a + width), expected);
+            EXPECT_EQ(tree.overlaps(a, a + width), !expected.empty());
+        }
+        EXPECT_EQ(tree.stab(a), overlapsOf(reference, a, a + 1));
+    }
+}
+
+TEST(IntervalMapOperations, CopyAndMove)
+{
+    IntervalMap<int, int, int> tree;
+    for (int i = 0; i < 500; i++)
+        tree.insert({{i, i + 10}, i});
+
+    IntervalMap<int, int, int> copy(tree);
+    tree.erase(5, 15);
+    EXPECT_TRUE(copy.contains(5, 15));
+    EXPECT_EQ(copy.stab(14).size(), 10);
+    EXPECT_EQ(tree.stab(14).size(), 9);
+
+    IntervalMap<int, int, int> moved(std::move(copy));
+    EXPECT_TRUE(copy.empty());
+    EXPECT_EQ(moved.size(), 500);
+
+    copy = tree;
+    EXPECT_EQ(copy.size(), 499);
+    moved = std::move(tree);
+    EXPECT_EQ(moved.size(), 499);
+    EXPECT_FALSE(moved.overlaps(-10, 0));
+}
@@ -0,0 +1,193 @@
+/**multi_tests.cpp
+ *
+ * Unit tests for the multimap and the multiset
+ */
+
+#include <gtest/gtest.h>
+#include <iterator>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "multi_map.hpp"
+#include "multi_set.hpp"
+
+TEST(MultiMapOperations, DuplicatesKeepInsertionOrder)
+{
+    MultiMap<int, std::string> tree{{1, "a"}, {2, "b"}, {1, "c"}, {0, "d"}, {1, "e"}};
+    EXPECT_EQ(tree.size(), 5);
+    EXPECT_EQ(tree.count(1), 3);
+    EXPECT_EQ(tree.count(3), 0);
+    EXPECT_EQ(tree.rank(1), 1);
+    EXPECT_EQ(tree.rank(2), 4);
+    EXPECT_EQ(tree.rankSelect(3), 1);
+    EXPECT_EQ(tree.min(), 0);
+    EXPECT_EQ(tree.max(), 2);
+
+    std::vector<std::string> copies;
+    auto range = tree.equal_range(1);
+    for (auto it = range.first; it != range.second; ++it)
+        copies.push_back(it->second);
+    EXPECT_EQ(copies, (std::vector<std::string>{"a", "c", "e"}));
+    EXPECT_EQ(tree.lower_bound(3), tree.end());
+    EXPECT_EQ(tree.upper_bound(-1)->second, "d");
+
+    tree.eraseOne(1);
+    EXPECT_EQ(tree.equal_range(1).first->second, "c");
+    EXPECT_EQ(tree.erase(1), 2);
+    EXPECT_FALSE(tree.contains(1));
+    EXPECT_THROW(tree.erase(1), std::out_of_range);
+    EXPECT_THROW(tree.eraseOne(1), std::out_of_range);
+    EXPECT_THROW(tree.rankSelect(2), std::out_of_range);
+    EXPECT_EQ(tree.size(), 2);
+}
+
+TEST(MultiMapOperations, MatchesReferenceMultimap)
+{
+    MultiMap<int, int> tree;
+    std::multimap<int, int> reference;
+
+    for (int i = 0; i < 40000; i++)
+    {
+        int key = (i * 7919) % 1009;
+        if (i % 7 == 3 && reference.count(key) > 0)
+        {
+            reference.erase(reference.lower_bound(key));
+            tree.eraseOne(key);
+        }
+        else if (i % 97 == 5 && reference.count(key) > 0)
+        {
+            EXPECT_EQ(tree.erase(key), reference.erase(key));
+        }
+        else
+        {
+            tree.insert({key, i});
+            reference.insert({key, i});
+        }
+    }
+
+    EXPECT_EQ(tree.size(), reference.size());
+    std::vector<std::pair<int, int>> seen(tree.begin(), tree.end());
+    std::vector<std::pair<int, int>> wanted(reference.begin(), reference.end());
+    EXPECT_EQ(seen, wanted);
+
+    for (int key = -1; key <= 1010; key++)
+    {
+        EXPECT_EQ(tree.count(key), reference.count(key));
+        EXPECT_EQ(tree.rank(key), std::distance(reference.begin(), reference.lower_bound(key)));
+
+        auto range = tree.equal_range(key);
+        std::vector<std::pair<int, int>> rangeSeen(range.first, range.second);
+        auto wantedRange = reference.equal_range(key);
+        std::vector<std::pair<int, int>> rangeWanted(wantedRange.first, wantedRange.second);
+        EXPECT_EQ(rangeSeen, rangeWanted);
+    }
+
+    // Copies and moves keep the order of the duplicates
+    MultiMap<int, int> copy(tree);
+    MultiMap<int, int> moved(std::move(tree));
+    EXPECT_TRUE(tree.empty());
+    std::vector<std::pair<int, int>> copied(copy.begin(), copy.end());
+    EXPECT_EQ(copied, wanted);
+    tree = moved;
+    moved = std::move(copy);
+    EXPECT_EQ(tree.size(), moved.size());
+}
+
+// Runs of every length are split out whole; the trees left behind must
+// still take inserts and single erasures
+TEST(MultiMapOperations, EraseLongRunsOfCopies)
+{
+    MultiMap<int, int> tree;
+    std::multimap<int, int> reference;
+    for (int key = 0; key < 200; key++)
+        for (int copy = 0; copy < key * 13 % 71 + 1; copy++)
+        {
+            tree.insert({key, copy});
+            reference.insert({key, copy});
+        }
+
+    for (int key = 0; key < 200; key += 3)
+        EXPECT_EQ(tree.erase(key), reference.erase(key));
+    for (int i = 0; i < 2000; i++)
+    {
+        tree.insert({i % 211, i});
+        reference.insert({i % 211, i});
+    }
+    for (int key = 1; key < 211; key += 2)
+    {
+        reference.erase(reference.lower_bound(key));
+        tree.eraseOne(key);
+    }
+    for (int key = 200; key >= 0; key -= 4)
+        EXPECT_EQ(tree.erase(key), reference.erase(key));
+
+    EXPECT_EQ(tree.size(), reference.size());
+    std::vector<std::pair<int, int>> seen(tree.begin(), tree.end());
+    std::vector<std::pair<int, int>> wanted(reference.begin(), reference.end());
+    EXPECT_EQ(seen, wanted);
+    for (int key = 0; key < 211; key++)
+        EXPECT_EQ(tree.rank(key), std::distance(reference.begin(), reference.lower_bound(key)));
+
+    // Emptying the tree in one erase leaves it usable
+    MultiSet<int> copies;
+    for (int i = 0; i < 5000; i++)
+        copies.insert(7);
+    EXPECT_EQ(copies.erase(7), 5000);
+    EXPECT_TRUE(copies.empty());
+    copies.insert(3);
+    EXPECT_EQ(copies.count(3), 1);
+}
+
+// Orders by the first member only, so equivalent keys can be told apart
+struct FirstLess
+{
+    bool operator()(const std::pair<int, int> &a, const std::pair<int, int> &b) const
+    {
+        return a.first < b.first;
+    }
+};
+
+TEST(MultiSetOperations, MatchesReferenceMultiset)
+{
+    MultiSet<std::pair<int, int>, FirstLess> tree;
+    std::multiset<std::pair<int, int>, FirstLess> reference;
+
+    for (int i = 0; i < 30000; i++)
+    {
+        std::pair<int, int> key((i * 7919) % 503, i);
+        if (i % 5 == 1 && reference.count(key) > 0)
+        {
+            reference.erase(reference.lower_bound(key));
+            tree.eraseOne(key);
+        }
+        else if (i % 113 == 7 && reference.count(key) > 0)
+        {
+            EXPECT_EQ(tree.erase(key), reference.erase(key));
+        }
+        else
+        {
+            tree.insert(key);
+            reference.insert(key);
+        }
+    }
+
+    EXPECT_EQ(tree.size(), reference.size());
+    std::vector<std::pair<int, int>> seen(tree.begin(), tree.end());
+    std::vector<std::pair<int, int>> wanted(reference.begin(), reference.end());
+    EXPECT_EQ(seen, wanted);
+
+    for (int first = 0; first < 503; first += 3)
+    {
+        std::pair<int, int> key(first, 0);
+        EXPECT_EQ(tree.count(key), reference.count(key));
+        EXPECT_EQ(tree.rank(key), std::distance(reference.begin(), reference.lower_bound(key)));
+        EXPECT_EQ(tree.upper_bound(key) == tree.end(), reference.upper_bound(key) == reference.end());
+    }
+
+    for (int i = 0; i < static_cast<int>(tree.size()); i += 101)
+        EXPECT_EQ(tree.rankSelect(i), *std::next(reference.begin(), i));
+}
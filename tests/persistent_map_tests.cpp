@@ -0,0 +1,171 @@
+/**persistent_map_tests.cpp
+ *
+ * Unit tests for the persistent map
+ */
+
+#include <gtest/gtest.h>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "persistent_map.hpp"
+
+// Counts node allocations made through any copy of the allocator
+static size_t allocations = 0;
+
+template <typename T>
+class CountingAllocator
+{
+public:
+    using value_type = T;
+
+    CountingAllocator() {}
+    template <typename U>
+    CountingAllocator(const CountingAllocator<U> &) {}
+
+    T *allocate(size_t n)
+    {
+        allocations += n;
+        return std::allocator<T>().allocate(n);
+    }
+
+    void deallocate(T *p, size_t n)
+    {
+        std::allocator<T>().deallocate(p, n);
+    }
+
+    bool operator==(const CountingAllocator &) const { return true; }
+    bool operator!=(const CountingAllocator &) const { return false; }
+};
+
+TEST(PersistentMapOperations, InsertEraseAndLookup)
+{
+    PersistentMap<int, int> tree{{3, 30}, {1, 10}, {2, 20}};
+    EXPECT_EQ(tree.size(), 3);
+    EXPECT_EQ(tree.at(2), 20);
+
+    tree.insert({2, 200});
+    tree.erase(1);
+    EXPECT_EQ(tree.at(2), 200);
+    EXPECT_FALSE(tree.contains(1));
+    EXPECT_THROW(tree.erase(1), std::out_of_range);
+    EXPECT_THROW(tree.at(1), std::out_of_range);
+
+    EXPECT_EQ(tree.min(), 2);
+    EXPECT_EQ(tree.max(), 3);
+    EXPECT_EQ(tree.floor(5), 3);
+    EXPECT_EQ(tree.ceiling(0), 2);
+    EXPECT_EQ(tree.rank(3), 1);
+    EXPECT_EQ(tree.rankSelect(0), 2);
+}
+
+TEST(PersistentMapOperations, VersionsAreIndependent)
+{
+    PersistentMap<int, int> tree;
+    std::map<int, int> reference;
+    std::vector<PersistentMap<int, int>> versions;
+    std::vector<std::map<int, int>> expected;
+
+    for (int i = 0; i < 3000; i++)
+    {
+        int key = (i * 7919) % 1000;
+        if (i % 3 == 2 && tree.contains(key))
+        {
+            tree.erase(key);
+            reference.erase(key);
+        }
+        else
+        {
+            tree.insert({key, i});
+            reference[key] = i;
+        }
+
+        if (i % 100 == 0)
+        {
+            versions.push_back(tree);
+            expected.push_back(reference);
+        }
+    }
+
+    // Every checkpoint still holds what it held when it was taken
+    for (size_t i = 0; i < versions.size(); i++)
+    {
+        std::vector<std::pair<int, int>> seen(versions[i].begin(), versions[i].end());
+        std::vector<std::pair<int, int>> wanted(expected[i].begin(), expected[i].end());
+        EXPECT_EQ(seen, wanted);
+    }
+
+    // Rolling back is an O(1) assignment
+    tree = versions[10];
+    EXPECT_TRUE(tree == versions[10]);
+    tree.insert({-1, -1});
+    EXPECT_TRUE(tree != versions[10]);
+    EXPECT_FALSE(versions[10].contains(-1));
+}
+
+TEST(PersistentMapOperations, WritesCopyOnlyOnePath)
+{
+    using Tree = PersistentMap<int, int, std::less<int>, CountingAllocator<std::pair<int, int>>>;
+    Tree tree;
+    for (int i = 0; i < 1 << 16; i++)
+        tree.insert({i, i});
+
+    // Unshared nodes are updated in place
+    allocations = 0;
+    tree.insert({100, -100});
+    tree.erase(200);
+    EXPECT_EQ(allocations, 0);
+
+    // Copying allocates nothing; a write after it copies O(log n) nodes
+    Tree checkpoint(tree);
+    EXPECT_EQ(allocations, 0);
+    tree.insert({300, -300});
+    size_t pathCopies = allocations;
+    EXPECT_GT(pathCopies, 0);
+    EXPECT_LE(pathCopies, 40);
+
+    // Nodes copied by that write now belong to this version only
+    allocations = 0;
+    tree.insert({300, 3});
+    EXPECT_EQ(allocations, 0);
+
+    tree.erase(400);
+    EXPECT_GT(allocations, 0);
+    EXPECT_LE(allocations, 80);
+    EXPECT_EQ(tree.at(300), 3);
+    EXPECT_EQ(checkpoint.at(300), 300);
+    EXPECT_TRUE(checkpoint.contains(400));
+}
+
+TEST(PersistentMapOperations, VersionsOnSeparateThreads)
+{
+    using Tree = PersistentMap<int, int, std::less<int>, std::allocator<std::pair<int, int>>>;
+    Tree base;
+    for (int i = 0; i < 4096; i++)
+        base.insert({i, i});
+
+    // Each thread branches off the shared base, writes and drops its versions
+    std::vector<std::thread> writers;
+    std::vector<int> mismatches(4, 0);
+    for (int t = 0; t < 4; t++)
+        writers.emplace_back([&base, &mismatches, t]()
+                             {
+            for (int round = 0; round < 50; round++)
+            {
+                Tree version(base);
+                for (int i = t; i < 4096; i += 64)
+                    version.insert({i, -i});
+                Tree older(version);
+                for (int i = t + 32; i < 4096; i += 64)
+                    version.erase(i);
+                mismatches[t] += version.size() != 4096 - 64 || older.size() != 4096 || older.at(t) != -t;
+            } });
+    for (std::thread &writer : writers)
+        writer.join();
+
+    EXPECT_EQ(mismatches, std::vector<int>(4, 0));
+    EXPECT_EQ(base.size(), 4096);
+    EXPECT_EQ(base.at(5), 5);
+}
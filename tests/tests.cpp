@@ -4,9 +4,16 @@
  */
 
 #include <gtest/gtest.h>
+#include <cstdio>
+#include <sstream>
 #include <stdexcept>
+#include <string>
 #include <random>
 #include <iostream>
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <vector>
 
 #include "map.hpp"
 #include "set.hpp"
@@ -436,10 +443,892 @@ TEST(MapOperations, TreeDeepCopyStressTest)
     EXPECT_TRUE(!tree2.empty());
 }
 
+TEST(MapOperations, StdAllocatorMixedInsertErase)
+{
+    Map<int, int, std::less<int>, std::allocator<std::pair<int, int>>> tree;
+    for (int i = 0; i < 1000; i++)
+        tree.insert({i, i});
+    for (int i = 0; i < 1000; i += 2)
+        tree.erase(i);
+
+    EXPECT_EQ(tree.size(), 500);
+    EXPECT_TRUE(tree.contains(1));
+    EXPECT_FALSE(tree.contains(0));
+
+    auto treeCopy = tree;
+    EXPECT_EQ(treeCopy, tree);
+}
+
+TEST(MapOperations, SharedPoolAllocator)
+{
+    PoolAllocator<std::pair<int, int>> pool;
+    Map<int, int> tree1(pool);
+    Map<int, int> tree2(pool);
+
+    // Freed nodes of one tree are recycled by the other
+    for (int i = 0; i < STRESS_TEST_SAMPLE_COUNT; i++)
+        tree1.insert({i, i});
+    while (!tree1.empty())
+        tree1.erase(tree1.min());
+    for (int i = 0; i < STRESS_TEST_SAMPLE_COUNT; i++)
+        tree2.insert({i, -i});
+
+    EXPECT_TRUE(tree1.empty());
+    EXPECT_EQ(tree2.size(), STRESS_TEST_SAMPLE_COUNT);
+    EXPECT_EQ(tree2.at(42), -42);
+
+    // Copies allocate from a pool of their own
+    Map<int, int> tree3 = tree2;
+    tree2.erase(42);
+    EXPECT_EQ(tree3.at(42), -42);
+    EXPECT_TRUE(tree2.depth() <= STRESS_TEST_LG2 + STRESS_TEST_LG2); // Depth <= 2lgN
+}
+
+TEST(MapOperations, LazyPoolAllocator)
+{
+    // Unused allocators have no pool and only equal themselves
+    PoolAllocator<int> a, b;
+    EXPECT_TRUE(a == a);
+    EXPECT_TRUE(a != b);
+
+    // Copies and rebinds share the pool, moves hand it over
+    PoolAllocator<int> copy(a);
+    PoolAllocator<long> rebound(a);
+    EXPECT_TRUE(copy == a);
+    EXPECT_TRUE(rebound == a);
+    EXPECT_TRUE(a != b);
+
+    PoolAllocator<int> moved(std::move(copy));
+    EXPECT_TRUE(moved == a);
+
+    int *node = moved.allocate(1);
+    *node = 7;
+    a.deallocate(node, 1);
+    EXPECT_EQ(a.allocate(1), node); // Recycled through the shared free list
+
+    Map<int, int> tree;
+    Map<int, int> moveTarget(std::move(tree));
+    moveTarget.insert({1, 1});
+    tree.insert({2, 2});
+    EXPECT_EQ(moveTarget.at(1), 1);
+    EXPECT_EQ(tree.at(2), 2);
+}
+
+TEST(MapOperations, CopyAssignmentKeepsAllocator)
+{
+    PoolAllocator<std::pair<int, int>> pool;
+    Map<int, int> a(pool), b(pool), other;
+    other.insert({1, 1});
+    b.insert({2, 2});
+
+    // The copy is made on the pool of a, so nodes still move between a and b
+    a = other;
+    a.join(std::move(b));
+    EXPECT_TRUE(b.empty());
+    EXPECT_EQ(a.size(), 2);
+}
+
+TEST(MapOperations, EraseKeepsOtherIteratorsValid)
+{
+    Map<int, std::string> tree;
+    for (int i = 0; i < 100; i++)
+        tree[i] = std::to_string(i);
+
+    // Erasing an internal node must not move its successor's payload
+    auto it = tree.find(51);
+    for (int i = 0; i < 100; i += 2)
+        tree.erase(i);
+
+    EXPECT_EQ(it->first, 51);
+    EXPECT_EQ(it->second, "51");
+    ++it;
+    EXPECT_EQ(it->first, 53);
+    EXPECT_EQ(tree.size(), 50);
+}
+
+TEST(MapOperations, FromSortedStressTest)
+{
+    std::vector<std::pair<int, int>> sorted;
+    for (int i = 0; i < STRESS_TEST_SAMPLE_COUNT; i++)
+        sorted.push_back({i, -i});
+
+    Map<int, int> tree = Map<int, int>::fromSorted(sorted.begin(), sorted.end());
+    EXPECT_EQ(tree.size(), STRESS_TEST_SAMPLE_COUNT);
+    EXPECT_TRUE(tree.depth() <= STRESS_TEST_LG2 + STRESS_TEST_LG2); // Depth <= 2lgN
+    EXPECT_EQ(tree.rank(5000), 5000);
+    EXPECT_EQ(tree.rankSelect(777), 777);
+    EXPECT_EQ(tree.at(42), -42);
+
+    // The result is a regular tree that supports further mutation
+    for (int i = 0; i < STRESS_TEST_SAMPLE_COUNT; i += 2)
+        tree.erase(i);
+    tree.insert({-1, 1});
+    EXPECT_EQ(tree.size(), STRESS_TEST_SAMPLE_COUNT / 2 + 1);
+    EXPECT_EQ(tree.min(), -1);
+    EXPECT_TRUE(tree.depth() <= STRESS_TEST_LG2 + STRESS_TEST_LG2); // Depth <= 2lgN
+}
+
+TEST(MapOperations, FromSortedRejectsUnsortedInput)
+{
+    std::vector<std::pair<int, int>> unsorted{{1, 1}, {3, 3}, {2, 2}};
+    std::vector<std::pair<int, int>> duplicated{{1, 1}, {1, 2}};
+    EXPECT_THROW((Map<int, int>::fromSorted(unsorted.begin(), unsorted.end())), std::invalid_argument);
+    EXPECT_THROW((Map<int, int>::fromSorted(duplicated.begin(), duplicated.end())), std::invalid_argument);
+
+    std::vector<std::pair<int, int>> empty;
+    EXPECT_TRUE((Map<int, int>::fromSorted(empty.begin(), empty.end())).empty());
+}
+
+// Counts copies to verify that payloads are moved or built in place
+struct CopyCounter
+{
+    static int copies;
+    std::string payload;
+
+    CopyCounter() {}
+    CopyCounter(const std::string &str) : payload(str) {}
+    CopyCounter(const std::string &str, int repeat)
+    {
+        for (int i = 0; i < repeat; i++)
+            payload += str;
+    }
+    CopyCounter(const CopyCounter &that) : payload(that.payload) { copies++; }
+    CopyCounter(CopyCounter &&that) : payload(std::move(that.payload)) {}
+    CopyCounter &operator=(const CopyCounter &that)
+    {
+        payload = that.payload;
+        copies++;
+        return *this;
+    }
+    CopyCounter &operator=(CopyCounter &&that)
+    {
+        payload = std::move(that.payload);
+        return *this;
+    }
+};
+
+int CopyCounter::copies = 0;
+
+Map<int, CopyCounter> buildCopyCounterMap(int n)
+{
+    Map<int, CopyCounter> tree;
+    for (int i = 0; i < n; i++)
+        tree.try_emplace(i, "value" + std::to_string(i));
+    return tree;
+}
+
+TEST(MapOperations, MoveSemanticsAvoidCopies)
+{
+    CopyCounter::copies = 0;
+
+    Map<int, CopyCounter> tree1 = buildCopyCounterMap(100);
+    tree1.insert({100, CopyCounter("value100")});
+    tree1.insert(std::pair<int, CopyCounter>(5, CopyCounter("five")));
+    tree1[101] = CopyCounter("value101");
+    EXPECT_EQ(CopyCounter::copies, 0);
+
+    Map<int, CopyCounter> tree2(std::move(tree1));
+    EXPECT_TRUE(tree1.empty());
+    EXPECT_EQ(tree2.size(), 102);
+    EXPECT_EQ(tree2.at(5).payload, "five");
+    EXPECT_EQ(CopyCounter::copies, 1); // at() returns a copy
+
+    // Moved-from maps remain usable
+    tree1.insert({1, CopyCounter("one")});
+    tree1 = std::move(tree2);
+    EXPECT_EQ(tree1.size(), 102);
+    EXPECT_EQ(tree1[101].payload, "value101");
+    EXPECT_EQ(CopyCounter::copies, 1);
+}
+
+TEST(MapOperations, EmplaceAndTryEmplace)
+{
+    Map<std::string, CopyCounter> tree;
+
+    auto result = tree.emplace("key", CopyCounter("abc"));
+    EXPECT_TRUE(result.second);
+    EXPECT_EQ(result.first->first, "key");
+
+    // Neither overwrites an existing key
+    result = tree.emplace("key", CopyCounter("def"));
+    EXPECT_FALSE(result.second);
+    EXPECT_EQ(result.first->second.payload, "abc");
+
+    result = tree.try_emplace("key", "ghi", 2);
+    EXPECT_FALSE(result.second);
+    EXPECT_EQ(tree["key"].payload, "abc");
+
+    result = tree.try_emplace("other", "ab", 3);
+    EXPECT_TRUE(result.second);
+    EXPECT_EQ(result.first->second.payload, "ababab");
+    EXPECT_EQ(tree.size(), 2);
+}
+
 /**
  * Symbol table operations
  */
 
+TEST(MapOperations, SetAlgebraStressTest)
+{
+    srand(23);
+    for (int round = 0; round < 50; round++)
+    {
+        Map<int, int> tree1, tree2;
+        std::map<int, int> ref1, ref2;
+        for (int i = 0; i < 1000; i++)
+        {
+            int key1 = rand() % 3000, key2 = rand() % 3000;
+            tree1[key1] = ref1[key1] = i;
+            tree2[key2] = ref2[key2] = -i;
+        }
+
+        std::map<int, int> expected;
+        if (round % 3 == 0)
+        {
+            expected = ref1;
+            for (auto &entry : ref2)
+                expected[entry.first] = entry.second;
+            tree1.unionWith(tree2);
+        }
+        else if (round % 3 == 1)
+        {
+            for (auto &entry : ref1)
+                if (ref2.count(entry.first))
+                    expected.insert(entry);
+            tree1.intersect(tree2);
+        }
+        else
+        {
+            for (auto &entry : ref1)
+                if (!ref2.count(entry.first))
+                    expected.insert(entry);
+            tree1.difference(tree2);
+        }
+
+        EXPECT_EQ(tree2.size(), ref2.size());
+        ASSERT_EQ(tree1.size(), expected.size());
+        std::vector<std::pair<int, int>> actual(tree1.begin(), tree1.end());
+        std::vector<std::pair<int, int>> reference(expected.begin(), expected.end());
+        EXPECT_TRUE(actual == reference);
+        EXPECT_TRUE(tree1.depth() <= 2 * STRESS_TEST_LG2);
+        for (auto &entry : expected)
+            EXPECT_EQ(tree1.rankSelect(tree1.rank(entry.first)), entry.first);
+    }
+}
+
+TEST(MapOperations, UnionRelinksNodesOfSharedPool)
+{
+    PoolAllocator<std::pair<int, int>> pool;
+    Map<int, int> tree1(pool);
+    Map<int, int> tree2(pool);
+    for (int i = 0; i < STRESS_TEST_SAMPLE_COUNT; i++)
+    {
+        if (i % 2 == 0)
+            tree1[i] = i;
+        if (i % 3 == 0)
+            tree2[i] = -i;
+    }
+
+    // Nodes of both trees survive, so iterators into either stay valid
+    auto kept = tree1.find(4);
+    auto moved = tree2.find(9);
+    tree1.unionWith(std::move(tree2));
+
+    EXPECT_TRUE(tree2.empty());
+    EXPECT_EQ(tree1.size(), STRESS_TEST_SAMPLE_COUNT - STRESS_TEST_SAMPLE_COUNT / 3);
+    EXPECT_EQ(kept->first, 4);
+    EXPECT_EQ(++kept, tree1.find(6));
+    EXPECT_EQ(moved->first, 9);
+    EXPECT_EQ(tree1.at(6), -6);
+    EXPECT_EQ(tree1.at(8), 8);
+}
+
+TEST(MapOperations, NodeHandlesRelinkWithoutAllocation)
+{
+    using CountingMap = Map<int, std::string, std::less<int>, PoolAllocator<std::pair<int, std::string>>, CountingStats>;
+    PoolAllocator<std::pair<int, std::string>> pool;
+    CountingMap hot(pool);
+    CountingMap cold(pool);
+    for (int i = 0; i < 1000; i++)
+        hot.insert({i, std::string(40, 'a' + i % 26)});
+    hot.resetStats();
+
+    // The payload stays where it is while its node changes trees
+    const std::string *payload = &hot.find(7)->second;
+    CountingMap::node_type handle = hot.extract(7);
+    EXPECT_EQ(handle.key(), 7);
+    EXPECT_FALSE(hot.contains(7));
+    EXPECT_EQ(hot.size(), 999);
+    handle.key() = 2000;
+    EXPECT_TRUE(cold.insert(std::move(handle)).second);
+    EXPECT_TRUE(handle.empty());
+    EXPECT_EQ(&cold.find(2000)->second, payload);
+
+    // An existing key wins, and the handle keeps its node
+    cold.insert({8, "kept"});
+    handle = hot.extract(hot.find(8));
+    auto result = cold.insert(std::move(handle));
+    EXPECT_FALSE(result.second);
+    EXPECT_EQ(result.first->second, "kept");
+    EXPECT_EQ(handle.mapped(), std::string(40, 'i'));
+
+    // Keys present on both sides stay behind in the source
+    cold.insert({9, "also kept"});
+    cold.resetStats();
+    cold.merge(hot);
+    EXPECT_EQ(hot.size(), 1);
+    EXPECT_EQ(hot.at(9), std::string(40, 'j'));
+    EXPECT_EQ(cold.size(), 1000);
+    EXPECT_EQ(cold.at(9), "also kept");
+    EXPECT_EQ(hot.stats().deallocations + cold.stats().allocations, 0);
+    for (int i = 0; i < 999; i++)
+        EXPECT_EQ(cold.rankSelect(i), i < 7 ? i : i + 1);
+    EXPECT_EQ(cold.rankSelect(999), 2000);
+    EXPECT_TRUE(cold.depth() <= 2 * 10);
+
+    EXPECT_THROW(hot.extract(7), std::out_of_range);
+    EXPECT_THROW(hot.extract(hot.end()), std::out_of_range);
+    EXPECT_THROW(CountingMap::node_type().key(), std::out_of_range);
+}
+
+TEST(MapOperations, NodeHandlesAcrossAllocatorsAndPolicies)
+{
+    // Separate pools: the pairs are moved into new nodes instead
+    Map<int, int> source;
+    Map<int, int> target;
+    for (int i = 0; i < 100; i++)
+        source.insert({i, i});
+    target.insert(source.extract(50));
+    target.insert({60, -60});
+    target.merge(source);
+    EXPECT_EQ(source.size(), 1);
+    EXPECT_EQ(source.at(60), 60);
+    EXPECT_EQ(target.size(), 100);
+    EXPECT_EQ(target.at(60), -60);
+
+    // Summaries are rebuilt for the new position of a node
+    PoolAllocator<std::pair<int, int>> pool;
+    Map<int, int, std::less<int>, PoolAllocator<std::pair<int, int>>, NoStats, Aggregate<SumMonoid<int>>> sums(pool), others(pool);
+    for (int i = 0; i < 100; i++)
+        (i % 2 == 0 ? sums : others).insert({i, i});
+    auto handle = others.extract(51);
+    handle.mapped() = 1000;
+    sums.insert(std::move(handle));
+    EXPECT_EQ(sums.rangeAggregate(0, 100), 2450 + 1000);
+    sums.merge(others);
+    EXPECT_EQ(sums.rangeAggregate(0, 100), 4950 - 51 + 1000);
+    EXPECT_EQ(sums.prefixAggregate(52), 1326 - 51 + 1000);
+
+    Map<int, int, std::less<int>, PoolAllocator<std::pair<int, int>>, NoStats, NoOrderStatistics> unsized(pool), more(pool);
+    for (int i = 0; i < 100; i++)
+        (i < 70 ? unsized : more).insert({i, i});
+    more.insert(unsized.extract(3));
+    unsized.merge(more);
+    EXPECT_EQ(unsized.size(), 100);
+    EXPECT_TRUE(more.empty());
+}
+
+TEST(MapOperations, HintedInsertAndAppend)
+{
+    Map<int, int, std::less<int>, PoolAllocator<std::pair<int, int>>, CountingStats> tree;
+    for (int i = 0; i < STRESS_TEST_SAMPLE_COUNT; i += 2)
+        tree.append({i, i});
+    TreeStats stats = tree.stats();
+    EXPECT_LE(stats.comparisons, STRESS_TEST_SAMPLE_COUNT / 2);
+    EXPECT_EQ(stats.insert.operations, STRESS_TEST_SAMPLE_COUNT / 2);
+    EXPECT_TRUE(tree.depth() <= 2 * STRESS_TEST_LG2);
+    EXPECT_EQ(tree.rank(STRESS_TEST_SAMPLE_COUNT / 2), STRESS_TEST_SAMPLE_COUNT / 4);
+    EXPECT_EQ(tree.rankSelect(7), 14);
+    EXPECT_NO_THROW((Map<int, int>::deserializeBinary(tree.serializeBinary()))); // Still a valid LLRB
+
+    EXPECT_THROW(tree.append({tree.max(), 0}), std::invalid_argument);
+    EXPECT_THROW(tree.append({-1, 0}), std::invalid_argument);
+    EXPECT_EQ(tree.size(), STRESS_TEST_SAMPLE_COUNT / 2);
+
+    // Odd keys right before their successor: two comparisons each
+    tree.resetStats();
+    for (int i = 1; i < STRESS_TEST_SAMPLE_COUNT; i += 2)
+    {
+        auto it = tree.insert(tree.find(i + 1), {i, -i});
+        EXPECT_EQ(it->first, i);
+    }
+    EXPECT_EQ(tree.stats().insert.nodesVisited, STRESS_TEST_SAMPLE_COUNT / 2);
+    EXPECT_EQ(tree.size(), STRESS_TEST_SAMPLE_COUNT);
+    EXPECT_TRUE(tree.depth() <= 2 * STRESS_TEST_LG2);
+    EXPECT_EQ(tree.rankSelect(5), 5);
+    EXPECT_EQ(tree.at(5), -5);
+
+    // A wrong hint or an existing key falls back to insert()
+    auto it = tree.insert(tree.begin(), {STRESS_TEST_SAMPLE_COUNT + 5, 1});
+    EXPECT_EQ(it->first, STRESS_TEST_SAMPLE_COUNT + 5);
+    it = tree.insert(tree.end(), {10, 100});
+    EXPECT_EQ(it->second, 100);
+    EXPECT_EQ(tree.size(), STRESS_TEST_SAMPLE_COUNT + 1);
+    tree.insert(tree.end(), {STRESS_TEST_SAMPLE_COUNT + 1, 1});
+    EXPECT_EQ(tree.rank(STRESS_TEST_SAMPLE_COUNT + 5), STRESS_TEST_SAMPLE_COUNT + 1);
+    EXPECT_NO_THROW((Map<int, int>::deserializeBinary(tree.serializeBinary())));
+
+    // Summaries and unsized trees
+    Map<int, int, std::less<int>, PoolAllocator<std::pair<int, int>>, NoStats, Aggregate<SumMonoid<int>>> sums;
+    Map<int, int, std::less<int>, PoolAllocator<std::pair<int, int>>, NoStats, NoOrderStatistics> unsized;
+    for (int i = 0; i < 100; i++)
+    {
+        sums.append({i, i});
+        unsized.insert(unsized.end(), {99 - i, i});
+    }
+    sums.insert(sums.find(50), {49, 1000}); // Overwrites
+    EXPECT_EQ(sums.rangeAggregate(0, 100), 4950 - 49 + 1000);
+    EXPECT_EQ(unsized.size(), 100);
+    EXPECT_EQ(unsized.min(), 0);
+    EXPECT_EQ(unsized.at(0), 99);
+}
+
+TEST(MapOperations, CachedMaximumStressTest)
+{
+    // Every way of changing the tree must keep max() and --end() current
+    std::mt19937 randGen(RAND_GEN_SEED);
+    PoolAllocator<std::pair<int, int>> pool;
+    Map<int, int> tree(pool);
+    std::map<int, int> reference;
+    auto check = [&]
+    {
+        if (reference.empty())
+            EXPECT_TRUE(tree.empty());
+        else
+        {
+            EXPECT_EQ(tree.max(), reference.rbegin()->first);
+            EXPECT_EQ((--tree.end())->first, reference.rbegin()->first);
+        }
+    };
+
+    for (int round = 0; round < 2000; round++)
+    {
+        int key = static_cast<int>(randGen() % 1000);
+        switch (randGen() % 8)
+        {
+        case 0:
+        case 1:
+            tree.insert({key, key});
+            reference[key] = key;
+            break;
+        case 2:
+            if (reference.count(key) == 1)
+            {
+                tree.erase(key);
+                reference.erase(key);
+            }
+            break;
+        case 3:
+            if (!reference.empty())
+            {
+                int last = reference.rbegin()->first;
+                tree.erase(last);
+                reference.erase(last);
+            }
+            break;
+        case 4:
+        {
+            int next = reference.empty() ? 0 : reference.rbegin()->first + 1;
+            tree.append({next, next});
+            reference[next] = next;
+            tree.insert(tree.end(), {next + 1, next});
+            reference[next + 1] = next;
+            break;
+        }
+        case 5:
+        {
+            Map<int, int> upper = tree.split(key);
+            std::map<int, int> moved(reference.lower_bound(key), reference.end());
+            reference.erase(reference.lower_bound(key), reference.end());
+            check();
+            if (randGen() % 2 == 0)
+            {
+                tree.join(std::move(upper));
+                reference.insert(moved.begin(), moved.end());
+            }
+            break;
+        }
+        case 6:
+        {
+            std::vector<int> keys{key, key + 1, key + 2};
+            tree.eraseBatch(keys.begin(), keys.end());
+            for (int k : keys)
+                reference.erase(k);
+            break;
+        }
+        default:
+            if (reference.count(key) == 1)
+            {
+                Map<int, int> other(pool);
+                other.insert(tree.extract(key));
+                reference.erase(key);
+                check();
+                tree.merge(other);
+                reference[key] = key;
+            }
+            break;
+        }
+        check();
+    }
+
+    Map<int, int> copy;
+    copy = tree;
+    Map<int, int> restored = Map<int, int>::deserializeBinary(tree.serializeBinary());
+    if (!reference.empty())
+    {
+        EXPECT_EQ(copy.max(), reference.rbegin()->first);
+        EXPECT_EQ(restored.max(), reference.rbegin()->first);
+    }
+}
+
+TEST(MapOperations, SplitAndJoin)
+{
+    Map<int, int> tree;
+    for (int i = 0; i < STRESS_TEST_SAMPLE_COUNT; i++)
+        tree[i] = i;
+
+    Map<int, int> upper = tree.split(STRESS_TEST_SAMPLE_COUNT / 3);
+    EXPECT_EQ(tree.size(), STRESS_TEST_SAMPLE_COUNT / 3);
+    EXPECT_EQ(upper.size(), STRESS_TEST_SAMPLE_COUNT - STRESS_TEST_SAMPLE_COUNT / 3);
+    EXPECT_EQ(tree.max(), STRESS_TEST_SAMPLE_COUNT / 3 - 1);
+    EXPECT_EQ(upper.min(), STRESS_TEST_SAMPLE_COUNT / 3);
+    EXPECT_TRUE(upper.depth() <= 2 * STRESS_TEST_LG2);
+
+    EXPECT_THROW(upper.join(std::move(tree)), std::invalid_argument);
+    tree.join(std::move(upper));
+    EXPECT_TRUE(upper.empty());
+    EXPECT_EQ(tree.size(), STRESS_TEST_SAMPLE_COUNT);
+    for (int i = 0; i < STRESS_TEST_SAMPLE_COUNT; i += 97)
+        EXPECT_EQ(tree.rank(i), i);
+}
+
+TEST(MapOperations, SplitChainKeepsBlackHeights)
+{
+    // Split one key at a time off the top, so every result has been
+    // rebuilt by a run of joins whose heights are carried, not measured
+    std::mt19937 randGen(RAND_GEN_SEED);
+    Map<int, int> tree;
+    for (int i = 0; i < 4096; i++)
+        tree[i] = i;
+
+    std::vector<Map<int, int>> pieces;
+    int bound = 4096;
+    while (!tree.empty())
+    {
+        bound = bound > 1 ? static_cast<int>(randGen() % bound) : 0;
+        pieces.push_back(tree.split(bound));
+        EXPECT_NO_THROW((Map<int, int>::deserializeBinary(tree.serializeBinary()))); // Black heights still match
+        EXPECT_NO_THROW((Map<int, int>::deserializeBinary(pieces.back().serializeBinary())));
+        EXPECT_TRUE(tree.depth() <= 2 * STRESS_TEST_LG2);
+    }
+
+    for (size_t i = pieces.size(); i-- > 0;)
+    {
+        tree.join(std::move(pieces[i]));
+        EXPECT_NO_THROW((Map<int, int>::deserializeBinary(tree.serializeBinary())));
+    }
+    EXPECT_EQ(tree.size(), 4096);
+    for (int i = 0; i < 4096; i += 61)
+        EXPECT_EQ(tree.rank(i), i);
+
+    Map<int, int> odds;
+    for (int i = 1; i < 4096; i += 2)
+        odds[i] = -i;
+    tree.difference(odds);
+    EXPECT_NO_THROW((Map<int, int>::deserializeBinary(tree.serializeBinary())));
+    tree.unionWith(odds);
+    EXPECT_NO_THROW((Map<int, int>::deserializeBinary(tree.serializeBinary())));
+    tree.intersect(odds);
+    EXPECT_NO_THROW((Map<int, int>::deserializeBinary(tree.serializeBinary())));
+    EXPECT_EQ(tree, odds);
+}
+
+TEST(MapOperations, ParallelSetAlgebra)
+{
+    ParallelPolicy policy{4, 64};
+    PoolAllocator<std::pair<int, int>> pool;
+    Map<int, int> evens(pool), threes(pool);
+    for (int i = 0; i < STRESS_TEST_SAMPLE_COUNT; i++)
+    {
+        if (i % 2 == 0)
+            evens[i] = i;
+        if (i % 3 == 0)
+            threes[i] = -i;
+    }
+
+    Map<int, int> both = evens;
+    both.intersect(threes, policy);
+    EXPECT_EQ(both.size(), (STRESS_TEST_SAMPLE_COUNT + 5) / 6);
+
+    Map<int, int> onlyEvens = evens;
+    onlyEvens.difference(threes, policy);
+    EXPECT_EQ(onlyEvens.size(), evens.size() - both.size());
+
+    evens.unionWith(std::move(threes), policy);
+    EXPECT_TRUE(threes.empty());
+    EXPECT_EQ(evens.size(), STRESS_TEST_SAMPLE_COUNT - STRESS_TEST_SAMPLE_COUNT / 3);
+    EXPECT_EQ(evens.at(6), -6);
+    EXPECT_TRUE(evens.depth() <= 2 * STRESS_TEST_LG2);
+    for (int i = 0; i < STRESS_TEST_SAMPLE_COUNT; i += 101)
+        EXPECT_EQ(evens.contains(i), i % 2 == 0 || i % 3 == 0);
+}
+
+TEST(MapOperations, BatchInsertErase)
+{
+    std::vector<std::pair<int, int>> batch;
+    for (int i = STRESS_TEST_SAMPLE_COUNT - 1; i >= 0; i--)
+        batch.push_back({i % 5000, i});
+
+    Map<int, int> sequential, parallel;
+    for (int i = 0; i < 5000; i += 2)
+        sequential[i] = parallel[i] = -1;
+
+    // The last pair of a repeated key wins, as with insert()
+    sequential.insertBatch(batch.begin(), batch.end());
+    parallel.insertBatch(batch.begin(), batch.end(), ParallelPolicy{4, 128});
+    EXPECT_TRUE(sequential == parallel);
+    EXPECT_EQ(sequential.size(), 5000);
+    EXPECT_EQ(sequential.at(7), 7);
+
+    std::vector<int> keys;
+    for (int i = 0; i < 10000; i += 3)
+        keys.push_back(i);
+    sequential.eraseBatch(keys.begin(), keys.end());
+    parallel.eraseBatch(keys.begin(), keys.end(), ParallelPolicy{4, 128});
+    EXPECT_TRUE(sequential == parallel);
+    EXPECT_EQ(sequential.size(), 5000 - 1667);
+    EXPECT_FALSE(sequential.contains(3));
+    EXPECT_TRUE(sequential.depth() <= 2 * STRESS_TEST_LG2);
+}
+
+// Student codec built from the default codecs of its fields
+struct StudentCodec
+{
+    void encode(const Student &student, std::string &out) const
+    {
+        BinaryCodec<std::string>().encode(student.name, out);
+        BinaryCodec<int>().encode(student.age, out);
+        BinaryCodec<double>().encode(student.gpa, out);
+    }
+
+    Student decode(const char *&cursor, const char *end) const
+    {
+        Student student;
+        student.name = BinaryCodec<std::string>().decode(cursor, end);
+        student.age = BinaryCodec<int>().decode(cursor, end);
+        student.gpa = BinaryCodec<double>().decode(cursor, end);
+        return student;
+    }
+};
+
+TEST(MapOperations, BinarySerializationRoundTrip)
+{
+    std::mt19937 randGen(RAND_GEN_SEED);
+    Map<int, int> tree;
+    for (int i = 0; i < STRESS_TEST_SAMPLE_COUNT; i++)
+        tree[randGen() % STRESS_TEST_SAMPLE_COUNT] = i;
+    for (int i = 0; i < STRESS_TEST_SAMPLE_COUNT; i += 3)
+        if (tree.contains(i))
+            tree.erase(i);
+
+    // Same keys, values, colors and shape
+    std::string bytes = tree.serializeBinary();
+    Map<int, int> restored = Map<int, int>::deserializeBinary(bytes);
+    EXPECT_TRUE(restored == tree);
+    EXPECT_EQ(restored.rank(5000), tree.rank(5000));
+    EXPECT_EQ(restored.serializeBinary(), bytes);
+
+    Map<int, int> empty;
+    Map<int, int> restoredEmpty = Map<int, int>::deserializeBinary(empty.serializeBinary());
+    EXPECT_TRUE(restoredEmpty.empty());
+
+    Map<std::string, std::string> words{{"pear", "green"}, {"apple", "red"}, {"", "none"}};
+    Map<std::string, std::string> restoredWords = Map<std::string, std::string>::deserializeBinary(words.serializeBinary());
+    EXPECT_TRUE(restoredWords == words);
+    EXPECT_EQ(restoredWords.at(""), "none");
+
+    Map<Student, int> students;
+    for (int i = 0; i < 20; ++i)
+        students.insert({{"Student" + std::to_string(i), 20 + i, 3.0 + i * 0.1}, i});
+    Map<Student, int> restoredStudents = Map<Student, int>::deserializeBinary(students.serializeBinary(StudentCodec()), StudentCodec());
+    EXPECT_TRUE(restoredStudents == students);
+}
+
+TEST(MapOperations, BinaryDeserializationRejectsMalformedInput)
+{
+    Map<int, int> tree{{0, 6}, {1, 5}, {2, 4}, {3, 3}, {4, 2}, {5, 1}, {6, 0}};
+    std::string bytes = tree.serializeBinary();
+    EXPECT_EQ(bytes.size(), 13 + 7 * (1 + 2 * sizeof(int)));
+
+    std::string truncated = bytes.substr(0, bytes.size() - 1);
+    EXPECT_THROW((Map<int, int>::deserializeBinary(truncated)), std::invalid_argument);
+    EXPECT_THROW((Map<int, int>::deserializeBinary(bytes + '\0')), std::invalid_argument);
+    EXPECT_THROW((Map<int, int>::deserializeBinary("LLRX")), std::invalid_argument);
+
+    // Node counts the input cannot hold fail at the header, before any allocation
+    std::string oversized = bytes;
+    oversized[5 + 7] = '\x7f';
+    EXPECT_THROW((Map<int, int>::deserializeBinary(oversized)), std::invalid_argument);
+    std::string overcounted = bytes;
+    overcounted[5] = 8; // 7 full records cannot hold 8 nodes
+    EXPECT_THROW((Map<int, int>::deserializeBinary(overcounted)), std::invalid_argument);
+    std::string header = bytes.substr(0, 13);
+    header[5] = 1;
+    EXPECT_THROW((Map<std::string, std::string>::deserializeBinary(header + std::string(16, '\0'))), std::invalid_argument);
+    EXPECT_THROW(Set<std::string>::deserializeBinary(header + std::string(7, '\0')), std::invalid_argument);
+
+    // A red root breaks the red-black invariants
+    std::string redRoot = bytes;
+    redRoot[13] |= 1;
+    EXPECT_THROW((Map<int, int>::deserializeBinary(redRoot)), std::invalid_argument);
+
+    // A root without its right subtree leaves the black height uneven
+    std::string lopsided = bytes;
+    lopsided[13] &= ~4;
+    EXPECT_THROW((Map<int, int>::deserializeBinary(lopsided)), std::invalid_argument);
+}
+
+TEST(MapOperations, StreamingSerialization)
+{
+    std::mt19937 randGen(RAND_GEN_SEED);
+    Map<int, int> tree;
+    for (int i = 0; i < STRESS_TEST_SAMPLE_COUNT; i++)
+        tree[randGen() % STRESS_TEST_SAMPLE_COUNT] = i;
+
+    // Keys are appended straight into the output chunk
+    auto writeKey = [](const int &key, std::string &out)
+    { out += std::to_string(key); };
+    std::ostringstream text;
+    tree.serializeTo(text, writeKey);
+    EXPECT_EQ(text.str(), tree.serialize([](const int &key)
+                                         { return std::to_string(key); }));
+
+    std::string chunks;
+    size_t chunkCount = 0;
+    tree.serializeBinaryTo([&](const char *data, size_t size)
+                           {
+                               chunks.append(data, size);
+                               chunkCount++; });
+    EXPECT_EQ(chunks, tree.serializeBinary());
+    EXPECT_GT(chunkCount, 1);
+
+#if !defined(_WIN32)
+    std::FILE *file = std::tmpfile();
+    ASSERT_NE(file, nullptr);
+    tree.serializeBinaryTo(FileDescriptor{fileno(file)});
+    std::rewind(file);
+    std::string stored;
+    char buffer[4096];
+    for (size_t n; (n = std::fread(buffer, 1, sizeof(buffer), file)) > 0;)
+        stored.append(buffer, n);
+    std::fclose(file);
+    Map<int, int> restored = Map<int, int>::deserializeBinary(stored);
+    EXPECT_TRUE(restored == tree);
+#endif
+
+    Map<int, int> empty;
+    EXPECT_THROW(empty.serializeTo(text, writeKey), std::out_of_range);
+}
+
+TEST(MapOperations, StatisticsPolicy)
+{
+    Map<int, int, std::less<int>, PoolAllocator<std::pair<int, int>>, CountingStats> tree;
+    for (int i = 0; i < 1024; i++)
+        tree.insert({i, i});
+
+    TreeStats stats = tree.stats();
+    EXPECT_EQ(stats.allocations, 1024);
+    EXPECT_EQ(stats.deallocations, 0);
+    EXPECT_EQ(stats.insert.operations, 1024);
+    EXPECT_LE(stats.insert.longest, 2 * 10);
+    EXPECT_GT(stats.rotations, 0);
+    EXPECT_GT(stats.colorFlips, 0);
+    EXPECT_GE(stats.comparisons, stats.insert.nodesVisited);
+
+    // Updating an existing key allocates nothing
+    tree.resetStats();
+    tree.insert({5, 50});
+    tree.contains(7);
+    tree.erase(9);
+    stats = tree.stats();
+    EXPECT_EQ(stats.allocations, 0);
+    EXPECT_EQ(stats.deallocations, 1);
+    EXPECT_EQ(stats.insert.operations, 1);
+    EXPECT_EQ(stats.erase.operations, 1);
+    EXPECT_EQ(stats.lookup.operations, 2); // erase searches for its target first
+    EXPECT_GT(stats.erase.nodesVisited, 0);
+
+    tree.resetStats();
+    EXPECT_EQ(tree.stats().comparisons, 0);
+    EXPECT_EQ(tree.stats().lookup.longest, 0);
+
+    // The default policy counts nothing
+    Map<int, int> plain{{1, 1}, {2, 2}};
+    plain.contains(1);
+    EXPECT_EQ(plain.stats().comparisons, 0);
+    EXPECT_EQ(plain.stats().allocations, 0);
+}
+
+TEST(MapOperations, NoOrderStatisticsPolicy)
+{
+    using Unsized = Map<int, int, std::less<int>, PoolAllocator<std::pair<int, int>>, NoStats, NoOrderStatistics>;
+    Unsized tree;
+    std::map<int, int> reference;
+    srand(29);
+    for (int i = 0; i < STRESS_TEST_SAMPLE_COUNT / 4; i++)
+    {
+        int key = rand() % (STRESS_TEST_SAMPLE_COUNT / 8);
+        if (i % 3 == 2 && reference.count(key) == 1)
+        {
+            tree.erase(key);
+            reference.erase(key);
+        }
+        else
+        {
+            tree.insert({key, i});
+            reference[key] = i;
+        }
+    }
+    EXPECT_EQ(tree.size(), reference.size());
+    std::vector<std::pair<int, int>> wanted(reference.begin(), reference.end());
+    std::vector<std::pair<int, int>> seen(tree.begin(), tree.end());
+    EXPECT_EQ(seen, wanted);
+    EXPECT_LE(tree.depth(), 2 * lg2(STRESS_TEST_SAMPLE_COUNT));
+
+    // The element count follows nodes through copies, moves, algebra and splits
+    Unsized copy(tree);
+    EXPECT_EQ(copy.size(), reference.size());
+    Unsized moved(std::move(copy));
+    EXPECT_EQ(moved.size(), reference.size());
+    EXPECT_EQ(copy.size(), 0);
+
+    Unsized other;
+    for (int i = 0; i < 2000; i++)
+        other.insert({i * 7, i});
+    size_t common = 0;
+    for (int i = 0; i < 2000; i++)
+        common += reference.count(i * 7);
+    moved.unionWith(std::move(other));
+    EXPECT_EQ(moved.size(), reference.size() + 2000 - common);
+    moved.difference(tree);
+    EXPECT_EQ(moved.size(), 2000 - common);
+
+    Unsized upper = tree.split(STRESS_TEST_SAMPLE_COUNT / 32);
+    size_t below = std::distance(reference.begin(), reference.lower_bound(STRESS_TEST_SAMPLE_COUNT / 32));
+    EXPECT_EQ(tree.size(), below);
+    EXPECT_EQ(upper.size(), reference.size() - below);
+    tree.join(std::move(upper));
+    EXPECT_EQ(tree.size(), reference.size());
+    EXPECT_EQ(upper.size(), 0);
+
+    std::vector<int> keys;
+    for (auto &entry : reference)
+        keys.push_back(entry.first);
+    tree.eraseBatch(keys.begin(), keys.begin() + keys.size() / 2, ParallelPolicy{4, 64});
+    EXPECT_EQ(tree.size(), keys.size() - keys.size() / 2);
+    EXPECT_EQ(Unsized::deserializeBinary(tree.serializeBinary()).size(), tree.size());
+}
+
 TEST(MapSymbolTableOps, MinMaxRankIntInt)
 {
     Map<int, int> tree;
@@ -527,6 +1416,505 @@ TEST(MapSymbolTableOps, IteratorIntInt)
     }
 }
 
+TEST(MapSymbolTableOps, ReverseAndConstIteratorIntInt)
+{
+    Map<int, int> tree;
+    for (int i = 0; i < 20; i++)
+        tree[i] = 20 - i;
+
+    int counter = 19;
+    for (auto it = tree.rbegin(); it != tree.rend(); ++it)
+    {
+        EXPECT_EQ(it->first, counter);
+        counter--;
+    }
+    EXPECT_EQ(counter, -1);
+
+    // Decrement from end() reaches the largest key
+    Map<int, int>::iterator last = tree.end();
+    --last;
+    EXPECT_EQ(last->first, 19);
+    last->second = 100;
+    EXPECT_EQ(tree.at(19), 100);
+
+    const Map<int, int> &constTree = tree;
+    Map<int, int>::const_iterator cit = constTree.find(5);
+    EXPECT_EQ(cit->second, 15);
+    EXPECT_TRUE(cit == tree.find(5));
+    EXPECT_TRUE(constTree.find(42) == constTree.end());
+
+    cit++;
+    EXPECT_EQ(cit->first, 6);
+    cit--;
+    --cit;
+    EXPECT_EQ(cit->first, 4);
+
+    // Iterators are copy-assignable, and iterator converts to const_iterator
+    static_assert(std::is_trivially_copy_assignable<Map<int, int>::iterator>::value, "iterator copies");
+    static_assert(!std::is_convertible<Map<int, int>::const_iterator, Map<int, int>::iterator>::value, "no const removal");
+    Map<int, int>::iterator copy;
+    copy = last;
+    cit = copy;
+    EXPECT_EQ(cit->first, 19);
+
+    EXPECT_THROW(--tree.begin(), std::out_of_range);
+    EXPECT_THROW(++tree.end(), std::out_of_range);
+}
+
+TEST(MapSymbolTableOps, BidirectionalIteratorStressTest)
+{
+    std::mt19937 randGen(RAND_GEN_SEED);
+    Map<int, int> tree;
+    for (int i = 0; i < STRESS_TEST_SAMPLE_COUNT; i++)
+    {
+        int randNum = randGen() % STRESS_TEST_SAMPLE_COUNT;
+        if (tree.contains(randNum))
+            tree.erase(randNum);
+        else
+            tree[randNum] = i;
+    }
+
+    size_t forwardCount = 0;
+    int prevKey = -1;
+    for (const auto &pair : tree)
+    {
+        EXPECT_TRUE(pair.first > prevKey);
+        prevKey = pair.first;
+        forwardCount++;
+    }
+
+    size_t backwardCount = 0;
+    prevKey = STRESS_TEST_SAMPLE_COUNT;
+    for (auto it = tree.crbegin(); it != tree.crend(); ++it)
+    {
+        EXPECT_TRUE(it->first < prevKey);
+        prevKey = it->first;
+        backwardCount++;
+    }
+
+    EXPECT_EQ(forwardCount, tree.size());
+    EXPECT_EQ(backwardCount, tree.size());
+}
+
+// Transparent comparator that orders string keys against raw buffers
+struct BufferComparator
+{
+    using is_transparent = void;
+
+    struct Buffer
+    {
+        const char *data;
+        size_t len;
+    };
+
+    static int compare(const char *a, size_t aLen, const char *b, size_t bLen)
+    {
+        int cmp = std::char_traits<char>::compare(a, b, aLen < bLen ? aLen : bLen);
+        return cmp != 0 ? cmp : (aLen < bLen ? -1 : (aLen > bLen ? 1 : 0));
+    }
+
+    bool operator()(const std::string &lhs, const std::string &rhs) const { return lhs < rhs; }
+    bool operator()(const std::string &lhs, const Buffer &rhs) const { return compare(lhs.data(), lhs.size(), rhs.data, rhs.len) < 0; }
+    bool operator()(const Buffer &lhs, const std::string &rhs) const { return compare(lhs.data, lhs.len, rhs.data(), rhs.size()) < 0; }
+};
+
+TEST(MapSymbolTableOps, TransparentLookupStringInt)
+{
+    Map<std::string, int, std::less<>> tree;
+    for (int i = 0; i < 20; i += 2)
+        tree["key" + std::to_string(10 + i)] = i;
+
+    EXPECT_TRUE(tree.contains("key10"));
+    EXPECT_FALSE(tree.contains("key11"));
+    EXPECT_EQ(tree.at("key14"), 4);
+    EXPECT_THROW(tree.at("key15"), std::out_of_range);
+    EXPECT_EQ(tree.rank("key15"), 3);
+    EXPECT_EQ(tree.floor("key15"), "key14");
+    EXPECT_EQ(tree.ceiling("key15"), "key16");
+    EXPECT_EQ(tree.find("key18")->second, 8);
+    EXPECT_TRUE(tree.find("key19") == tree.end());
+
+    const auto &constTree = tree;
+    EXPECT_EQ(constTree.find("key12")->second, 2);
+}
+
+TEST(MapSymbolTableOps, TransparentLookupBuffer)
+{
+    Map<std::string, int, BufferComparator> tree;
+    tree["alpha"] = 1;
+    tree["beta"] = 2;
+    tree["gamma"] = 3;
+
+    const char *request = "beta gamma";
+    BufferComparator::Buffer first{request, 4};
+    BufferComparator::Buffer second{request + 5, 5};
+    BufferComparator::Buffer prefix{request, 3};
+
+    EXPECT_TRUE(tree.contains(first));
+    EXPECT_EQ(tree.at(second), 3);
+    EXPECT_FALSE(tree.contains(prefix));
+    EXPECT_EQ(tree.rank(prefix), 1);
+}
+
+// Counts calls to detect redundant comparisons on lookup paths
+struct CountingLess
+{
+    static int calls;
+
+    bool operator()(int lhs, int rhs) const
+    {
+        ++calls;
+        return lhs < rhs;
+    }
+};
+
+// Three-way comparator: one call orders two keys
+struct ThreeWayCountingCompare
+{
+    static int calls;
+
+    int compare(int lhs, int rhs) const
+    {
+        ++calls;
+        return lhs < rhs ? -1 : (lhs > rhs ? 1 : 0);
+    }
+
+    bool operator()(int lhs, int rhs) const { return compare(lhs, rhs) < 0; }
+};
+
+int CountingLess::calls = 0;
+int ThreeWayCountingCompare::calls = 0;
+
+TEST(MapSymbolTableOps, SingleComparisonPerLevel)
+{
+    Map<int, int, CountingLess> tree;
+    for (int i = 0; i < STRESS_TEST_SAMPLE_COUNT; i += 2)
+        tree[i] = i;
+    int depth = tree.depth();
+
+    for (int i = 0; i < STRESS_TEST_SAMPLE_COUNT; i++)
+    {
+        CountingLess::calls = 0;
+        EXPECT_EQ(tree.contains(i), i % 2 == 0);
+        EXPECT_LE(CountingLess::calls, depth + 1);
+
+        CountingLess::calls = 0;
+        EXPECT_EQ(tree.rank(i), (i + 1) / 2);
+        EXPECT_LE(CountingLess::calls, depth);
+    }
+
+    CountingLess::calls = 0;
+    tree.insert(std::make_pair(1, 1));
+    EXPECT_LE(CountingLess::calls, depth + 1);
+}
+
+TEST(MapSymbolTableOps, ThreeWayComparator)
+{
+    Map<int, int, ThreeWayCountingCompare> tree;
+    for (int i = STRESS_TEST_SAMPLE_COUNT - 1; i >= 0; i--)
+        if (i % 3 != 0)
+            tree[i] = -i;
+    int depth = tree.depth();
+
+    for (int i = 0; i < STRESS_TEST_SAMPLE_COUNT; i++)
+    {
+        ThreeWayCountingCompare::calls = 0;
+        EXPECT_EQ(tree.contains(i), i % 3 != 0);
+        EXPECT_LE(ThreeWayCountingCompare::calls, depth);
+    }
+
+    EXPECT_EQ(tree.at(4), -4);
+    EXPECT_EQ(tree.floor(3), 2);
+    EXPECT_EQ(tree.ceiling(3), 4);
+    EXPECT_EQ(tree.rank(4), 2);
+    tree.erase(4);
+    EXPECT_FALSE(tree.contains(4));
+    EXPECT_EQ(tree.size(), STRESS_TEST_SAMPLE_COUNT - (STRESS_TEST_SAMPLE_COUNT + 2) / 3 - 1);
+}
+
+// The statistics count every comparator call, two per level where a
+// two-way comparator has to ask in both directions
+template <typename Compare>
+void expectComparisonsCounted()
+{
+    using CountedMap = Map<int, int, Compare, PoolAllocator<std::pair<int, int>>, CountingStats>;
+    Compare::calls = 0;
+    CountedMap tree;
+    for (int i = 0; i < 3000; i++)
+        tree.insert({(i * 7919) % 4001, i});
+    for (int i = 0; i < 4001; i += 3)
+    {
+        tree.contains(i);
+        tree.rank(i);
+        tree.lower_bound(i);
+        if (i % 2 == 0 && tree.contains(i))
+            tree.erase(i);
+    }
+    tree.floor(2000);
+    tree.ceiling(2000);
+    tree.append({5000, 0});
+    tree.insert(tree.end(), {4500, 0});
+    CountedMap upper = tree.split(2000);
+    tree.join(std::move(upper));
+    CountedMap sorted = CountedMap::fromSorted(tree.begin(), tree.end());
+    EXPECT_EQ(static_cast<size_t>(Compare::calls), tree.stats().comparisons + upper.stats().comparisons + sorted.stats().comparisons);
+}
+
+TEST(MapSymbolTableOps, StatisticsCountComparatorCalls)
+{
+    expectComparisonsCounted<CountingLess>();
+    expectComparisonsCounted<ThreeWayCountingCompare>();
+
+    CountingLess::calls = 0;
+    Set<int, CountingLess, PoolAllocator<int>, CountingStats> set;
+    for (int i = 0; i < 1000; i++)
+        set.insert((i * 7919) % 1009);
+    for (int i = 0; i < 1009; i += 5)
+        set.lower_bound(i);
+    auto upper = set.split(500);
+    EXPECT_EQ(static_cast<size_t>(CountingLess::calls), set.stats().comparisons + upper.stats().comparisons);
+}
+
+TEST(MapSymbolTableOps, BoundsAndRanges)
+{
+    Map<int, int> tree;
+    for (int i = 0; i < 100; i += 10)
+        tree[i] = i;
+
+    EXPECT_EQ(tree.lower_bound(20)->first, 20);
+    EXPECT_EQ(tree.lower_bound(21)->first, 30);
+    EXPECT_EQ(tree.upper_bound(20)->first, 30);
+    EXPECT_EQ(tree.lower_bound(-5), tree.begin());
+    EXPECT_EQ(tree.lower_bound(91), tree.end());
+    EXPECT_EQ(tree.upper_bound(90), tree.end());
+
+    auto hit = tree.equal_range(40);
+    EXPECT_EQ(std::distance(hit.first, hit.second), 1);
+    EXPECT_EQ(hit.first->second, 40);
+    auto miss = tree.equal_range(45);
+    EXPECT_EQ(miss.first, miss.second);
+
+    std::vector<int> keys;
+    for (auto &entry : tree.range(15, 60))
+        keys.push_back(entry.first);
+    EXPECT_EQ(keys, std::vector<int>({20, 30, 40, 50}));
+    EXPECT_TRUE(tree.range(60, 15).empty());
+    EXPECT_TRUE(tree.range(41, 49).empty());
+
+    for (auto &entry : tree.range(0, 30))
+        entry.second = -1;
+    EXPECT_EQ(tree.at(20), -1);
+    EXPECT_EQ(tree.at(30), 30);
+
+    EXPECT_EQ(tree.rangeCount(15, 60), 4);
+    EXPECT_EQ(tree.rangeCount(-100, 100), 10);
+    EXPECT_EQ(tree.rangeCount(60, 15), 0);
+    EXPECT_EQ(tree.rangeCount(50, 50), 0);
+}
+
+TEST(MapSymbolTableOps, RangeCountStressTest)
+{
+    Map<int, int> tree;
+    std::vector<int> keys;
+    srand(17);
+    for (int i = 0; i < STRESS_TEST_SAMPLE_COUNT; i++)
+    {
+        int key = rand() % (STRESS_TEST_SAMPLE_COUNT * 4);
+        if (!tree.contains(key))
+            keys.push_back(key);
+        tree[key] = i;
+    }
+    std::sort(keys.begin(), keys.end());
+
+    for (int i = 0; i < 1000; i++)
+    {
+        int lo = rand() % (STRESS_TEST_SAMPLE_COUNT * 4);
+        int hi = lo + rand() % 500;
+        size_t expected = std::lower_bound(keys.begin(), keys.end(), hi) - std::lower_bound(keys.begin(), keys.end(), lo);
+        EXPECT_EQ(tree.rangeCount(lo, hi), expected);
+
+        const Map<int, int> &view = tree;
+        auto slice = view.range(lo, hi);
+        EXPECT_EQ(static_cast<size_t>(std::distance(slice.begin(), slice.end())), expected);
+    }
+}
+
+TEST(MapSymbolTableOps, RangeAggregateStressTest)
+{
+    using SumMap = Map<int, long, std::less<int>, PoolAllocator<std::pair<int, long>>, NoStats, Aggregate<SumMonoid<long>>>;
+    using MaxMap = Map<int, long, std::less<int>, PoolAllocator<std::pair<int, long>>, NoStats, Aggregate<MaxMonoid<long>>>;
+    SumMap sums;
+    MaxMap maxima;
+    std::map<int, long> reference;
+    srand(23);
+    for (int i = 0; i < STRESS_TEST_SAMPLE_COUNT; i++)
+    {
+        int key = rand() % (STRESS_TEST_SAMPLE_COUNT / 2);
+        long value = rand() % 1000 - 500;
+        if (i % 4 == 3 && reference.count(key) == 1)
+        {
+            sums.erase(key);
+            maxima.erase(key);
+            reference.erase(key);
+        }
+        else
+        {
+            // Overwrites refresh the aggregates too
+            sums.insert({key, value});
+            maxima.insert({key, value});
+            reference[key] = value;
+        }
+    }
+
+    for (int i = 0; i < 200; i++)
+    {
+        int lo = rand() % (STRESS_TEST_SAMPLE_COUNT / 2);
+        int hi = lo + rand() % 2000;
+        long sum = 0;
+        long max = std::numeric_limits<long>::lowest();
+        for (auto it = reference.lower_bound(lo); it != reference.end() && it->first < hi; ++it)
+        {
+            sum += it->second;
+            max = std::max(max, it->second);
+        }
+        EXPECT_EQ(sums.rangeAggregate(lo, hi), sum);
+        EXPECT_EQ(maxima.rangeAggregate(lo, hi), max);
+
+        long prefix = 0;
+        for (auto it = reference.begin(); it != reference.end() && it->first < lo; ++it)
+            prefix += it->second;
+        EXPECT_EQ(sums.prefixAggregate(lo), prefix);
+    }
+
+    EXPECT_EQ(sums.rangeAggregate(10, 5), 0);
+    EXPECT_EQ(SumMap().rangeAggregate(0, 10), 0);
+}
+
+TEST(MapSymbolTableOps, RangeAggregateAfterUpdate)
+{
+    using SumMap = Map<int, int, std::less<int>, PoolAllocator<std::pair<int, int>>, NoStats, Aggregate<SumMonoid<int>>>;
+    SumMap sums;
+    for (int i = 0; i < 10; i++)
+        sums.insert({i, 1});
+
+    // Iterators cannot write values past the cached sums
+    static_assert(std::is_const<std::remove_reference<decltype(*sums.find(5))>::type>::value, "read-only values");
+    static_assert(std::is_const<std::remove_reference<decltype(*sums.try_emplace(20, 0).first)>::type>::value, "read-only values");
+    static_assert(!std::is_const<std::remove_reference<decltype(*Map<int, int>().find(5))>::type>::value, "writable values");
+
+    sums.update(5, 100);
+    EXPECT_EQ(sums.at(5), 100);
+    EXPECT_EQ(sums.rangeAggregate(0, 10), 109);
+    EXPECT_EQ(sums.prefixAggregate(6), 105);
+
+    int zero = 0;
+    sums.update(0, std::move(zero));
+    EXPECT_EQ(sums.rangeAggregate(0, 10), 108);
+    EXPECT_THROW(sums.update(42, 1), std::out_of_range);
+    EXPECT_THROW(SumMap().update(0, 1), std::out_of_range);
+
+    // Plain maps can update too
+    Map<int, int> plain{{1, 1}};
+    plain.update(1, 2);
+    EXPECT_EQ(plain.at(1), 2);
+}
+
+// Concatenation is not commutative, so it also checks the operand order
+struct ConcatMonoid
+{
+    using value_type = std::string;
+    static std::string identity() { return ""; }
+    static std::string lift(const std::string &value) { return value; }
+    static std::string combine(const std::string &a, const std::string &b) { return a + b; }
+};
+
+TEST(MapSymbolTableOps, RangeAggregateAfterRestructuring)
+{
+    using ConcatMap = Map<int, std::string, std::less<int>, PoolAllocator<std::pair<int, std::string>>, NoStats, Aggregate<ConcatMonoid>>;
+    auto expected = [](const ConcatMap &tree, int lo, int hi)
+    {
+        std::string out;
+        for (auto &entry : tree)
+            if (entry.first >= lo && entry.first < hi)
+                out += entry.second;
+        return out;
+    };
+    auto check = [&](const ConcatMap &tree)
+    {
+        for (int lo = -5; lo < 420; lo += 37)
+            for (int hi = lo; hi < 430; hi += 53)
+                EXPECT_EQ(tree.rangeAggregate(lo, hi), expected(tree, lo, hi));
+    };
+
+    std::vector<std::pair<int, std::string>> sorted;
+    for (int i = 0; i < 400; i += 2)
+        sorted.push_back({i, std::string(1, 'a' + i % 26)});
+    ConcatMap tree = ConcatMap::fromSorted(sorted.begin(), sorted.end());
+    check(tree);
+
+    ConcatMap other;
+    for (int i = 1; i < 400; i += 3)
+        other.insert({i, std::string(1, 'A' + i % 26)});
+    tree.unionWith(other);
+    check(tree);
+    tree.difference(other);
+    check(tree);
+
+    ConcatMap upper = tree.split(200);
+    check(tree);
+    check(upper);
+    tree.join(std::move(upper));
+    check(tree);
+
+    std::vector<std::pair<int, std::string>> batch;
+    for (int i = 0; i < 400; i += 5)
+        batch.push_back({i, "<" + std::to_string(i) + ">"});
+    tree.insertBatch(batch.begin(), batch.end());
+    check(tree);
+    std::vector<int> gone{0, 10, 50, 100, 395};
+    tree.eraseBatch(gone.begin(), gone.end());
+    check(tree);
+
+    ConcatMap copy(tree);
+    check(copy);
+    check(ConcatMap::deserializeBinary(tree.serializeBinary()));
+    EXPECT_EQ(tree.prefixAggregate(1000), expected(tree, 0, 1000));
+}
+
+TEST(MapSymbolTableOps, BatchedLookup)
+{
+    Map<int, int> tree;
+    for (int i = 0; i < STRESS_TEST_SAMPLE_COUNT; i += 2)
+        tree[i] = -i;
+
+    // Not a multiple of the group width
+    const size_t count = 1001;
+    std::vector<int> keys;
+    for (size_t i = 0; i < count; i++)
+        keys.push_back(static_cast<int>((i * 7919) % (STRESS_TEST_SAMPLE_COUNT + 10)) - 5);
+
+    bool found[count];
+    std::vector<int> ranks(count);
+    tree.containsBatch(keys.data(), count, found);
+    tree.rankBatch(keys.data(), count, ranks.data());
+    for (size_t i = 0; i < count; i++)
+    {
+        EXPECT_EQ(found[i], tree.contains(keys[i]));
+        EXPECT_EQ(ranks[i], tree.rank(keys[i]));
+    }
+
+    std::vector<int> present{4, 0, 8, 4}, values(4);
+    tree.atBatch(present.data(), present.size(), values.data());
+    EXPECT_EQ(values, std::vector<int>({-4, 0, -8, -4}));
+    present.push_back(3);
+    EXPECT_THROW(tree.atBatch(present.data(), present.size(), values.data()), std::out_of_range);
+
+    Map<int, int> empty;
+    empty.containsBatch(keys.data(), 1, found);
+    EXPECT_FALSE(found[0]);
+    EXPECT_THROW(empty.rankBatch(keys.data(), 1, ranks.data()), std::out_of_range);
+}
+
 /**
  * Symbol table operations stress test
  */
@@ -729,6 +2117,293 @@ TEST(SetOperations, WorstCaseStressTestMixedInsertErase)
     EXPECT_TRUE(depth <= STRESS_TEST_LG2 + STRESS_TEST_LG2); // Depth <= 2lgN
 }
 
+TEST(SetOperations, StdAllocatorMixedInsertErase)
+{
+    Set<int, std::less<int>, std::allocator<int>> set;
+    for (int i = 0; i < 1000; i++)
+        set.insert(i);
+    for (int i = 0; i < 1000; i += 2)
+        set.erase(i);
+
+    EXPECT_EQ(set.size(), 500);
+    EXPECT_TRUE(set.contains(1));
+    EXPECT_FALSE(set.contains(0));
+}
+
+TEST(SetOperations, FromSortedInt)
+{
+    std::vector<int> sorted;
+    for (int i = 0; i < 1000; i++)
+        sorted.push_back(i * 3);
+
+    Set<int> set = Set<int>::fromSorted(sorted.begin(), sorted.end());
+    EXPECT_EQ(set.size(), 1000);
+    EXPECT_TRUE(set.contains(999));
+    EXPECT_FALSE(set.contains(1000));
+    EXPECT_EQ(set.rank(30), 10);
+
+    int counter = 0;
+    for (int key : set)
+        EXPECT_EQ(key, 3 * counter++);
+}
+
+TEST(SetOperations, MoveAndEmplaceString)
+{
+    Set<std::string> set1;
+    for (int i = 0; i < 100; i++)
+        set1.insert("key" + std::to_string(i));
+
+    auto result = set1.emplace(3, 'x');
+    EXPECT_TRUE(result.second);
+    EXPECT_EQ(*result.first, "xxx");
+    EXPECT_FALSE(set1.emplace("key7").second);
+
+    Set<std::string> set2(std::move(set1));
+    EXPECT_TRUE(set1.empty());
+    EXPECT_EQ(set2.size(), 101);
+
+    set1 = std::move(set2);
+    EXPECT_EQ(set1.size(), 101);
+    EXPECT_TRUE(set1.contains("xxx"));
+}
+
+TEST(SetOperations, TransparentLookupString)
+{
+    Set<std::string, std::less<>> set{"apple", "banana", "cherry"};
+
+    EXPECT_TRUE(set.contains("banana"));
+    EXPECT_FALSE(set.contains("durian"));
+    EXPECT_EQ(set.rank("c"), 2);
+    EXPECT_EQ(set.floor("c"), "banana");
+    EXPECT_EQ(set.ceiling("c"), "cherry");
+    EXPECT_EQ(*set.find("apple"), "apple");
+}
+
+TEST(SetOperations, ThreeWayComparator)
+{
+    Set<int, ThreeWayCountingCompare> set;
+    for (int i = 0; i < 100; i += 2)
+        set.insert(i);
+
+    for (int i = 0; i < 100; i++)
+        EXPECT_EQ(set.contains(i), i % 2 == 0);
+    EXPECT_EQ(set.floor(7), 6);
+    EXPECT_EQ(set.ceiling(7), 8);
+    set.erase(8);
+    EXPECT_FALSE(set.contains(8));
+    EXPECT_EQ(set.size(), 49);
+}
+
+TEST(SetOperations, BoundsAndRangesString)
+{
+    Set<std::string, std::less<>> set = {"apple", "banana", "cherry", "date", "fig"};
+
+    EXPECT_EQ(*set.lower_bound("c"), "cherry");
+    EXPECT_EQ(*set.upper_bound("cherry"), "date");
+    EXPECT_EQ(set.upper_bound("fig"), set.end());
+
+    auto hit = set.equal_range(std::string("date"));
+    EXPECT_EQ(*hit.first, "date");
+    EXPECT_EQ(*hit.second, "fig");
+
+    std::vector<std::string> keys(set.range("b", "e").begin(), set.range("b", "e").end());
+    EXPECT_EQ(keys, std::vector<std::string>({"banana", "cherry", "date"}));
+    EXPECT_EQ(set.rangeCount("b", "e"), 3);
+    EXPECT_EQ(set.rangeCount(std::string("a"), std::string("z")), 5);
+}
+
+TEST(SetOperations, BatchedLookupString)
+{
+    Set<std::string> set{"delta", "alpha", "echo", "charlie"};
+    std::vector<std::string> keys{"alpha", "bravo", "charlie", "zulu", "echo", ""};
+
+    bool found[6];
+    int ranks[6];
+    set.containsBatch(keys.data(), keys.size(), found);
+    set.rankBatch(keys.data(), keys.size(), ranks);
+
+    std::vector<bool> seen(found, found + 6);
+    EXPECT_EQ(seen, std::vector<bool>({true, false, true, false, true, false}));
+    EXPECT_EQ(std::vector<int>(ranks, ranks + 6), std::vector<int>({0, 1, 1, 4, 3, 0}));
+}
+
+TEST(SetOperations, StatisticsPolicy)
+{
+    Set<std::string, std::less<std::string>, PoolAllocator<std::string>, CountingStats> set{"b", "a", "c"};
+    set.erase("a");
+    EXPECT_EQ(set.stats().allocations, 3);
+    EXPECT_EQ(set.stats().deallocations, 1);
+    EXPECT_EQ(set.stats().insert.operations, 3);
+    EXPECT_EQ(set.stats().erase.operations, 1);
+
+    set.resetStats();
+    EXPECT_TRUE(set.contains("c"));
+    EXPECT_EQ(set.stats().lookup.operations, 1);
+    EXPECT_EQ(set.stats().lookup.nodesVisited, set.stats().lookup.longest);
+    EXPECT_EQ(set.stats().allocations, 0);
+}
+
+TEST(SetOperations, NoOrderStatisticsPolicy)
+{
+    using Unsized = Set<int, std::less<int>, PoolAllocator<int>, NoStats, NoOrderStatistics>;
+    Unsized set;
+    for (int i = 0; i < 1000; i++)
+        set.insert((i * 37) % 1000);
+    for (int i = 0; i < 1000; i += 3)
+        set.erase(i);
+    EXPECT_EQ(set.size(), 666);
+    EXPECT_EQ(set.min(), 1);
+    EXPECT_EQ(set.floor(999), 998);
+
+    Unsized upper = set.split(900);
+    EXPECT_EQ(set.size(), 600);
+    EXPECT_EQ(upper.size(), 66);
+
+    Unsized evens;
+    for (int i = 0; i < 1000; i += 2)
+        evens.insert(i);
+    set.intersect(evens);
+    EXPECT_EQ(set.size(), 300);
+    EXPECT_EQ(static_cast<size_t>(std::distance(set.begin(), set.end())), set.size());
+}
+
+TEST(SetOperations, SetAlgebraInt)
+{
+    Set<int> evens, threes;
+    for (int i = 0; i < 60; i++)
+    {
+        if (i % 2 == 0)
+            evens.insert(i);
+        if (i % 3 == 0)
+            threes.insert(i);
+    }
+
+    Set<int> both = evens;
+    both.intersect(threes);
+    EXPECT_EQ(std::vector<int>(both.begin(), both.end()), std::vector<int>({0, 6, 12, 18, 24, 30, 36, 42, 48, 54}));
+
+    Set<int> onlyEvens = evens;
+    onlyEvens.difference(threes);
+    EXPECT_EQ(onlyEvens.size(), 20);
+    EXPECT_FALSE(onlyEvens.contains(6));
+
+    evens.unionWith(threes);
+    EXPECT_EQ(evens.size(), 40);
+    EXPECT_EQ(threes.size(), 20);
+
+    Set<int> upper = evens.split(30);
+    EXPECT_EQ(evens.max(), 28);
+    EXPECT_EQ(upper.min(), 30);
+    evens.join(std::move(upper));
+    EXPECT_EQ(evens.size(), 40);
+}
+
+TEST(SetOperations, NodeHandlesAndMerge)
+{
+    PoolAllocator<std::string> pool;
+    Set<std::string> hot(pool);
+    Set<std::string> cold(pool);
+    for (int i = 0; i < 100; i++)
+        hot.insert("key " + std::to_string(i));
+
+    const std::string *key = &*hot.find("key 5");
+    Set<std::string>::node_type handle = hot.extract("key 5");
+    handle.value() = "key 500";
+    EXPECT_TRUE(cold.insert(std::move(handle)).second);
+    EXPECT_EQ(&*cold.find("key 500"), key);
+
+    cold.insert("key 6");
+    handle = hot.extract(hot.find("key 6"));
+    EXPECT_FALSE(cold.insert(std::move(handle)).second);
+    EXPECT_FALSE(handle.empty());
+
+    cold.merge(hot);
+    EXPECT_TRUE(hot.empty());
+    EXPECT_EQ(cold.size(), 100);
+    EXPECT_EQ(cold.rank("key 500"), cold.rank("key 50") + 1);
+
+    Set<std::string> elsewhere;
+    elsewhere.insert(cold.extract("key 1"));
+    elsewhere.merge(cold);
+    EXPECT_TRUE(cold.empty());
+    EXPECT_EQ(elsewhere.size(), 100);
+    EXPECT_THROW(cold.extract("key 1"), std::out_of_range);
+}
+
+TEST(SetOperations, ParallelBatchUpdates)
+{
+    ParallelPolicy policy{3, 32};
+    std::vector<int> keys;
+    for (int i = 0; i < 3000; i++)
+        keys.push_back((i * 7919) % 2000);
+
+    Set<int> set;
+    set.insertBatch(keys.begin(), keys.end(), policy);
+    EXPECT_EQ(set.size(), 2000);
+    EXPECT_EQ(set.rankSelect(1234), 1234);
+
+    Set<int> odds;
+    for (int i = 1; i < 2000; i += 2)
+        odds.insert(i);
+    set.difference(odds, policy);
+    EXPECT_EQ(set.size(), 1000);
+    set.eraseBatch(keys.begin(), keys.begin() + 10, policy);
+    set.unionWith(odds, policy);
+    EXPECT_EQ(set.size(), 2000 - 5);
+}
+
+TEST(SetOperations, BinarySerializationString)
+{
+    Set<std::string> set;
+    for (int i = 0; i < 1000; i++)
+        set.insert("key" + std::to_string(i * 7919 % 1000));
+    set.erase("key500");
+
+    Set<std::string> restored = Set<std::string>::deserializeBinary(set.serializeBinary());
+    EXPECT_EQ(restored.size(), 999);
+    EXPECT_EQ(restored.serialize([](const std::string &key)
+                                 { return key; }),
+              set.serialize([](const std::string &key)
+                            { return key; }));
+    EXPECT_THROW(Set<std::string>::deserializeBinary(std::string("LLRB")), std::invalid_argument);
+}
+
+TEST(SetOperations, StreamingSerializationString)
+{
+    Set<std::string> set{"delta", "alpha", "charlie", "bravo"};
+    std::ostringstream text;
+    set.serializeTo(text, [](const std::string &key, std::string &out)
+                    { out += key; }, ";");
+    EXPECT_EQ(text.str(), set.serialize([](const std::string &key)
+                                        { return key; }, ";"));
+
+    std::ostringstream binary;
+    set.serializeBinaryTo(binary);
+    EXPECT_EQ(binary.str(), set.serializeBinary());
+}
+
+TEST(SetOperations, HintedInsertAndAppend)
+{
+    Set<std::string> set;
+    for (char c = 'a'; c <= 'z'; c += 2)
+        set.append(std::string(1, c));
+    EXPECT_THROW(set.append("m"), std::invalid_argument);
+    EXPECT_EQ(set.size(), 13);
+
+    for (char c = 'b'; c <= 'z'; c += 2)
+        EXPECT_EQ(*set.insert(set.lower_bound(std::string(1, c)), std::string(1, c)), std::string(1, c));
+    EXPECT_EQ(set.size(), 26);
+    EXPECT_EQ(*set.insert(set.begin(), "q"), "q"); // Existing key, wrong hint
+    EXPECT_EQ(*set.insert(set.end(), "zz"), "zz");
+    EXPECT_EQ(set.size(), 27);
+
+    std::string all;
+    for (const std::string &key : set)
+        all += key;
+    EXPECT_EQ(all, "abcdefghijklmnopqrstuvwxyzzz");
+    EXPECT_EQ(set.rankSelect(16), "q");
+}
+
 TEST(SetOperations, MixedOperationsStructInt)
 {
     Set<Student> set;
@@ -771,3 +2446,24 @@ TEST(SetOperations, IteratorInt)
         counter++;
     }
 }
+
+TEST(SetOperations, ReverseIteratorInt)
+{
+    Set<int> set;
+    for (int i = 0; i < 20; i++)
+        set.insert(i);
+
+    int counter = 19;
+    for (auto it = set.rbegin(); it != set.rend(); ++it)
+    {
+        EXPECT_EQ(*it, counter);
+        counter--;
+    }
+    EXPECT_EQ(counter, -1);
+
+    Set<int>::iterator it = set.find(10);
+    it--;
+    EXPECT_EQ(*it, 9);
+    EXPECT_EQ(*--set.end(), 19);
+    EXPECT_THROW(--set.begin(), std::out_of_range);
+}